@@ -1,10 +1,13 @@
 #pragma once
 
+#include <functional>
 #include <ranges>
+#include <stdexcept>
 #include <vector>
 
 #include "broadword.hpp"
 #include "mappable_vector.hpp"
+#include "mapper.hpp"
 #include "util.hpp"
 
 namespace succinct {
@@ -22,7 +25,7 @@ class bit_vector_builder {
 
   typedef std::vector<uint64_t> bits_type;
 
-  bit_vector_builder(uint64_t size = 0, bool init = 0) : m_size(size) {
+  bit_vector_builder(uint64_t size = 0, bool init = 0) : m_size(size), m_cur_word(nullptr) {
     m_bits.resize(detail::words_for(size), uint64_t(-init));
     if (size) {
       m_cur_word = &m_bits.back();
@@ -306,7 +309,7 @@ class bit_vector {
   mapper::mappable_vector<uint64_t> const &data() const { return m_bits; }
 
   struct enumerator {
-    enumerator() : m_bv(0), m_pos(uint64_t(-1)) {}
+    enumerator() : m_bv(0), m_pos(uint64_t(-1)), m_buf(0), m_avail(0) {}
 
     enumerator(bit_vector const &bv, size_t pos) : m_bv(&bv), m_pos(pos), m_buf(0), m_avail(0) {
       m_bv->data().prefetch(m_pos / 64);
@@ -454,4 +457,82 @@ class bit_vector {
   mapper::mappable_vector<uint64_t> m_bits;
 };
 
+// Append-only counterpart of bit_vector_builder that writes a frozen
+// bit_vector to a stream_freezer as its words are completed, instead of
+// keeping them in memory. The final size must be known in advance; if
+// given, word_observer is called on every word as it is written.
+class bit_vector_stream_builder {
+ public:
+  bit_vector_stream_builder(const bit_vector_stream_builder &)            = delete;
+  bit_vector_stream_builder &operator=(const bit_vector_stream_builder &) = delete;
+
+  bit_vector_stream_builder(mapper::stream_freezer &out, uint64_t size,
+                            std::function<void(uint64_t)> word_observer = nullptr)
+    : m_size(size), m_pos(0), m_cur_word(0), m_word_observer(std::move(word_observer)) {
+    out.write_pod(size);
+    m_words = out.begin_vector<uint64_t>(detail::words_for(size));
+  }
+
+  inline void push_back(bool b) { append_bits(uint64_t(b), 1); }
+
+  inline void append_bits(uint64_t bits, size_t len) {
+    // check there are no spurious bits
+    assert(len == 64 || (bits >> len) == 0);
+    assert(m_pos + len <= m_size);
+    if (!len) return;
+    uint64_t pos_in_word = m_pos % 64;
+    m_pos += len;
+    m_cur_word |= bits << pos_in_word;
+    if (pos_in_word + len >= 64) {
+      flush_word(m_cur_word);
+      m_cur_word = pos_in_word ? bits >> (64 - pos_in_word) : 0;
+    }
+  }
+
+  inline void zero_extend(uint64_t n) {
+    assert(m_pos + n <= m_size);
+    uint64_t pos_in_word = m_pos % 64;
+    if (pos_in_word + n < 64) {
+      m_pos += n;
+      return;
+    }
+    flush_word(m_cur_word);
+    m_cur_word = 0;
+    n -= 64 - pos_in_word;
+    m_pos += 64 - pos_in_word;
+    for (; n >= 64; n -= 64, m_pos += 64) { flush_word(0); }
+    m_pos += n;
+  }
+
+  inline void one_extend(uint64_t n) {
+    while (n >= 64) {
+      append_bits(uint64_t(-1), 64);
+      n -= 64;
+    }
+    if (n) { append_bits(uint64_t(-1) >> (64 - n), n); }
+  }
+
+  uint64_t size() const { return m_pos; }
+
+  // Writes the last partial word; throws if fewer bits than the declared
+  // size were appended
+  void finish() {
+    if (m_pos != m_size) { throw std::logic_error("bit_vector_stream_builder finished before reaching its size"); }
+    if (m_pos % 64) { flush_word(m_cur_word); }
+    m_words.finish();
+  }
+
+ private:
+  void flush_word(uint64_t word) {
+    if (m_word_observer) { m_word_observer(word); }
+    m_words.push_back(word);
+  }
+
+  uint64_t m_size;
+  uint64_t m_pos;
+  uint64_t m_cur_word;
+  std::function<void(uint64_t)> m_word_observer;
+  mapper::stream_freezer::vector_writer<uint64_t> m_words;
+};
+
 }  // namespace succinct
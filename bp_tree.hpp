@@ -0,0 +1,125 @@
+#pragma once
+
+#include "bp_vector.hpp"
+
+namespace succinct {
+
+// Ordinal tree in balanced parentheses representation: each node is an
+// open parenthesis followed by the encodings of its children and by the
+// matching close parenthesis. Nodes are identified by the position of
+// their open parenthesis, the root is 0, and missing nodes are
+// reported as npos.
+//
+// The navigation operations are expressed in terms of the
+// forward/backward excess searches and the range-min excess query of
+// bp_vector, so each one costs at most a couple of searches in the
+// min-excess tree. The children of x are the minima of the excess in
+// (x + 1, find_close(x)], so child_count and child count and select them
+// with the per-node minimum counts of the min-excess tree; trees mapped
+// from files without the counts walk the siblings instead.
+class bp_tree : public bp_vector {
+ public:
+  static constexpr uint64_t npos = uint64_t(-1);
+
+  bp_tree() : bp_vector() {}
+
+  template <class Range>
+  bp_tree(Range const &from, min_tree_layout layout = min_tree_layout::binary)
+    : bp_vector(from, true, true, layout, 1, true) {}
+
+  void swap(bp_tree &other) { bp_vector::swap(other); }
+
+  uint64_t num_nodes() const { return size() / 2; }
+
+  uint64_t root() const { return 0; }
+
+  bool is_leaf(uint64_t x) const {
+    assert((*this)[x]);
+    return !(*this)[x + 1];
+  }
+
+  // true if x is y or one of its ancestors
+  bool is_ancestor(uint64_t x, uint64_t y) const { return x <= y && y < find_close(x); }
+
+  // root has depth 0
+  uint64_t depth(uint64_t x) const {
+    assert((*this)[x]);
+    return uint64_t(excess(x));
+  }
+
+  // number of nodes in the subtree rooted at x, including x
+  uint64_t subtree_size(uint64_t x) const { return (find_close(x) - x + 1) / 2; }
+
+  uint64_t parent(uint64_t x) const { return x ? enclose(x) : npos; }
+
+  uint64_t first_child(uint64_t x) const { return is_leaf(x) ? npos : x + 1; }
+
+  uint64_t last_child(uint64_t x) const {
+    uint64_t close = find_close(x);
+    return close == x + 1 ? npos : find_open(close - 1);
+  }
+
+  uint64_t next_sibling(uint64_t x) const {
+    uint64_t next = find_close(x) + 1;
+    return next < size() && (*this)[next] ? next : npos;
+  }
+
+  uint64_t prev_sibling(uint64_t x) const {
+    assert((*this)[x]);
+    return x && !(*this)[x - 1] ? find_open(x - 1) : npos;
+  }
+
+  // the minima after the first child are the other children and the close
+  // of x
+  uint64_t child_count(uint64_t x) const {
+    if (!has_min_counts()) {
+      uint64_t count = 0;
+      for (uint64_t c = first_child(x); c != npos; c = next_sibling(c)) { ++count; }
+      return count;
+    }
+    excess_t min_exc;
+    return excess_min_count(x + 1, find_close(x), min_exc);
+  }
+
+  // i-th child of x (0-based), npos if x has at most i children
+  uint64_t child(uint64_t x, uint64_t i) const {
+    if (!i || !has_min_counts()) {
+      uint64_t c = first_child(x);
+      for (; c != npos && i; --i) { c = next_sibling(c); }
+      return c;
+    }
+    uint64_t close = find_close(x);
+    uint64_t c     = excess_min_select(x + 1, close, i - 1);
+    return c == close ? npos : c;
+  }
+
+  // ancestor of x at depth depth(x) - d, for d <= depth(x)
+  uint64_t level_ancestor(uint64_t x, uint64_t d) const {
+    assert(d <= depth(x));
+    return d ? bwd_search(x, excess_t(d)) : x;
+  }
+
+  // Lowest common ancestor. If neither node is an ancestor of the other,
+  // the leftmost minimum excess in (x, y] is right after the close of the
+  // child of the LCA containing x, that is at the open of one of its
+  // siblings
+  uint64_t lca(uint64_t x, uint64_t y) const {
+    if (x > y) { std::swap(x, y); }
+    if (y < find_close(x)) { return x; }
+    return enclose(excess_rmq(x + 1, y));
+  }
+
+  // ranks and selects are 0-based
+  uint64_t preorder_rank(uint64_t x) const {
+    assert((*this)[x]);
+    return rank(x);
+  }
+
+  uint64_t preorder_select(uint64_t i) const { return select(i); }
+
+  uint64_t postorder_rank(uint64_t x) const { return rank0(find_close(x)); }
+
+  uint64_t postorder_select(uint64_t i) const { return find_open(select0(i)); }
+};
+
+}  // namespace succinct
@@ -1,4 +1,7 @@
 #include "bp_vector.hpp"
+
+#include <stdexcept>
+
 #include "util.hpp"
 
 namespace succinct {
@@ -37,6 +40,15 @@ class excess_tables {
       }
       m_fwd_exc[c] = (char)excess;
 
+      // m_fwd_min_count is the number of prefixes attaining m_fwd_min,
+      // not counting the empty one
+      excess            = 0;
+      m_fwd_min_count[c] = 0;
+      for (char i = 0; i < 8; ++i) {
+        excess += ((c >> i) & 1) ? 1 : -1;
+        if (-excess == m_fwd_min[c]) { ++m_fwd_min_count[c]; }
+      }
+
       // populate m_bwd_pos and m_bwd_min
       excess       = 0;
       m_bwd_min[c] = 0;
@@ -65,11 +77,13 @@ class excess_tables {
   uint8_t m_fwd_min[256];
 
   uint8_t m_fwd_min_idx[256];
+  uint8_t m_fwd_min_count[256];
 };
 
 const static excess_tables tables;
 
-inline bool find_close_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t &ret) {
+inline bool find_close_in_word_tables(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc,
+                                     uint64_t &ret) {
   assert(cur_exc > 0 && cur_exc <= 64);
   const uint64_t cum_exc_step_8 =
     (uint64_t(cur_exc) + ((2 * byte_counts - 8 * broadword::ones_step_8) << 8)) * broadword::ones_step_8;
@@ -92,7 +106,8 @@ inline bool find_close_in_word(uint64_t word, uint64_t byte_counts, bp_vector::e
   return false;
 }
 
-inline bool find_open_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t &ret) {
+inline bool find_open_in_word_tables(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc,
+                                    uint64_t &ret) {
   assert(cur_exc > 0 && cur_exc <= 64);
   const uint64_t rev_byte_counts = broadword::reverse_bytes(byte_counts);
   const uint64_t cum_exc_step_8 =
@@ -116,6 +131,140 @@ inline bool find_open_in_word(uint64_t word, uint64_t byte_counts, bp_vector::ex
   return false;
 }
 
+// The excess before each byte is computed as in the tables kernel. Within
+// the bytes, closes minus opens among the first k bits, biased by 8 so it
+// stays in [0, 16], is tracked for all the bytes at once one bit at a
+// time; the first k at which it equals the excess before the byte is the
+// match. Bit k - 1 of each byte of pos_mask is set when that happens, so
+// the lowest bit of pos_mask is the answer.
+inline bool find_close_in_word_broadword(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc,
+                                         uint64_t &ret) {
+  assert(cur_exc > 0 && cur_exc <= 64);
+  const uint64_t cum_exc_step_8 =
+    (uint64_t(cur_exc) + ((2 * byte_counts - 8 * broadword::ones_step_8) << 8)) * broadword::ones_step_8;
+  const uint64_t target = cum_exc_step_8 + 8 * broadword::ones_step_8;
+
+  uint64_t deficit  = 8 * broadword::ones_step_8;
+  uint64_t pos_mask = 0;
+  for (size_t k = 1; k <= 8; ++k) {
+    deficit += broadword::ones_step_8 - (((word >> (k - 1)) & broadword::ones_step_8) << 1);
+    uint64_t x = deficit ^ target;
+    // msb of each byte set iff the byte of x is zero
+    uint64_t eq = ~(x | ((x | broadword::msbs_step_8) - broadword::ones_step_8)) & broadword::msbs_step_8;
+    pos_mask |= eq >> (8 - k);
+  }
+
+  unsigned long pos;
+  if (broadword::lsb(pos_mask, pos)) {
+    ret = pos;
+    return true;
+  }
+  return false;
+}
+
+// Scanning backwards for an open is the same as scanning forwards for a
+// close in the complemented, reversed word
+inline bool find_open_in_word_broadword(uint64_t word, bp_vector::excess_t cur_exc, uint64_t &ret) {
+  uint64_t rev = ~broadword::reverse_bits(word);
+  if (find_close_in_word_broadword(rev, broadword::byte_counts(rev), cur_exc, ret)) {
+    ret = 63 - ret;
+    return true;
+  }
+  return false;
+}
+
+#if SUCCINCT_USE_CPU_DISPATCH
+
+// Inclusive prefix sums of the 64 bytes of x: lanes are shifted by 1, 2, 4
+// and 8 bytes with alignr against the previous 128-bit lane, then by 16
+// and 32 bytes with whole-lane shuffles
+__INTRIN_TARGET("avx512f,avx512bw")
+inline __m512i prefix_sum_epi8(__m512i x) {
+  __m512i prev = _mm512_maskz_shuffle_i64x2(0xFC, x, x, _MM_SHUFFLE(2, 1, 0, 0));
+  x            = _mm512_add_epi8(x, _mm512_alignr_epi8(x, prev, 15));
+  prev         = _mm512_maskz_shuffle_i64x2(0xFC, x, x, _MM_SHUFFLE(2, 1, 0, 0));
+  x            = _mm512_add_epi8(x, _mm512_alignr_epi8(x, prev, 14));
+  prev         = _mm512_maskz_shuffle_i64x2(0xFC, x, x, _MM_SHUFFLE(2, 1, 0, 0));
+  x            = _mm512_add_epi8(x, _mm512_alignr_epi8(x, prev, 12));
+  prev         = _mm512_maskz_shuffle_i64x2(0xFC, x, x, _MM_SHUFFLE(2, 1, 0, 0));
+  x            = _mm512_add_epi8(x, _mm512_alignr_epi8(x, prev, 8));
+  x            = _mm512_add_epi8(x, _mm512_maskz_shuffle_i64x2(0xFC, x, x, _MM_SHUFFLE(2, 1, 0, 0)));
+  x            = _mm512_add_epi8(x, _mm512_maskz_shuffle_i64x2(0xF0, x, x, _MM_SHUFFLE(1, 0, 0, 0)));
+  return x;
+}
+
+// Byte i of steps is +1 for an open and -1 for a close at bit i; the close
+// is the first bit where the prefix excess reaches -cur_exc
+__INTRIN_TARGET("avx512f,avx512bw")
+bool find_close_in_word_avx512(uint64_t word, bp_vector::excess_t cur_exc, uint64_t &ret) {
+  assert(cur_exc > 0 && cur_exc <= 64);
+  __m512i steps  = _mm512_mask_blend_epi8(word, _mm512_set1_epi8(-1), _mm512_set1_epi8(1));
+  __m512i excess = prefix_sum_epi8(steps);
+  uint64_t found = _mm512_cmpeq_epi8_mask(excess, _mm512_set1_epi8(int8_t(-cur_exc)));
+  if (!found) return false;
+  ret = broadword::lsb(found);
+  return true;
+}
+
+// The open is the last bit i where the excess of bits i..63 reaches
+// cur_exc, that is where the excess before i is the total minus cur_exc
+__INTRIN_TARGET("avx512f,avx512bw")
+bool find_open_in_word_avx512(uint64_t word, bp_vector::excess_t cur_exc, uint64_t &ret) {
+  assert(cur_exc > 0 && cur_exc <= 64);
+  int total      = 2 * int(broadword::popcount(word)) - 64;
+  __m512i steps  = _mm512_mask_blend_epi8(word, _mm512_set1_epi8(-1), _mm512_set1_epi8(1));
+  __m512i before = _mm512_sub_epi8(prefix_sum_epi8(steps), steps);
+  uint64_t found = _mm512_cmpeq_epi8_mask(before, _mm512_set1_epi8(int8_t(total - cur_exc)));
+  if (!found) return false;
+  ret = broadword::msb(found);
+  return true;
+}
+
+#endif /* SUCCINCT_USE_CPU_DISPATCH */
+
+template <bp_vector::word_kernel kernel>
+inline bool find_close_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t &ret) {
+  if constexpr (kernel == bp_vector::word_kernel::broadword) {
+    return find_close_in_word_broadword(word, byte_counts, cur_exc, ret);
+#if SUCCINCT_USE_CPU_DISPATCH
+  } else if constexpr (kernel == bp_vector::word_kernel::avx512) {
+    return find_close_in_word_avx512(word, cur_exc, ret);
+#endif
+  } else {
+    return find_close_in_word_tables(word, byte_counts, cur_exc, ret);
+  }
+}
+
+template <bp_vector::word_kernel kernel>
+inline bool find_open_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t &ret) {
+  if constexpr (kernel == bp_vector::word_kernel::broadword) {
+    return find_open_in_word_broadword(word, cur_exc, ret);
+#if SUCCINCT_USE_CPU_DISPATCH
+  } else if constexpr (kernel == bp_vector::word_kernel::avx512) {
+    return find_open_in_word_avx512(word, cur_exc, ret);
+#endif
+  } else {
+    return find_open_in_word_tables(word, byte_counts, cur_exc, ret);
+  }
+}
+
+// Bit i is set if node[i] <= excess, for the 16 minima of a B-tree node
+inline uint32_t btree_node_le_mask(const bp_vector::excess_t *node, bp_vector::excess_t excess) {
+#if SUCCINCT_USE_CPU_DISPATCH
+  __m128i threshold = _mm_set1_epi32(excess);
+  uint32_t gt_mask  = 0;
+  for (int i = 0; i < 4; ++i) {
+    __m128i minima = _mm_loadu_si128(reinterpret_cast<const __m128i *>(node) + i);
+    gt_mask |= uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(minima, threshold)))) << (4 * i);
+  }
+  return ~gt_mask & 0xFFFF;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < 16; ++i) { mask |= uint32_t(node[i] <= excess) << i; }
+  return mask;
+#endif
+}
+
 inline void excess_rmq_in_word(uint64_t word, bp_vector::excess_t &exc, uint64_t word_start,
                                bp_vector::excess_t &min_exc, uint64_t &min_exc_idx) {
   bp_vector::excess_t min_byte_exc = min_exc;
@@ -139,8 +288,47 @@ inline void excess_rmq_in_word(uint64_t word, bp_vector::excess_t &exc, uint64_t
     min_exc_idx    = word_start + shift + tables.m_fwd_min_idx[(word >> shift) & 0xFF];
   }
 }
+
+// Same as excess_rmq_in_word, but it counts the positions after the
+// start of the word attaining min_exc instead of finding the first
+inline void excess_min_count_in_word(uint64_t word, bp_vector::excess_t &exc, bp_vector::excess_t &min_exc,
+                                     uint64_t &count) {
+  for (size_t i = 0; i < 8; ++i) {
+    size_t byte                 = (word >> (i * 8)) & 0xFF;
+    bp_vector::excess_t cur_min = exc - tables.m_fwd_min[byte];
+    if (cur_min < min_exc) {
+      min_exc = cur_min;
+      count   = tables.m_fwd_min_count[byte];
+    } else if (cur_min == min_exc) {
+      count += tables.m_fwd_min_count[byte];
+    }
+    exc += tables.m_fwd_exc[byte];
+  }
+}
+
+// The i-th position after the start of the word attaining min_exc, which
+// must be the minimum of the word
+inline uint64_t min_select_in_word(uint64_t word, uint64_t word_start, bp_vector::excess_t exc,
+                                   bp_vector::excess_t min_exc, uint64_t i) {
+  for (size_t byte_idx = 0; byte_idx < 8; ++byte_idx) {
+    size_t byte = (word >> (byte_idx * 8)) & 0xFF;
+    if (exc - tables.m_fwd_min[byte] == min_exc) {
+      if (i < tables.m_fwd_min_count[byte]) {
+        for (size_t bit = 0;; ++bit) {
+          exc += ((byte >> bit) & 1) ? 1 : -1;
+          if (exc == min_exc && i-- == 0) { return word_start + byte_idx * 8 + bit + 1; }
+        }
+      }
+      i -= tables.m_fwd_min_count[byte];
+    }
+    exc += tables.m_fwd_exc[byte];
+  }
+  assert(false);
+  return -1ULL;
+}
 }  // namespace
 
+template <bp_vector::word_kernel kernel>
 inline bool bp_vector::find_close_in_block(uint64_t block_offset, bp_vector::excess_t excess, uint64_t start,
                                            uint64_t &ret) const {
   if (excess > excess_t((bp_block_size - start) * 64)) { return false; }
@@ -151,7 +339,7 @@ inline bool bp_vector::find_close_in_block(uint64_t block_offset, bp_vector::exc
     uint64_t byte_counts = broadword::byte_counts(word);
     assert(excess > 0);
     if (excess <= 64) {
-      if (find_close_in_word(word, byte_counts, excess, ret)) {
+      if (find_close_in_word<kernel>(word, byte_counts, excess, ret)) {
         ret += sub_block * 64;
         return true;
       }
@@ -161,44 +349,7 @@ inline bool bp_vector::find_close_in_block(uint64_t block_offset, bp_vector::exc
   return false;
 }
 
-uint64_t bp_vector::find_close(uint64_t pos) const {
-  assert((*this)[pos]);  // check there is an opening parenthesis in pos
-  uint64_t ret = -1U;
-  // Search in current word
-  uint64_t word_pos     = (pos + 1) / 64;
-  uint64_t shift        = (pos + 1) % 64;
-  uint64_t shifted_word = m_bits[word_pos] >> shift;
-  // Pad with "open"
-  uint64_t padded_word = shifted_word | (-!!shift & (~0ULL << (64 - shift)));
-  uint64_t byte_counts = broadword::byte_counts(padded_word);
-
-  excess_t word_exc = 1;
-  if (find_close_in_word(padded_word, byte_counts, word_exc, ret)) {
-    ret += pos + 1;
-    return ret;
-  }
-
-  // Otherwise search in the local block
-  uint64_t block        = word_pos / bp_block_size;
-  uint64_t block_offset = block * bp_block_size;
-  uint64_t sub_block    = word_pos % bp_block_size;
-  uint64_t local_rank   = broadword::bytes_sum(byte_counts) - shift;  // subtract back the padding
-  excess_t local_excess = static_cast<excess_t>((2 * local_rank) - (64 - shift));
-  if (find_close_in_block(block_offset, local_excess + 1, sub_block + 1, ret)) { return ret; }
-
-  // Otherwise, find the first appropriate block
-  excess_t pos_excess         = excess(pos);
-  uint64_t found_block        = search_min_tree<1>(block + 1, pos_excess);
-  uint64_t found_block_offset = found_block * bp_block_size;
-  excess_t found_block_excess = get_block_excess(found_block);
-
-  // Search in the found block
-  bool found = find_close_in_block(found_block_offset, found_block_excess - pos_excess, 0, ret);
-  assert(found);
-  (void)found;
-  return ret;
-}
-
+template <bp_vector::word_kernel kernel>
 inline bool bp_vector::find_open_in_block(uint64_t block_offset, bp_vector::excess_t excess, uint64_t start,
                                           uint64_t &ret) const {
   if (excess > excess_t(start * 64)) { return false; }
@@ -210,7 +361,7 @@ inline bool bp_vector::find_open_in_block(uint64_t block_offset, bp_vector::exce
     uint64_t word        = m_bits[sub_block];
     uint64_t byte_counts = broadword::byte_counts(word);
     if (excess <= 64) {
-      if (find_open_in_word(word, byte_counts, excess, ret)) {
+      if (find_open_in_word<kernel>(word, byte_counts, excess, ret)) {
         ret += sub_block * 64;
         return true;
       }
@@ -220,44 +371,113 @@ inline bool bp_vector::find_open_in_block(uint64_t block_offset, bp_vector::exce
   return false;
 }
 
-uint64_t bp_vector::find_open(uint64_t pos) const {
-  assert(pos);
-  uint64_t ret = -1U;
-  // Search in current word
-  uint64_t word_pos = (pos / 64);
-  uint64_t len      = pos % 64;
-  // Rest is padded with "close"
-  uint64_t shifted_word = -!!len & (m_bits[word_pos] << (64 - len));
-  uint64_t byte_counts  = broadword::byte_counts(shifted_word);
-
-  excess_t word_exc = 1;
-  if (find_open_in_word(shifted_word, byte_counts, word_exc, ret)) {
-    ret += pos - 64;
-    return ret;
-  }
-
-  // Otherwise search in the local block
-  uint64_t block        = word_pos / bp_block_size;
-  uint64_t block_offset = block * bp_block_size;
+template <int direction, bp_vector::word_kernel kernel>
+__INTRIN_INLINE bool bp_vector::search_local(uint64_t pos, excess_t d, uint64_t &block, uint64_t &ret) const {
+  assert(d > 0);
+  uint64_t word_pos     = pos / 64;
+  uint64_t block_offset = word_pos / bp_block_size * bp_block_size;
   uint64_t sub_block    = word_pos % bp_block_size;
-  uint64_t local_rank   = broadword::bytes_sum(byte_counts);  // no need to subtract the padding
-  excess_t local_excess = -static_cast<excess_t>((2 * local_rank) - len);
-  if (find_open_in_block(block_offset, local_excess + 1, sub_block, ret)) { return ret; }
+  block                 = word_pos / bp_block_size;
+
+  if constexpr (direction) {
+    // Search in current word
+    uint64_t shift        = pos % 64;
+    uint64_t shifted_word = m_bits[word_pos] >> shift;
+    // Pad with "open"
+    uint64_t padded_word = shifted_word | (-!!shift & (~0ULL << (64 - shift)));
+    uint64_t byte_counts = broadword::byte_counts(padded_word);
+
+    if (d <= 64 && find_close_in_word<kernel>(padded_word, byte_counts, d, ret)) {
+      ret += pos;
+      return true;
+    }
 
-  // Otherwise, find the first appropriate block
-  excess_t pos_excess         = excess(pos) - 1;
-  uint64_t found_block        = search_min_tree<0>(block - 1, pos_excess);
+    // Otherwise search in the local block
+    uint64_t local_rank   = broadword::bytes_sum(byte_counts) - shift;  // subtract back the padding
+    excess_t local_excess = static_cast<excess_t>((2 * local_rank) - (64 - shift));
+    return find_close_in_block<kernel>(block_offset, local_excess + d, sub_block + 1, ret);
+  } else {
+    // Search in current word
+    uint64_t len = pos % 64;
+    // Rest is padded with "close"
+    uint64_t shifted_word = -!!len & (m_bits[word_pos] << (64 - len));
+    uint64_t byte_counts  = broadword::byte_counts(shifted_word);
+
+    if (d <= 64 && find_open_in_word<kernel>(shifted_word, byte_counts, d, ret)) {
+      ret += pos - 64;
+      return true;
+    }
+
+    // Otherwise search in the local block
+    uint64_t local_rank   = broadword::bytes_sum(byte_counts);  // no need to subtract the padding
+    excess_t local_excess = -static_cast<excess_t>((2 * local_rank) - len);
+    return find_open_in_block<kernel>(block_offset, local_excess + d, sub_block, ret);
+  }
+}
+
+// Since a backward search ends in found_block, its own excess is added
+template <int direction, bp_vector::word_kernel kernel>
+__INTRIN_INLINE uint64_t bp_vector::search_found_block(uint64_t found_block, excess_t target_excess) const {
+  uint64_t ret                = -1U;
   uint64_t found_block_offset = found_block * bp_block_size;
-  // Since search is backwards, have to add the current block
-  excess_t found_block_excess = get_block_excess(found_block + 1);
+  excess_t block_excess       = get_block_excess(direction ? found_block : found_block + 1) - target_excess;
 
-  // Search in the found block
-  bool found = find_open_in_block(found_block_offset, found_block_excess - pos_excess, bp_block_size, ret);
+  bool found = direction ? find_close_in_block<kernel>(found_block_offset, block_excess, 0, ret)
+                         : find_open_in_block<kernel>(found_block_offset, block_excess, bp_block_size, ret);
   assert(found);
   (void)found;
   return ret;
 }
 
+template <int direction, bp_vector::word_kernel kernel>
+__INTRIN_INLINE uint64_t bp_vector::search_impl(uint64_t pos, excess_t d) const {
+  uint64_t block = 0, ret = -1U;
+  if (search_local<direction, kernel>(pos, d, block, ret)) { return ret; }
+
+  // Otherwise, find the first appropriate block
+  excess_t target_excess = excess(pos) - d;
+  uint64_t found_block   = search_min_tree<direction>(direction ? block + 1 : block - 1, target_excess);
+  return search_found_block<direction, kernel>(found_block, target_excess);
+}
+
+template <int direction>
+uint64_t bp_vector::search_with_kernel(uint64_t pos, word_kernel kernel) const {
+  switch (kernel) {
+    case word_kernel::tables: return search_impl<direction, word_kernel::tables>(pos, 1);
+    case word_kernel::broadword: return search_impl<direction, word_kernel::broadword>(pos, 1);
+    case word_kernel::avx512:
+#if SUCCINCT_USE_CPU_DISPATCH
+      if (intrinsics::cpu_has_avx512bw()) { return search_impl<direction, word_kernel::avx512>(pos, 1); }
+#endif
+      break;
+  }
+  throw std::invalid_argument("bp_vector word kernel not supported by this CPU");
+}
+
+uint64_t bp_vector::fwd_search(uint64_t pos, excess_t d) const { return search_impl<1>(pos, d); }
+
+uint64_t bp_vector::find_close(uint64_t pos) const {
+  assert((*this)[pos]);  // check there is an opening parenthesis in pos
+  return search_impl<1>(pos + 1, 1);
+}
+
+uint64_t bp_vector::bwd_search(uint64_t pos, excess_t d) const { return search_impl<0>(pos, d); }
+
+uint64_t bp_vector::find_open(uint64_t pos) const {
+  assert(pos);
+  return search_impl<0>(pos, 1);
+}
+
+uint64_t bp_vector::find_close(uint64_t pos, word_kernel kernel) const {
+  assert((*this)[pos]);
+  return search_with_kernel<1>(pos + 1, kernel);
+}
+
+uint64_t bp_vector::find_open(uint64_t pos, word_kernel kernel) const {
+  assert(pos);
+  return search_with_kernel<0>(pos, kernel);
+}
+
 template <int direction>
 inline bool bp_vector::search_block_in_superblock(uint64_t block, excess_t excess, size_t &found_block) const {
   size_t superblock          = block / superblock_size;
@@ -297,6 +517,8 @@ inline bool bp_vector::in_node_range(uint64_t node, excess_t excess) const {
 
 template <int direction>
 inline uint64_t bp_vector::search_min_tree(uint64_t block, excess_t excess) const {
+  if (m_min_tree_layout == min_tree_layout::btree) { return search_min_btree<direction>(block, excess); }
+
   size_t found_block = -1U;
   if (search_block_in_superblock<direction>(block, excess, found_block)) { return found_block; }
 
@@ -339,6 +561,251 @@ inline uint64_t bp_vector::search_min_tree(uint64_t block, excess_t excess) cons
   return found_block;
 }
 
+void bp_vector::btree_level_offsets(uint64_t *offsets) const {
+  uint64_t count = util::ceil_div(m_block_excess_min.size(), superblock_size);
+  offsets[0]     = 0;
+  for (size_t level = 0; level < m_internal_nodes; ++level) {
+    offsets[level + 1] = offsets[level] + util::ceil_div(count, min_tree_fanout) * min_tree_fanout;
+    count              = util::ceil_div(count, min_tree_fanout);
+  }
+}
+
+// Same as the binary tree search: climb from the superblock of block until
+// a node has a minimum within reach in the search direction, then descend
+// to the nearest such superblock. Each step reads a single B-tree node.
+template <int direction>
+inline uint64_t bp_vector::search_min_btree(uint64_t block, excess_t excess) const {
+  size_t found_block = -1U;
+  if (search_block_in_superblock<direction>(block, excess, found_block)) { return found_block; }
+
+  uint64_t offsets[max_min_tree_levels + 1];
+  btree_level_offsets(offsets);
+
+  uint64_t idx = block / superblock_size;
+  size_t level = 0;
+  while (true) {
+    assert(level < m_internal_nodes);
+    uint64_t node = idx / min_tree_fanout;
+    uint32_t mask = btree_node_le_mask(&m_superblock_excess_min[offsets[level] + node * min_tree_fanout], excess);
+    uint32_t slot = uint32_t(idx % min_tree_fanout);
+    // keep only the entries after (or before) idx
+    mask &= direction ? ~((uint32_t(2) << slot) - 1) : (uint32_t(1) << slot) - 1;
+    if (mask) {
+      idx = node * min_tree_fanout + (direction ? broadword::lsb(mask) : broadword::msb(mask));
+      break;
+    }
+    idx = node;
+    ++level;
+  }
+
+  while (level) {
+    --level;
+    uint32_t mask = btree_node_le_mask(&m_superblock_excess_min[offsets[level] + idx * min_tree_fanout], excess);
+    assert(mask);
+    idx = idx * min_tree_fanout + (direction ? broadword::lsb(mask) : broadword::msb(mask));
+  }
+
+  bool ret = search_block_in_superblock<direction>(idx * superblock_size + (1 - direction) * (superblock_size - 1),
+                                                   excess, found_block);
+  assert(ret);
+  (void)ret;
+
+  return found_block;
+}
+
+template <int direction>
+void bp_vector::search_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  assert(in.size() == out.size());
+  enum class stage { climbing, descending, in_superblock, found };
+
+  // state of the queries of a group that were not answered in their own
+  // block, compacted to the front of the arrays
+  size_t query[batch_group_size];
+  uint64_t pos[batch_group_size];
+  uint64_t block[batch_group_size];
+  uint64_t node[batch_group_size];  // binary tree node, or index within its btree level
+  size_t level[batch_group_size];   // btree level of node
+  excess_t target_excess[batch_group_size];
+  stage cur_stage[batch_group_size];
+
+  bool btree = m_min_tree_layout == min_tree_layout::btree;
+  uint64_t offsets[max_min_tree_levels + 1];
+  if (btree) { btree_level_offsets(offsets); }
+  auto btree_node = [&](size_t l, uint64_t idx) {
+    return &m_superblock_excess_min[offsets[l] + idx * min_tree_fanout];
+  };
+
+  auto prefetch_rank = [&](uint64_t sub_block) { m_block_rank_pairs.prefetch(sub_block / block_size * 2); };
+  auto prefetch_superblock_scan = [&](size_t i) {
+    m_block_excess_min.prefetch(block[i]);
+    prefetch_rank(block[i] / superblock_size * superblock_size * bp_block_size);
+  };
+
+  for (size_t begin = 0; begin < in.size(); begin += batch_group_size) {
+    size_t n = std::min(in.size() - begin, batch_group_size);
+
+    for (size_t i = 0; i < n; ++i) {
+      pos[i] = direction ? in[begin + i] + 1 : in[begin + i];
+      m_bits.prefetch(pos[i] / 64);
+    }
+
+    size_t m = 0;
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t local_block = 0;
+      if (search_local<direction>(pos[i], 1, local_block, out[begin + i])) { continue; }
+      query[m] = begin + i;
+      pos[m]   = pos[i];
+      block[m] = direction ? local_block + 1 : local_block - 1;
+      ++m;
+    }
+    if (!m) { continue; }
+
+    // excess of the queries and scan of the superblock they start from
+    for (size_t i = 0; i < m; ++i) {
+      prefetch_rank(pos[i] / 64);
+      prefetch_superblock_scan(i);
+    }
+    for (size_t i = 0; i < m; ++i) {
+      target_excess[i]   = excess(pos[i]) - 1;
+      size_t found_block = -1U;
+      if (search_block_in_superblock<direction>(block[i], target_excess[i], found_block)) {
+        block[i]     = found_block;
+        cur_stage[i] = stage::found;
+      } else {
+        node[i]      = btree ? block[i] / superblock_size : m_internal_nodes + block[i] / superblock_size;
+        level[i]     = 0;
+        cur_stage[i] = stage::climbing;
+      }
+    }
+
+    // the min tree searches advance in lockstep, one node per query per
+    // round; all the nodes of a round are prefetched before being read
+    while (btree) {
+      bool active = false;
+      for (size_t i = 0; i < m; ++i) {
+        if (cur_stage[i] == stage::climbing) {
+          intrinsics::prefetch(btree_node(level[i], node[i] / min_tree_fanout));
+          active = true;
+        } else if (cur_stage[i] == stage::descending) {
+          intrinsics::prefetch(btree_node(level[i] - 1, node[i]));
+          active = true;
+        }
+      }
+      if (!active) break;
+
+      for (size_t i = 0; i < m; ++i) {
+        if (cur_stage[i] == stage::climbing) {
+          uint64_t parent = node[i] / min_tree_fanout;
+          uint32_t slot   = uint32_t(node[i] % min_tree_fanout);
+          uint32_t mask   = btree_node_le_mask(btree_node(level[i], parent), target_excess[i]);
+          mask &= direction ? ~((uint32_t(2) << slot) - 1) : (uint32_t(1) << slot) - 1;
+          if (mask) {
+            node[i]      = parent * min_tree_fanout + (direction ? broadword::lsb(mask) : broadword::msb(mask));
+            cur_stage[i] = stage::descending;
+          } else {
+            node[i] = parent;
+            level[i] += 1;
+          }
+        } else if (cur_stage[i] == stage::descending) {
+          uint32_t mask = btree_node_le_mask(btree_node(level[i] - 1, node[i]), target_excess[i]);
+          assert(mask);
+          node[i] = node[i] * min_tree_fanout + (direction ? broadword::lsb(mask) : broadword::msb(mask));
+          level[i] -= 1;
+        } else {
+          continue;
+        }
+
+        if (cur_stage[i] == stage::descending && level[i] == 0) {
+          block[i]     = node[i] * superblock_size + (1 - direction) * (superblock_size - 1);
+          cur_stage[i] = stage::in_superblock;
+        }
+      }
+    }
+
+    while (!btree) {
+      bool active = false;
+      for (size_t i = 0; i < m; ++i) {
+        if (cur_stage[i] == stage::climbing) {
+          while ((node[i] & 1) == direction) { node[i] /= 2; }
+          m_superblock_excess_min.prefetch(direction ? node[i] + 1 : node[i] - 1);
+          active = true;
+        } else if (cur_stage[i] == stage::descending) {
+          m_superblock_excess_min.prefetch(node[i] * 2);
+          active = true;
+        }
+      }
+      if (!active) break;
+
+      for (size_t i = 0; i < m; ++i) {
+        if (cur_stage[i] == stage::climbing) {
+          size_t next_node = direction ? (node[i] + 1) : (node[i] - 1);
+          if (in_node_range(next_node, target_excess[i])) {
+            node[i]      = next_node;
+            cur_stage[i] = stage::descending;
+          } else {
+            node[i] /= 2;
+          }
+        } else if (cur_stage[i] == stage::descending) {
+          size_t next_node = node[i] * 2 + (1 - direction);
+          if (!in_node_range(next_node, target_excess[i])) {
+            next_node = direction ? (next_node + 1) : (next_node - 1);
+          }
+          node[i] = next_node;
+        } else {
+          continue;
+        }
+
+        if (cur_stage[i] == stage::descending && node[i] >= m_internal_nodes) {
+          uint64_t superblock = node[i] - m_internal_nodes;
+          block[i]            = superblock * superblock_size + (1 - direction) * (superblock_size - 1);
+          cur_stage[i]        = stage::in_superblock;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+      if (cur_stage[i] == stage::in_superblock) { prefetch_superblock_scan(i); }
+    }
+    for (size_t i = 0; i < m; ++i) {
+      if (cur_stage[i] == stage::in_superblock) {
+        size_t found_block = -1U;
+        bool ret           = search_block_in_superblock<direction>(block[i], target_excess[i], found_block);
+        assert(ret);
+        (void)ret;
+        block[i] = found_block;
+      }
+    }
+
+    for (size_t i = 0; i < m; ++i) {
+      m_bits.prefetch(block[i] * bp_block_size);
+      prefetch_rank((block[i] + 1 - direction) * bp_block_size);
+    }
+    for (size_t i = 0; i < m; ++i) { out[query[i]] = search_found_block<direction>(block[i], target_excess[i]); }
+  }
+}
+
+void bp_vector::find_close_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  search_batch<1>(in, out);
+}
+
+void bp_vector::find_open_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  search_batch<0>(in, out);
+}
+
+bool bp_vector::word_kernel_supported(word_kernel kernel) {
+  switch (kernel) {
+    case word_kernel::tables:
+    case word_kernel::broadword: return true;
+    case word_kernel::avx512:
+#if SUCCINCT_USE_CPU_DISPATCH
+      return intrinsics::cpu_has_avx512bw();
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
 bp_vector::excess_t bp_vector::excess(uint64_t pos) const { return static_cast<excess_t>(2 * rank(pos) - pos); }
 
 void bp_vector::excess_rmq_in_block(uint64_t start, uint64_t end, bp_vector::excess_t &exc,
@@ -371,6 +838,10 @@ void bp_vector::excess_rmq_in_superblock(uint64_t block_start, uint64_t block_en
 void bp_vector::find_min_superblock(uint64_t superblock_start, uint64_t superblock_end,
                                     bp_vector::excess_t &superblock_min_exc, uint64_t &superblock_min_idx) const {
   if (superblock_start == superblock_end) return;
+  if (m_min_tree_layout == min_tree_layout::btree) {
+    find_min_superblock_btree(superblock_start, superblock_end, superblock_min_exc, superblock_min_idx);
+    return;
+  }
 
   uint64_t cur_node       = m_internal_nodes + superblock_start;
   uint64_t rightmost_span = superblock_start;
@@ -465,10 +936,65 @@ void bp_vector::find_min_superblock(uint64_t superblock_start, uint64_t superblo
   }
 }
 
-uint64_t bp_vector::excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc) const {
+void bp_vector::find_min_superblock_btree(uint64_t superblock_start, uint64_t superblock_end,
+                                          bp_vector::excess_t &superblock_min_exc,
+                                          uint64_t &superblock_min_idx) const {
+  uint64_t offsets[max_min_tree_levels + 1];
+  btree_level_offsets(offsets);
+
+  // The range is covered by the partial nodes at its ends on each level,
+  // going up until both ends fall in the same node. The left parts are
+  // scanned on the way up and the right ones on the way back, so that
+  // entries are compared left to right and ties go to the leftmost
+  excess_t min_exc = superblock_min_exc;
+  size_t min_level = 0;
+  uint64_t min_idx = -1U;
+  auto scan        = [&](size_t level, uint64_t begin, uint64_t end) {
+    for (uint64_t idx = begin; idx < end; ++idx) {
+      if (m_superblock_excess_min[offsets[level] + idx] < min_exc) {
+        min_exc   = m_superblock_excess_min[offsets[level] + idx];
+        min_level = level;
+        min_idx   = idx;
+      }
+    }
+  };
+
+  uint64_t right_begin[max_min_tree_levels], right_end[max_min_tree_levels];
+  uint64_t begin = superblock_start, end = superblock_end;
+  size_t level   = 0;
+  while (begin / min_tree_fanout != (end - 1) / min_tree_fanout) {
+    uint64_t left_end  = util::ceil_div(begin, min_tree_fanout) * min_tree_fanout;
+    right_begin[level] = end / min_tree_fanout * min_tree_fanout;
+    right_end[level]   = end;
+    scan(level, begin, left_end);
+    begin = left_end / min_tree_fanout;
+    end   = right_begin[level] / min_tree_fanout;
+    ++level;
+    if (begin == end) { break; }
+  }
+  scan(level, begin, end);
+  for (size_t l = level; l > 0; --l) { scan(l - 1, right_begin[l - 1], right_end[l - 1]); }
+
+  if (min_idx == uint64_t(-1U)) { return; }
+
+  // descend to the leftmost superblock attaining the minimum
+  for (; min_level > 0; --min_level) {
+    uint64_t child = min_idx * min_tree_fanout;
+    while (m_superblock_excess_min[offsets[min_level - 1] + child] != min_exc) { ++child; }
+    min_idx = child;
+  }
+
+  superblock_min_exc = min_exc;
+  superblock_min_idx = min_idx;
+  assert(superblock_min_idx >= superblock_start);
+  assert(superblock_min_idx < superblock_end);
+}
+
+uint64_t bp_vector::excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc, excess_t exc_a) const {
   assert(a <= b);
+  assert(exc_a == excess(a));
 
-  excess_t cur_exc     = excess(a);
+  excess_t cur_exc     = exc_a;
   min_exc              = cur_exc;
   uint64_t min_exc_idx = a;
 
@@ -502,6 +1028,13 @@ uint64_t bp_vector::excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc) const
     // same block
     excess_rmq_in_block(word_a_idx + 1, word_b_idx, cur_exc, min_exc, min_exc_idx);
 
+  } else if (word_b_idx - word_a_idx <= short_rmq_words) {
+    // few enough words that scanning them is cheaper than the rank lookups
+    // needed to use the block minima
+    for (uint64_t w = word_a_idx + 1; w < word_b_idx; ++w) {
+      excess_rmq_in_word(m_bits[w], cur_exc, w * 64, min_exc, min_exc_idx);
+    }
+
   } else {
     // search in partial block of word_a
     excess_rmq_in_block(word_a_idx + 1, (block_a + 1) * bp_block_size, cur_exc, min_exc, min_exc_idx);
@@ -559,79 +1092,377 @@ uint64_t bp_vector::excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc) const
   return min_exc_idx;
 }
 
-void bp_vector::build_min_tree() {
-  if (!size()) return;
+uint64_t bp_vector::word_excess_rmq(uint64_t word, excess_t &min_exc) {
+  excess_t exc     = 0;
+  uint64_t min_idx = 0;
+  min_exc          = 0;
+  excess_rmq_in_word(word, exc, 0, min_exc, min_idx);
+  return min_idx;
+}
 
-  std::vector<block_min_excess_t> block_excess_min;
-  excess_t cur_block_min = 0, cur_superblock_excess = 0;
-  for (uint64_t sub_block = 0; sub_block < m_bits.size(); ++sub_block) {
-    if (sub_block % bp_block_size == 0) {
-      if (sub_block % (bp_block_size * superblock_size) == 0) { cur_superblock_excess = 0; }
-      if (sub_block) {
-        assert(cur_block_min >= std::numeric_limits<block_min_excess_t>::min());
-        assert(cur_block_min <= std::numeric_limits<block_min_excess_t>::max());
-        block_excess_min.push_back((block_min_excess_t)cur_block_min);
-        cur_block_min = cur_superblock_excess;
-      }
+// Same decomposition as excess_rmq, except that all the blocks and min
+// tree nodes in the range are visited instead of only the minimum
+template <typename Fn>
+void bp_vector::for_each_min_piece(uint64_t a, uint64_t b, Fn fn) const {
+  assert(a < b);
+  uint64_t offsets[max_min_tree_levels + 1];
+  if (m_min_tree_layout == min_tree_layout::btree) { btree_level_offsets(offsets); }
+
+  auto word_piece = [&](uint64_t bits, uint64_t pos, excess_t &exc) {
+    min_piece piece{min_piece::word, 0, 0, bits, pos, exc, exc, 0};
+    excess_min_count_in_word(bits, exc, piece.min_exc, piece.count);
+    return fn(piece);
+  };
+  auto words_piece = [&](uint64_t begin, uint64_t end, excess_t &exc) {
+    for (uint64_t w = begin; w < end; ++w) {
+      if (word_piece(m_bits[w], w * 64, exc)) { return true; }
     }
-    uint64_t word = m_bits[sub_block];
-    uint64_t mask = 1ULL;
-    // for last block stop at bit boundary
-    uint64_t n_bits = (sub_block == m_bits.size() - 1 && size() % 64) ? size() % 64 : 64;
-    // XXX(ot) use tables.m_fwd_{min,max}
-    for (uint64_t i = 0; i < n_bits; ++i) {
-      cur_superblock_excess += (word & mask) ? 1 : -1;
-      cur_block_min = std::min(cur_block_min, cur_superblock_excess);
-      mask <<= 1;
+    return false;
+  };
+  auto blocks_piece = [&](uint64_t begin, uint64_t end) {
+    if (begin == end) { return false; }
+    excess_t superblock_excess = get_block_excess(begin / superblock_size * superblock_size);
+    for (uint64_t block = begin; block < end; ++block) {
+      min_piece piece{min_piece::block, block, 0, 0, 0, 0, superblock_excess + m_block_excess_min[block],
+                      m_block_min_count[block]};
+      if (fn(piece)) { return true; }
     }
-  }
-  // Flush last block mins
-  assert(cur_block_min >= std::numeric_limits<block_min_excess_t>::min());
-  assert(cur_block_min <= std::numeric_limits<block_min_excess_t>::max());
-  block_excess_min.push_back((block_min_excess_t)cur_block_min);
+    return false;
+  };
+  auto node_piece = [&](uint64_t level, uint64_t idx) {
+    uint64_t node = (m_min_tree_layout == min_tree_layout::btree) ? offsets[level] + idx : idx;
+    min_piece piece{min_piece::node, idx, level, 0, 0, 0, m_superblock_excess_min[node], m_superblock_min_count[node]};
+    return fn(piece);
+  };
+
+  excess_t cur_exc    = excess(a);
+  uint64_t word_a_idx = a / 64;
+  uint64_t word_b_idx = (b - 1) / 64;
+
+  uint64_t shift_a       = a % 64;
+  uint64_t subword_len_a = std::min(64 - shift_a, b - a);
+  uint64_t word_a        = m_bits[word_a_idx] >> shift_a;
+  if (subword_len_a != 64) { word_a |= ~0ULL << subword_len_a; }
+  if (word_piece(word_a, a, cur_exc)) { return; }
+  if (word_a_idx == word_b_idx) { return; }
+  cur_exc -= 64 - excess_t(subword_len_a);  // remove padding
 
-  size_t n_blocks = util::ceil_div(data().size(), bp_block_size);
-  assert(n_blocks == block_excess_min.size());
+  uint64_t block_a = word_a_idx / bp_block_size;
+  uint64_t block_b = word_b_idx / bp_block_size;
+  if (block_a == block_b || word_b_idx - word_a_idx <= short_rmq_words) {
+    if (words_piece(word_a_idx + 1, word_b_idx, cur_exc)) { return; }
+  } else {
+    if (words_piece(word_a_idx + 1, (block_a + 1) * bp_block_size, cur_exc)) { return; }
 
-  size_t n_superblocks = (n_blocks + superblock_size - 1) / superblock_size;
+    uint64_t superblock_a = (block_a + 1) / superblock_size;
+    uint64_t superblock_b = block_b / superblock_size;
+    if (superblock_a == superblock_b) {
+      if (blocks_piece(block_a + 1, block_b)) { return; }
+    } else {
+      if (blocks_piece(block_a + 1, (superblock_a + 1) * superblock_size)) { return; }
+
+      uint64_t begin = superblock_a + 1, end = superblock_b;
+      if (m_min_tree_layout == min_tree_layout::btree) {
+        // left partial nodes on the way up, right ones on the way back
+        uint64_t right_begin[max_min_tree_levels], right_end[max_min_tree_levels];
+        size_t level = 0;
+        while (begin < end && begin / min_tree_fanout != (end - 1) / min_tree_fanout) {
+          uint64_t left_end  = util::ceil_div(begin, min_tree_fanout) * min_tree_fanout;
+          right_begin[level] = end / min_tree_fanout * min_tree_fanout;
+          right_end[level]   = end;
+          for (uint64_t idx = begin; idx < left_end; ++idx) {
+            if (node_piece(level, idx)) { return; }
+          }
+          begin = left_end / min_tree_fanout;
+          end   = right_begin[level] / min_tree_fanout;
+          ++level;
+        }
+        for (uint64_t idx = begin; idx < end; ++idx) {
+          if (node_piece(level, idx)) { return; }
+        }
+        for (size_t l = level; l > 0; --l) {
+          for (uint64_t idx = right_begin[l - 1]; idx < right_end[l - 1]; ++idx) {
+            if (node_piece(l - 1, idx)) { return; }
+          }
+        }
+      } else {
+        // the usual bottom-up segment tree decomposition
+        uint64_t left_nodes[64], right_nodes[64];
+        size_t n_left = 0, n_right = 0;
+        for (begin += m_internal_nodes, end += m_internal_nodes; begin < end; begin /= 2, end /= 2) {
+          if (begin & 1) { left_nodes[n_left++] = begin++; }
+          if (end & 1) { right_nodes[n_right++] = --end; }
+        }
+        for (size_t i = 0; i < n_left; ++i) {
+          if (node_piece(0, left_nodes[i])) { return; }
+        }
+        for (size_t i = n_right; i > 0; --i) {
+          if (node_piece(0, right_nodes[i - 1])) { return; }
+        }
+      }
+
+      if (blocks_piece(superblock_b * superblock_size, block_b)) { return; }
+    }
 
-  size_t n_complete_leaves = 1;
-  while (n_complete_leaves < n_superblocks)
-    n_complete_leaves <<= 1;  // XXX(ot): I'm sure this can be done with broadword::msb...
-  // n_complete_leaves is the smallest power of 2 >= n_superblocks
-  m_internal_nodes = n_complete_leaves;
-  size_t treesize  = m_internal_nodes + n_superblocks;
+    cur_exc = get_block_excess(block_b);
+    if (words_piece(block_b * bp_block_size, word_b_idx, cur_exc)) { return; }
+  }
 
-  std::vector<excess_t> superblock_excess_min(treesize);
+  uint64_t offset_b = b % 64;
+  uint64_t word_b   = m_bits[word_b_idx];
+  if (offset_b != 0) { word_b |= ~0ULL << offset_b; }
+  word_piece(word_b, word_b_idx * 64, cur_exc);
+}
 
-  // Fill in the leaves of the tree
-  for (size_t superblock = 0; superblock < n_superblocks; ++superblock) {
-    excess_t cur_super_min     = static_cast<excess_t>(size());
-    excess_t superblock_excess = get_block_excess(superblock * superblock_size);
+uint64_t bp_vector::excess_min_count(uint64_t a, uint64_t b, excess_t &min_exc) const {
+  assert(has_min_counts());
+  assert(a <= b);
+  min_exc = excess(a);
+  if (a == b) { return 0; }
+
+  uint64_t count = 0;
+  for_each_min_piece(a, b, [&](min_piece const &piece) {
+    if (piece.min_exc < min_exc) {
+      min_exc = piece.min_exc;
+      count   = piece.count;
+    } else if (piece.min_exc == min_exc) {
+      count += piece.count;
+    }
+    return false;
+  });
+  return count;
+}
 
-    for (size_t block = superblock * superblock_size; block < std::min((superblock + 1) * superblock_size, n_blocks);
-         ++block) {
-      cur_super_min = std::min(cur_super_min, superblock_excess + block_excess_min[block]);
+uint64_t bp_vector::excess_min_select(uint64_t a, uint64_t b, uint64_t i) const {
+  assert(has_min_counts());
+  assert(a <= b);
+  if (a == b) { return -1ULL; }
+
+  excess_t min_exc;
+  excess_rmq(a, b, min_exc);
+  uint64_t ret = -1ULL;
+  for_each_min_piece(a, b, [&](min_piece piece) {
+    if (piece.min_exc != min_exc) { return false; }
+    if (i >= piece.count) {
+      i -= piece.count;
+      return false;
     }
-    assert(cur_super_min >= 0 && cur_super_min < excess_t(size()));
+    ret = min_select_in_piece(piece, i);
+    return true;
+  });
+  assert(ret == -1ULL || (ret > a && ret <= b && excess(ret) == min_exc));
+  return ret;
+}
 
-    superblock_excess_min[m_internal_nodes + superblock] = cur_super_min;
+uint64_t bp_vector::min_select_in_piece(min_piece piece, uint64_t i) const {
+  if (piece.kind == min_piece::word) { return min_select_in_word(piece.bits, piece.pos, piece.exc, piece.min_exc, i); }
+
+  // descend to the superblock, taking the leftmost child with enough
+  // positions attaining the minimum; past-the-end children have count 0
+  uint64_t block = piece.idx;
+  if (piece.kind == min_piece::node) {
+    uint64_t superblock;
+    if (m_min_tree_layout == min_tree_layout::btree) {
+      uint64_t offsets[max_min_tree_levels + 1];
+      btree_level_offsets(offsets);
+      uint64_t idx = piece.idx;
+      for (uint64_t level = piece.level; level > 0; --level) {
+        uint64_t child = idx * min_tree_fanout;
+        for (;; ++child) {
+          uint64_t node = offsets[level - 1] + child;
+          if (m_superblock_excess_min[node] != piece.min_exc) { continue; }
+          if (i < m_superblock_min_count[node]) { break; }
+          i -= m_superblock_min_count[node];
+        }
+        idx = child;
+      }
+      superblock = idx;
+    } else {
+      uint64_t node = piece.idx;
+      while (node < m_internal_nodes) {
+        node *= 2;
+        if (m_superblock_excess_min[node] == piece.min_exc) {
+          if (i < m_superblock_min_count[node]) { continue; }
+          i -= m_superblock_min_count[node];
+        }
+        node += 1;
+      }
+      superblock = node - m_internal_nodes;
+    }
+
+    excess_t superblock_excess = get_block_excess(superblock * superblock_size);
+    for (block = superblock * superblock_size;; ++block) {
+      assert(block < m_block_excess_min.size());
+      if (superblock_excess + m_block_excess_min[block] != piece.min_exc) { continue; }
+      if (i < m_block_min_count[block]) { break; }
+      i -= m_block_min_count[block];
+    }
   }
 
-  // fill in the internal nodes with past-the-boundary values
-  // (they will also serve as sentinels in debug)
-  for (size_t node = 0; node < m_internal_nodes; ++node) {
-    superblock_excess_min[node] = static_cast<excess_t>(size());
+  excess_t exc = get_block_excess(block);
+  for (uint64_t w = block * bp_block_size;; ++w) {
+    assert(w < std::min((block + 1) * bp_block_size, m_bits.size()));
+    uint64_t word = m_bits[w];
+    if (w == m_bits.size() - 1 && size() % 64) { word |= ~0ULL << (size() % 64); }
+
+    excess_t word_exc = exc, word_min_exc = exc;
+    uint64_t count = 0;
+    excess_min_count_in_word(word, exc, word_min_exc, count);
+    if (word_min_exc == piece.min_exc) {
+      if (i < count) { return min_select_in_word(word, w * 64, word_exc, piece.min_exc, i); }
+      i -= count;
+    }
   }
+}
+
+void bp_vector::build_min_tree(size_t num_threads, bool with_min_counts) {
+  if (!size()) return;
+
+  size_t n_blocks      = util::ceil_div(data().size(), bp_block_size);
+  size_t n_superblocks = (n_blocks + superblock_size - 1) / superblock_size;
+  num_threads          = std::max<size_t>(
+    1, std::min<uint64_t>(util::resolve_num_threads(num_threads), n_superblocks / min_superblocks_per_thread));
+
+  // The block minima are relative to the superblock start, so the
+  // superblocks can be scanned independently. The counts of the minima are
+  // only kept if with_min_counts is set
+  std::vector<block_min_excess_t> block_excess_min(n_blocks);
+  std::vector<excess_t> superblock_min(n_superblocks);
+  std::vector<uint8_t> block_min_count(with_min_counts ? n_blocks : 0);
+  std::vector<uint64_t> superblock_count(with_min_counts ? n_superblocks : 0);
+  util::parallel_ranges(n_superblocks, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+    for (uint64_t superblock = begin; superblock < end; ++superblock) {
+      excess_t cur_superblock_excess = 0;
+      excess_t cur_super_min         = static_cast<excess_t>(size());
+      uint64_t cur_super_count       = 0;
+      excess_t superblock_excess     = get_block_excess(superblock * superblock_size);
+
+      for (size_t block = superblock * superblock_size; block < std::min((superblock + 1) * superblock_size, n_blocks);
+           ++block) {
+        excess_t cur_block_min   = cur_superblock_excess;
+        uint64_t cur_block_count = 0;
+        for (uint64_t sub_block = block * bp_block_size;
+             sub_block < std::min((block + 1) * bp_block_size, m_bits.size()); ++sub_block) {
+          uint64_t word = m_bits[sub_block];
+          if (sub_block == m_bits.size() - 1 && size() % 64) {
+            // for last block stop at bit boundary
+            for (uint64_t i = 0; i < size() % 64; ++i) {
+              cur_superblock_excess += (word >> i & 1) ? 1 : -1;
+              if (cur_superblock_excess < cur_block_min) {
+                cur_block_min   = cur_superblock_excess;
+                cur_block_count = 1;
+              } else if (cur_superblock_excess == cur_block_min) {
+                ++cur_block_count;
+              }
+            }
+          } else {
+            excess_min_count_in_word(word, cur_superblock_excess, cur_block_min, cur_block_count);
+          }
+        }
 
-  // Fill bottom-up the other layers: each node updates the parent
-  for (size_t node = treesize - 1; node > 1; --node) {
-    size_t parent                 = node / 2;
-    superblock_excess_min[parent] = std::min(superblock_excess_min[parent],  // same node
-                                             superblock_excess_min[node]);
+        assert(cur_block_min >= std::numeric_limits<block_min_excess_t>::min());
+        assert(cur_block_min <= std::numeric_limits<block_min_excess_t>::max());
+        block_excess_min[block] = (block_min_excess_t)cur_block_min;
+        if (with_min_counts) { block_min_count[block] = uint8_t(cur_block_count); }
+        if (superblock_excess + cur_block_min < cur_super_min) {
+          cur_super_min   = superblock_excess + cur_block_min;
+          cur_super_count = cur_block_count;
+        } else if (superblock_excess + cur_block_min == cur_super_min) {
+          cur_super_count += cur_block_count;
+        }
+      }
+      assert(cur_super_min >= 0 && cur_super_min < excess_t(size()));
+
+      superblock_min[superblock] = cur_super_min;
+      if (with_min_counts) { superblock_count[superblock] = cur_super_count; }
+    }
+  });
+
+  // Each level of the tree is reduced from the one below it in parallel
+  auto reduce_level = [&](uint64_t n_nodes, auto fn) {
+    size_t level_threads = std::max<size_t>(1, std::min<uint64_t>(num_threads, n_nodes / min_superblocks_per_thread));
+    util::parallel_ranges(n_nodes, level_threads, [&](size_t, uint64_t begin, uint64_t end) {
+      for (uint64_t node = begin; node < end; ++node) { fn(node); }
+    });
+  };
+
+  // The count of a node sums those of the children attaining its minimum
+  std::vector<excess_t> superblock_excess_min;
+  std::vector<uint64_t> superblock_min_count;
+  if (m_min_tree_layout == min_tree_layout::btree) {
+    // levels bottom-up, each padded with size() to whole nodes, until a
+    // level fits in a single node
+    std::vector<excess_t> level_min   = superblock_min;
+    std::vector<uint64_t> level_count = superblock_count;
+    m_internal_nodes                  = 0;
+    while (true) {
+      size_t n_nodes = util::ceil_div(level_min.size(), min_tree_fanout);
+      superblock_excess_min.insert(superblock_excess_min.end(), level_min.begin(), level_min.end());
+      superblock_excess_min.resize(superblock_excess_min.size() + n_nodes * min_tree_fanout - level_min.size(),
+                                   static_cast<excess_t>(size()));
+      if (with_min_counts) {
+        superblock_min_count.insert(superblock_min_count.end(), level_count.begin(), level_count.end());
+        superblock_min_count.resize(superblock_excess_min.size(), 0);
+      }
+      m_internal_nodes += 1;
+      if (n_nodes == 1) { break; }
+
+      std::vector<excess_t> parent_min(n_nodes);
+      std::vector<uint64_t> parent_count(with_min_counts ? n_nodes : 0);
+      reduce_level(n_nodes, [&](uint64_t node) {
+        size_t node_end  = std::min((node + 1) * min_tree_fanout, level_min.size());
+        parent_min[node] = *std::min_element(level_min.begin() + ptrdiff_t(node * min_tree_fanout),
+                                             level_min.begin() + ptrdiff_t(node_end));
+        if (!with_min_counts) { return; }
+        for (size_t child = node * min_tree_fanout; child < node_end; ++child) {
+          if (level_min[child] == parent_min[node]) { parent_count[node] += level_count[child]; }
+        }
+      });
+      level_min.swap(parent_min);
+      level_count.swap(parent_count);
+    }
+    assert(m_internal_nodes <= max_min_tree_levels);
+  } else {
+    size_t n_complete_leaves = 1;
+    while (n_complete_leaves < n_superblocks)
+      n_complete_leaves <<= 1;  // XXX(ot): I'm sure this can be done with broadword::msb...
+    // n_complete_leaves is the smallest power of 2 >= n_superblocks
+    m_internal_nodes = n_complete_leaves;
+    size_t treesize  = m_internal_nodes + n_superblocks;
+
+    // past-the-boundary values (they will also serve as sentinels in debug)
+    superblock_excess_min.assign(treesize, static_cast<excess_t>(size()));
+    superblock_min_count.assign(with_min_counts ? treesize : 0, 0);
+
+    // Fill in the leaves of the tree
+    std::copy(superblock_min.begin(), superblock_min.end(),
+              superblock_excess_min.begin() + ptrdiff_t(m_internal_nodes));
+    std::copy(superblock_count.begin(), superblock_count.end(),
+              superblock_min_count.begin() + ptrdiff_t(m_internal_nodes));
+
+    // Fill bottom-up the other layers, nodes [level, 2 * level) at a time:
+    // each node is the minimum of its children
+    for (size_t level = m_internal_nodes / 2; level >= 1; level /= 2) {
+      reduce_level(level, [&](uint64_t i) {
+        size_t node = level + i;
+        for (size_t child = 2 * node; child < std::min(2 * node + 2, treesize); ++child) {
+          superblock_excess_min[node] = std::min(superblock_excess_min[node], superblock_excess_min[child]);
+        }
+        if (!with_min_counts) { return; }
+        for (size_t child = 2 * node; child < std::min(2 * node + 2, treesize); ++child) {
+          if (superblock_excess_min[child] == superblock_excess_min[node]) {
+            superblock_min_count[node] += superblock_min_count[child];
+          }
+        }
+      });
+    }
   }
 
   m_block_excess_min.steal(block_excess_min);
   m_superblock_excess_min.steal(superblock_excess_min);
+  if (with_min_counts) {
+    m_block_min_count.steal(block_min_count);
+    m_superblock_min_count.steal(superblock_min_count);
+  }
 }
 }  // namespace succinct
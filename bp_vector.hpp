@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <limits>
 #include <ranges>
+#include <span>
 #include <vector>
 
 #include "rs_bit_vector.hpp"
@@ -11,56 +12,173 @@ namespace succinct {
 
 class bp_vector : public rs_bit_vector {
  public:
-  bp_vector() : rs_bit_vector() {}
-
+  // Layout of the tree of superblock excess minima searched by
+  // find_close/find_open when the match is not in the nearby blocks: a
+  // binary heap, or a B-tree with min_tree_fanout minima per 64-byte node,
+  // which packs four levels of the binary tree in each cache line and
+  // picks the child with a vectorized compare
+  enum class min_tree_layout : uint64_t { binary, btree };
+
+  bp_vector() : rs_bit_vector(), m_min_tree_layout(min_tree_layout::binary), m_internal_nodes(0) {}
+
+  // num_threads is the number of threads used to build the rank/select
+  // indices and the min tree (0 means one per hardware thread); the result
+  // does not depend on it. with_min_counts also stores how many times each
+  // block and min tree node attains its minimum, for excess_min_count and
+  // excess_min_select.
   template <class Range>
-  bp_vector(Range const &from, bool with_select_hints = false, bool with_select0_hints = false)
-      : rs_bit_vector(from, with_select_hints, with_select0_hints) {
-    build_min_tree();
+  bp_vector(Range const &from, bool with_select_hints = false, bool with_select0_hints = false,
+            min_tree_layout layout = min_tree_layout::binary, size_t num_threads = 1, bool with_min_counts = false)
+      : rs_bit_vector(from, with_select_hints, with_select0_hints, num_threads),
+        m_min_tree_layout(layout),
+        m_internal_nodes(0) {
+    build_min_tree(num_threads, with_min_counts);
   }
 
   template <typename Visitor>
   void map(Visitor &visit) {
     rs_bit_vector::map(visit);
-    visit(m_internal_nodes, "m_internal_nodes")(m_block_excess_min, "m_block_excess_min")(m_superblock_excess_min,
-                                                                                          "m_superblock_excess_min");
+    // legacy files only have the binary layout
+    visit.versioned(m_min_tree_layout, "m_min_tree_layout")(m_internal_nodes, "m_internal_nodes")(
+      m_block_excess_min, "m_block_excess_min")(m_superblock_excess_min, "m_superblock_excess_min");
+    // nor the min counts
+    visit.versioned(m_block_min_count, "m_block_min_count").versioned(m_superblock_min_count, "m_superblock_min_count");
   }
 
   void swap(bp_vector &other) {
     rs_bit_vector::swap(other);
+    std::swap(m_min_tree_layout, other.m_min_tree_layout);
     std::swap(m_internal_nodes, other.m_internal_nodes);
     m_block_excess_min.swap(other.m_block_excess_min);
     m_superblock_excess_min.swap(other.m_superblock_excess_min);
+    m_block_min_count.swap(other.m_block_min_count);
+    m_superblock_min_count.swap(other.m_superblock_min_count);
   }
 
+  min_tree_layout layout() const { return m_min_tree_layout; }
+
+  bool has_min_counts() const { return m_block_min_count.size() != 0; }
+
   uint64_t find_open(uint64_t pos) const;
   uint64_t find_close(uint64_t pos) const;
 
+  typedef int32_t excess_t;  // Allow at most 2^31 depth of the tree
+
+  // smallest j >= pos such that excess(j + 1) == excess(pos) - d, for
+  // 0 < d <= excess(pos); find_close(pos) is fwd_search(pos + 1, 1)
+  uint64_t fwd_search(uint64_t pos, excess_t d) const;
+  // largest j < pos such that excess(j) == excess(pos) - d, for
+  // 0 < d <= excess(pos); find_open(pos) is bwd_search(pos, 1)
+  uint64_t bwd_search(uint64_t pos, excess_t d) const;
+
+  // Batched versions of find_close() and find_open(): out[i] is set to the
+  // result for in[i]. The searches of a group of batch_group_size queries
+  // advance in lockstep through the word, the block and each level of the
+  // min tree, and the entries every step reads are prefetched for the
+  // whole group before any of them is used.
+  void find_close_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+  void find_open_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+
   uint64_t enclose(uint64_t pos) const {
     assert((*this)[pos]);
     return find_open(pos);
   }
 
-  typedef int32_t excess_t;  // Allow at most 2^31 depth of the tree
+  // Kernels that search a single word for the parenthesis matching an
+  // excess, used by find_close and find_open: per-byte lookup tables,
+  // table-free broadword arithmetic, or AVX-512BW prefix sums of the
+  // +1/-1 steps
+  enum class word_kernel { tables, broadword, avx512 };
+
+  // Same as find_close(pos) and find_open(pos), which use the tables,
+  // with the given kernel; it is chosen once per search, not per word. A
+  // kernel the CPU does not support throws std::invalid_argument.
+  uint64_t find_close(uint64_t pos, word_kernel kernel) const;
+  uint64_t find_open(uint64_t pos, word_kernel kernel) const;
+  static bool word_kernel_supported(word_kernel kernel);
 
   excess_t excess(uint64_t pos) const;
-  uint64_t excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc) const;
+
+  inline uint64_t excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc) const {
+    return excess_rmq(a, b, min_exc, excess(a));
+  }
+
+  // Same as above, for callers that already know exc_a = excess(a) and
+  // can save the rank
+  uint64_t excess_rmq(uint64_t a, uint64_t b, excess_t &min_exc, excess_t exc_a) const;
 
   inline uint64_t excess_rmq(uint64_t a, uint64_t b) const {
     excess_t foo;
     return excess_rmq(a, b, foo);
   }
 
+  // Leftmost minimum of the excess at the 65 positions from the start to
+  // the end of word, relative to the excess at its start: returns its
+  // offset and sets min_exc
+  static uint64_t word_excess_rmq(uint64_t word, excess_t &min_exc);
+
+  // Number of j in (a, b] such that excess(j) is the minimum excess in
+  // [a, b], which is returned in min_exc. Requires has_min_counts(): the
+  // range is covered with the same blocks and min tree nodes as
+  // excess_rmq, and their counts are summed.
+  uint64_t excess_min_count(uint64_t a, uint64_t b, excess_t &min_exc) const;
+
+  // The i-th (0-based) of the positions counted by excess_min_count, or -1
+  // if there are at most i of them. Requires has_min_counts().
+  uint64_t excess_min_select(uint64_t a, uint64_t b, uint64_t i) const;
+
  protected:
   static const size_t bp_block_size =
     4;  // to increase confusion, bp block_size is not necessarily rs_bit_vector block_size
   static const size_t superblock_size = 32;  // number of blocks in superblock
+  static const size_t short_rmq_words = 8;   // excess_rmq scans shorter ranges word by word
 
   typedef int16_t block_min_excess_t;  // superblock must be at most 2^15 - 1 bits
 
+  // Forward (direction = 1) and backward (direction = 0) excess searches,
+  // shared by the public searches and find_close/find_open, which pass
+  // d = 1 so it can be folded into the word kernels. search_local looks
+  // in the word and the block of pos, and on failure sets block to the
+  // block of pos; search_found_block looks in the block returned by
+  // search_min_tree. The word kernel is a template parameter so that the
+  // word loops do not branch on it.
+  template <int direction, word_kernel kernel = word_kernel::tables>
+  uint64_t search_impl(uint64_t pos, excess_t d) const;
+  template <int direction, word_kernel kernel = word_kernel::tables>
+  bool search_local(uint64_t pos, excess_t d, uint64_t &block, uint64_t &ret) const;
+  template <int direction, word_kernel kernel = word_kernel::tables>
+  uint64_t search_found_block(uint64_t found_block, excess_t target_excess) const;
+  template <int direction>
+  void search_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+  template <int direction>
+  uint64_t search_with_kernel(uint64_t pos, word_kernel kernel) const;
+
+  template <word_kernel kernel>
   bool find_close_in_block(uint64_t pos, excess_t excess, uint64_t max_sub_blocks, uint64_t &ret) const;
+  template <word_kernel kernel>
   bool find_open_in_block(uint64_t pos, excess_t excess, uint64_t max_sub_blocks, uint64_t &ret) const;
 
+  // A word, block or min tree node covering part of the range of an
+  // excess_min_count, with its minimum excess and the number of positions
+  // attaining it. Words start at pos with excess exc and are padded with
+  // open parentheses; btree nodes are identified by level and index.
+  struct min_piece {
+    enum { word, block, node } kind;
+    uint64_t idx;
+    uint64_t level;
+    uint64_t bits;
+    uint64_t pos;
+    excess_t exc;
+    excess_t min_exc;
+    uint64_t count;
+  };
+
+  // Calls fn on the pieces covering (a, b] from left to right, until it
+  // returns true
+  template <typename Fn>
+  void for_each_min_piece(uint64_t a, uint64_t b, Fn fn) const;
+  uint64_t min_select_in_piece(min_piece piece, uint64_t i) const;
+
   void excess_rmq_in_block(uint64_t start, uint64_t end, bp_vector::excess_t &exc, bp_vector::excess_t &min_exc,
                            uint64_t &min_exc_idx) const;
   void excess_rmq_in_superblock(uint64_t block_start, uint64_t block_end, bp_vector::excess_t &block_min_exc,
@@ -77,10 +195,32 @@ class bp_vector : public rs_bit_vector {
   template <int direction>
   inline uint64_t search_min_tree(uint64_t block, excess_t excess) const;
 
-  void build_min_tree();
+  // In the btree layout m_superblock_excess_min holds the levels of the
+  // tree bottom-up, each padded to a multiple of min_tree_fanout with
+  // size() sentinels: level 0 has the superblock minima, and each entry of
+  // level l + 1 is the minimum of a node of level l. m_internal_nodes is
+  // the number of levels.
+  static const size_t min_tree_fanout     = 16;
+  static const size_t max_min_tree_levels = 16;  // fanout^16 = 2^64
+
+  void btree_level_offsets(uint64_t *offsets) const;
+  template <int direction>
+  inline uint64_t search_min_btree(uint64_t block, excess_t excess) const;
+  void find_min_superblock_btree(uint64_t superblock_start, uint64_t superblock_end,
+                                 bp_vector::excess_t &superblock_min_exc, uint64_t &superblock_min_idx) const;
+
+  static const size_t min_superblocks_per_thread = 64;
+
+  void build_min_tree(size_t num_threads, bool with_min_counts);
 
+  min_tree_layout m_min_tree_layout;
   uint64_t m_internal_nodes;
   mapper::mappable_vector<block_min_excess_t> m_block_excess_min;
   mapper::mappable_vector<excess_t> m_superblock_excess_min;
+  // number of positions attaining the minima above, excluding the first
+  // position of each block, which belongs to the block before it; empty
+  // unless built with_min_counts
+  mapper::mappable_vector<uint8_t> m_block_min_count;
+  mapper::mappable_vector<uint64_t> m_superblock_min_count;
 };
 }  // namespace succinct
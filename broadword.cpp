@@ -0,0 +1,443 @@
+#include "broadword.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.hpp"
+
+namespace succinct {
+namespace broadword {
+
+namespace {
+
+void popcount_each_generic(uint64_t const *words, size_t n, uint8_t *counts) {
+  for (size_t i = 0; i < n; ++i) { counts[i] = uint8_t(bytes_sum(byte_counts(words[i]))); }
+}
+
+uint64_t popcount_words_generic(uint64_t const *words, size_t n) {
+  uint64_t ret = 0;
+  for (size_t i = 0; i < n; ++i) { ret += bytes_sum(byte_counts(words[i])); }
+  return ret;
+}
+
+void unpack_bits_generic(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out) {
+  if (!width) {
+    std::fill(out, out + n, 0);
+    return;
+  }
+  if (width == 64 && bit_offset % 64 == 0) {
+    std::copy(words + bit_offset / 64, words + bit_offset / 64 + n, out);
+    return;
+  }
+  uint64_t mask = width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+  uint64_t pos  = bit_offset;
+  for (size_t i = 0; i < n; ++i, pos += width) {
+    uint64_t block = pos / 64;
+    uint64_t shift = pos % 64;
+    uint64_t val   = words[block] >> shift;
+    if (shift + width > 64) { val |= words[block + 1] << (64 - shift); }
+    out[i] = val & mask;
+  }
+}
+
+uint64_t one_positions_generic(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out) {
+  uint64_t block = pos / 64;
+  uint64_t word  = words[block] & (uint64_t(-1) << (pos % 64));
+  size_t count   = 0;
+  while (true) {
+    unsigned long pos_in_word;
+    while (count < n && lsb(word, pos_in_word)) {
+      out[count++] = block * 64 + pos_in_word;
+      word &= word - 1;
+    }
+    if (count == n) break;
+    word = words[++block];
+  }
+  return out[n - 1];
+}
+
+uint64_t count_less_generic(uint64_t const *values, size_t n, uint64_t x) {
+  uint64_t ret = 0;
+  for (size_t i = 0; i < n; ++i) { ret += values[i] < x; }
+  return ret;
+}
+
+void unpack_nibbles_generic(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out) {
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t pos = begin + i;
+    out[i]       = uint8_t((bytes[pos / 2] >> ((pos % 2) * 4)) & 0x0F);
+  }
+}
+
+uint64_t decode_stream_vbyte_generic(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out) {
+  uint8_t const *cur = data;
+  for (size_t i = 0; i < n; ++i) {
+    size_t len = size_t((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    uint32_t val;
+    std::memcpy(&val, cur, sizeof(val));
+    out[i] = len == 4 ? val : val & ((uint32_t(1) << (8 * len)) - 1);
+    cur += len;
+  }
+  return uint64_t(cur - data);
+}
+
+#if SUCCINCT_USE_CPU_DISPATCH || SUCCINCT_USE_POPCNT
+
+#if SUCCINCT_USE_CPU_DISPATCH
+#define POPCNT_TARGET __INTRIN_TARGET("popcnt")
+#else
+#define POPCNT_TARGET
+#endif
+
+POPCNT_TARGET void popcount_each_popcnt(uint64_t const *words, size_t n, uint8_t *counts) {
+  for (size_t i = 0; i < n; ++i) { counts[i] = uint8_t(_mm_popcnt_u64(words[i])); }
+}
+
+POPCNT_TARGET uint64_t popcount_words_popcnt(uint64_t const *words, size_t n) {
+  // independent accumulators break the dependency chain on the sum
+  uint64_t acc[4] = {0, 0, 0, 0};
+  size_t i        = 0;
+  for (; i + 4 <= n; i += 4) {
+    acc[0] += uint64_t(_mm_popcnt_u64(words[i]));
+    acc[1] += uint64_t(_mm_popcnt_u64(words[i + 1]));
+    acc[2] += uint64_t(_mm_popcnt_u64(words[i + 2]));
+    acc[3] += uint64_t(_mm_popcnt_u64(words[i + 3]));
+  }
+  for (; i < n; ++i) { acc[0] += uint64_t(_mm_popcnt_u64(words[i])); }
+  return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+#undef POPCNT_TARGET
+
+#endif /* SUCCINCT_USE_CPU_DISPATCH || SUCCINCT_USE_POPCNT */
+
+#if SUCCINCT_USE_CPU_DISPATCH
+
+__INTRIN_TARGET("popcnt,avx512f,avx512vpopcntdq")
+void popcount_each_avx512(uint64_t const *words, size_t n, uint8_t *counts) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i pop = _mm512_popcnt_epi64(_mm512_loadu_si512(words + i));
+    // the maskz form avoids GCC's spurious uninitialized warnings on the
+    // unmasked intrinsic
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(counts + i), _mm512_maskz_cvtepi64_epi8(0xFF, pop));
+  }
+  for (; i < n; ++i) { counts[i] = uint8_t(_mm_popcnt_u64(words[i])); }
+}
+
+__INTRIN_TARGET("popcnt,avx512f,avx512vpopcntdq") uint64_t popcount_words_avx512(uint64_t const *words, size_t n) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i    = 0;
+  for (; i + 8 <= n; i += 8) { acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(words + i))); }
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, acc);
+  uint64_t ret = 0;
+  for (auto lane : lanes) { ret += lane; }
+  for (; i < n; ++i) { ret += uint64_t(_mm_popcnt_u64(words[i])); }
+  return ret;
+}
+
+// Each lane gathers the 8 bytes starting at the byte that holds the first
+// bit of its value and shifts it into place, so widths up to 56 bits are
+// covered by a single load. Values whose load would cross the end of the
+// words holding the range are left to the generic loop.
+__INTRIN_TARGET("avx2")
+void unpack_bits_avx2(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out) {
+  if (width == 0 || width > 56 || n < 4) { return unpack_bits_generic(words, bit_offset, width, n, out); }
+
+  uint64_t end_bytes = 8 * util::ceil_div(bit_offset + n * width, 64);
+  // the value starting at bit b can be loaded if b / 8 + 8 <= end_bytes
+  size_t safe_n = 0;
+  if (end_bytes >= 8 && (end_bytes - 8) * 8 + 7 >= bit_offset) {
+    safe_n = std::min<uint64_t>(n, ((end_bytes - 8) * 8 + 7 - bit_offset) / width + 1);
+  }
+
+  auto base     = reinterpret_cast<long long const *>(words);
+  __m256i mask  = _mm256_set1_epi64x(int64_t((uint64_t(1) << width) - 1));
+  __m256i seven = _mm256_set1_epi64x(7);
+  __m256i step  = _mm256_set1_epi64x(int64_t(4 * width));
+  __m256i pos   = _mm256_add_epi64(_mm256_set1_epi64x(int64_t(bit_offset)),
+                                   _mm256_set_epi64x(int64_t(3 * width), int64_t(2 * width), int64_t(width), 0));
+  size_t i = 0;
+  for (; i + 4 <= safe_n; i += 4) {
+    __m256i vals = _mm256_i64gather_epi64(base, _mm256_srli_epi64(pos, 3), 1);
+    vals         = _mm256_and_si256(_mm256_srlv_epi64(vals, _mm256_and_si256(pos, seven)), mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), vals);
+    pos = _mm256_add_epi64(pos, step);
+  }
+  unpack_bits_generic(words, bit_offset + i * width, width, n - i, out + i);
+}
+
+// Words with many ones are expanded a byte at a time: the offsets of the
+// set bits of the byte are compressed to the front of a vector and stored
+// with a mask, without branching on the individual bits
+__INTRIN_TARGET("popcnt,bmi,avx512f")
+uint64_t one_positions_avx512(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out) {
+  static const size_t sparse_word = 8;  // below this many ones, a bit at a time is faster
+  const __m512i lanes             = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+
+  uint64_t block = pos / 64;
+  uint64_t word  = words[block] & (uint64_t(-1) << (pos % 64));
+  size_t count   = 0;
+  while (true) {
+    size_t word_ones = size_t(_mm_popcnt_u64(word));
+    if (word_ones >= sparse_word && count + word_ones <= n) {
+      __m512i byte_base = _mm512_add_epi64(lanes, _mm512_set1_epi64(int64_t(block * 64)));
+      for (size_t b = 0; b < 8; ++b) {
+        __mmask8 bits = __mmask8(word >> (8 * b));
+        _mm512_mask_storeu_epi64(out + count, __mmask8((1U << _mm_popcnt_u32(bits)) - 1),
+                                 _mm512_maskz_compress_epi64(bits, byte_base));
+        count += size_t(_mm_popcnt_u32(bits));
+        byte_base = _mm512_add_epi64(byte_base, _mm512_set1_epi64(8));
+      }
+    } else {
+      for (; count < n && word; word = _blsr_u64(word)) { out[count++] = block * 64 + _tzcnt_u64(word); }
+    }
+    if (count == n) break;
+    word = words[++block];
+  }
+  return out[n - 1];
+}
+
+// Each 16-byte load is split into its low and high nibbles, which are
+// interleaved back in order by the byte unpacks
+__INTRIN_TARGET("sse2")
+void unpack_nibbles_sse2(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out) {
+  size_t i = 0;
+  if (begin % 2 && n) {
+    out[0] = uint8_t(bytes[begin / 2] >> 4);
+    i      = 1;
+  }
+  uint8_t const *src = bytes + (begin + i) / 2;
+  const __m128i low4 = _mm_set1_epi8(0x0F);
+  for (; i + 32 <= n; i += 32, src += 16) {
+    __m128i b  = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src));
+    __m128i lo = _mm_and_si128(b, low4);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), low4);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(lo, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 16), _mm_unpackhi_epi8(lo, hi));
+  }
+  unpack_nibbles_generic(bytes, begin + i, n - i, out + i);
+}
+
+// For each control byte, the shuffle that moves the bytes of its four
+// values to the low bytes of four 32-bit lanes (0x80 clears a byte), and
+// the total length of the values
+struct stream_vbyte_tables {
+  alignas(16) uint8_t shuffle[256][16];
+  uint8_t length[256];
+
+  constexpr stream_vbyte_tables() : shuffle(), length() {
+    for (unsigned c = 0; c < 256; ++c) {
+      unsigned pos = 0;
+      for (unsigned k = 0; k < 4; ++k) {
+        unsigned len = ((c >> (2 * k)) & 3) + 1;
+        for (unsigned b = 0; b < 4; ++b) { shuffle[c][4 * k + b] = uint8_t(b < len ? pos + b : 0x80); }
+        pos += len;
+      }
+      length[c] = uint8_t(pos);
+    }
+  }
+};
+
+constexpr stream_vbyte_tables svb_tables;
+
+// One 16-byte load and one PSHUFB per control byte decode four values
+__INTRIN_TARGET("ssse3")
+uint64_t decode_stream_vbyte_ssse3(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out) {
+  uint8_t const *cur = data;
+  size_t i           = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint8_t c    = control[i / 4];
+    __m128i vals = _mm_loadu_si128(reinterpret_cast<__m128i const *>(cur));
+    vals         = _mm_shuffle_epi8(vals, _mm_load_si128(reinterpret_cast<__m128i const *>(svb_tables.shuffle[c])));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), vals);
+    cur += svb_tables.length[c];
+  }
+  cur += decode_stream_vbyte_generic(control + i / 4, cur, n - i, out + i);
+  return uint64_t(cur - data);
+}
+
+// AVX2 only has signed 64-bit compares, so both sides are biased by 2^63
+__INTRIN_TARGET("popcnt,avx2") uint64_t count_less_avx2(uint64_t const *values, size_t n, uint64_t x) {
+  __m256i bias = _mm256_set1_epi64x(int64_t(uint64_t(1) << 63));
+  __m256i vx   = _mm256_xor_si256(_mm256_set1_epi64x(int64_t(x)), bias);
+  uint64_t ret = 0;
+  size_t i     = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(values + i)), bias);
+    int mask  = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(vx, v)));
+    ret += uint64_t(_mm_popcnt_u32(unsigned(mask)));
+  }
+  return ret + count_less_generic(values + i, n - i, x);
+}
+
+__INTRIN_TARGET("popcnt,avx512f") uint64_t count_less_avx512(uint64_t const *values, size_t n, uint64_t x) {
+  __m512i vx   = _mm512_set1_epi64(int64_t(x));
+  uint64_t ret = 0;
+  size_t i     = 0;
+  for (; i + 8 <= n; i += 8) {
+    ret += uint64_t(_mm_popcnt_u32(_mm512_cmplt_epu64_mask(_mm512_loadu_si512(values + i), vx)));
+  }
+  if (i < n) {
+    __mmask8 tail = __mmask8((1U << (n - i)) - 1);
+    ret += uint64_t(_mm_popcnt_u32(_mm512_mask_cmplt_epu64_mask(tail, _mm512_maskz_loadu_epi64(tail, values + i), vx)));
+  }
+  return ret;
+}
+
+#endif /* SUCCINCT_USE_CPU_DISPATCH */
+
+kernel_tier detect_kernel_tier() {
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (intrinsics::cpu_has_popcnt()) {
+    if (intrinsics::cpu_has_bmi2()) {
+      if (intrinsics::cpu_has_avx2()) {
+        if (intrinsics::cpu_has_avx512_vpopcntdq()) { return kernel_tier::avx512; }
+        return kernel_tier::avx2;
+      }
+      return kernel_tier::bmi2;
+    }
+    return kernel_tier::popcnt;
+  }
+#endif
+#if SUCCINCT_USE_POPCNT
+  return kernel_tier::popcnt;
+#else
+  return kernel_tier::generic;
+#endif
+}
+
+// BMI2 select is only worth it where PDEP is fast
+kernel_tier detect_select_kernel_tier() {
+  kernel_tier tier = detected_kernel_tier();
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier >= kernel_tier::bmi2 && !intrinsics::cpu_has_fast_pdep()) { return kernel_tier::popcnt; }
+#endif
+  return tier;
+}
+
+}  // namespace
+
+kernel_tier detected_kernel_tier() {
+  static const kernel_tier tier = detect_kernel_tier();
+  return tier;
+}
+
+namespace detail {
+const kernel_tier query_tier = std::min(detect_select_kernel_tier(), kernel_tier::bmi2);
+}  // namespace detail
+
+const char *kernel_tier_name(kernel_tier tier) {
+  switch (tier) {
+    case kernel_tier::generic: return "generic";
+    case kernel_tier::popcnt: return "popcnt";
+    case kernel_tier::bmi2: return "bmi2";
+    case kernel_tier::avx2: return "avx2";
+    case kernel_tier::avx512: return "avx512";
+  }
+  return "unknown";
+}
+
+void popcount_each(uint64_t const *words, size_t n, uint8_t *counts, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier == kernel_tier::avx512) { return popcount_each_avx512(words, n, counts); }
+#endif
+#if SUCCINCT_USE_CPU_DISPATCH || SUCCINCT_USE_POPCNT
+  if (tier != kernel_tier::generic) { return popcount_each_popcnt(words, n, counts); }
+#endif
+  (void)tier;
+  popcount_each_generic(words, n, counts);
+}
+
+void popcount_each(uint64_t const *words, size_t n, uint8_t *counts) {
+  popcount_each(words, n, counts, detected_kernel_tier());
+}
+
+uint64_t popcount_words(uint64_t const *words, size_t n, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier == kernel_tier::avx512) { return popcount_words_avx512(words, n); }
+#endif
+#if SUCCINCT_USE_CPU_DISPATCH || SUCCINCT_USE_POPCNT
+  if (tier != kernel_tier::generic) { return popcount_words_popcnt(words, n); }
+#endif
+  (void)tier;
+  return popcount_words_generic(words, n);
+}
+
+uint64_t popcount_words(uint64_t const *words, size_t n) { return popcount_words(words, n, detected_kernel_tier()); }
+
+void unpack_bits(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+  assert(width <= 64);
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier >= kernel_tier::avx2) { return unpack_bits_avx2(words, bit_offset, width, n, out); }
+#endif
+  (void)tier;
+  unpack_bits_generic(words, bit_offset, width, n, out);
+}
+
+void unpack_bits(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out) {
+  unpack_bits(words, bit_offset, width, n, out, detected_kernel_tier());
+}
+
+uint64_t one_positions(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+  assert(n > 0);
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier == kernel_tier::avx512) { return one_positions_avx512(words, pos, n, out); }
+#endif
+  (void)tier;
+  return one_positions_generic(words, pos, n, out);
+}
+
+uint64_t one_positions(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out) {
+  return one_positions(words, pos, n, out, detected_kernel_tier());
+}
+
+uint64_t count_less(uint64_t const *values, size_t n, uint64_t x, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+#if SUCCINCT_USE_CPU_DISPATCH
+  if (tier == kernel_tier::avx512) { return count_less_avx512(values, n, x); }
+  if (tier == kernel_tier::avx2) { return count_less_avx2(values, n, x); }
+#endif
+  (void)tier;
+  return count_less_generic(values, n, x);
+}
+
+uint64_t count_less(uint64_t const *values, size_t n, uint64_t x) {
+  return count_less(values, n, x, detected_kernel_tier());
+}
+
+void unpack_nibbles(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+#if SUCCINCT_USE_CPU_DISPATCH
+  // SSE2 is part of x86-64, so any tier above generic can use it
+  if (tier != kernel_tier::generic) { return unpack_nibbles_sse2(bytes, begin, n, out); }
+#endif
+  (void)tier;
+  unpack_nibbles_generic(bytes, begin, n, out);
+}
+
+void unpack_nibbles(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out) {
+  unpack_nibbles(bytes, begin, n, out, detected_kernel_tier());
+}
+
+uint64_t decode_stream_vbyte(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out, kernel_tier tier) {
+  assert(tier <= detected_kernel_tier());
+#if SUCCINCT_USE_CPU_DISPATCH
+  // every CPU with AVX2 has SSSE3, which is not tracked as a tier of its own
+  if (tier >= kernel_tier::avx2) { return decode_stream_vbyte_ssse3(control, data, n, out); }
+#endif
+  (void)tier;
+  return decode_stream_vbyte_generic(control, data, n, out);
+}
+
+uint64_t decode_stream_vbyte(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out) {
+  return decode_stream_vbyte(control, data, n, out, detected_kernel_tier());
+}
+
+}  // namespace broadword
+}  // namespace succinct
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 #include "intrinsics.hpp"
@@ -9,6 +10,16 @@
 namespace succinct {
 namespace broadword {
 
+// Kernel families, from the most portable to the fastest. Each tier
+// implies the previous ones are available.
+enum class kernel_tier {
+  generic,  // broadword arithmetic and tables only
+  popcnt,   // POPCNT instruction
+  bmi2,     // PDEP/TZCNT for select_in_word
+  avx2,     // AVX2 gathers for bit unpacking
+  avx512    // AVX-512 VPOPCNTDQ for bulk popcounts, compress for bit scans
+};
+
 static const uint64_t ones_step_4 = 0x1111111111111111ULL;
 static const uint64_t ones_step_8 = 0x0101010101010101ULL;
 static const uint64_t ones_step_9 =
@@ -50,6 +61,10 @@ inline uint64_t byte_counts(uint64_t x) {
 
 inline uint64_t bytes_sum(uint64_t x) { return x * ones_step_8 >> 56; }
 
+// The untemplated scalar primitives are chosen at compile time, as they
+// are inlined in the hottest loops. The query entry points use the
+// overloads templated on the kernel tier instead, with one copy of each
+// query per tier (see dispatch_query below).
 inline uint64_t popcount(uint64_t x) {
 #if SUCCINCT_USE_POPCNT
   return intrinsics::popcount(x);
@@ -92,6 +107,43 @@ inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
   return place + tables::select_in_byte[((x >> place) & 0xFF) | (byte_rank << 8)];
 }
 
+// Same as popcount(x) and select_in_word(x, k), with the kernels of the
+// given tier. They must only run on CPUs that support the tier; the
+// instructions are only emitted when inlined into a function compiled for
+// it, as dispatch_query does.
+template <kernel_tier Tier>
+inline uint64_t popcount(uint64_t x) {
+#if SUCCINCT_USE_POPCNT
+  return intrinsics::popcount(x);
+#elif SUCCINCT_USE_CPU_DISPATCH
+  if constexpr (Tier != kernel_tier::generic) { return uint64_t(__builtin_popcountll(x)); }
+  return bytes_sum(byte_counts(x));
+#else
+  return bytes_sum(byte_counts(x));
+#endif
+}
+
+template <kernel_tier Tier>
+inline uint64_t select_in_word(const uint64_t x, const uint64_t k) {
+  assert(k < popcount(x));
+#if SUCCINCT_USE_CPU_DISPATCH
+  if constexpr (Tier >= kernel_tier::bmi2) { return intrinsics::select_in_word_pdep(x, k); }
+#endif
+
+  uint64_t byte_sums = byte_counts(x) * ones_step_8;
+
+  const uint64_t k_step_8     = k * ones_step_8;
+  const uint64_t geq_k_step_8 = (((k_step_8 | msbs_step_8) - byte_sums) & msbs_step_8);
+  uint64_t place;
+  if constexpr (Tier != kernel_tier::generic || SUCCINCT_USE_POPCNT) {
+    place = popcount<Tier>(geq_k_step_8) * 8;
+  } else {
+    place = ((geq_k_step_8 >> 7) * ones_step_8 >> 53) & ~uint64_t(0x7);
+  }
+  const uint64_t byte_rank = k - (((byte_sums << 8) >> place) & uint64_t(0xFF));
+  return place + tables::select_in_byte[((x >> place) & 0xFF) | (byte_rank << 8)];
+}
+
 inline uint64_t same_msb(uint64_t x, uint64_t y) { return (x ^ y) <= (x & y); }
 
 namespace detail {
@@ -155,5 +207,99 @@ inline uint8_t lsb(uint64_t x) {
   return (uint8_t)ret;
 }
 
+// Highest tier supported by both the build and the running CPU
+kernel_tier detected_kernel_tier();
+
+namespace detail {
+// set during static initialization; generic, which runs everywhere, until then
+extern const kernel_tier query_tier;
+}  // namespace detail
+
+// Tier of the scalar kernels used by the queries: the detected tier capped
+// at bmi2, and popcnt where PDEP is slow (see cpu_has_fast_pdep)
+inline kernel_tier query_kernel_tier() {
+#if SUCCINCT_USE_CPU_DISPATCH
+  return detail::query_tier;
+#elif SUCCINCT_USE_POPCNT
+  return kernel_tier::popcnt;
+#else
+  return kernel_tier::generic;
+#endif
+}
+
+#if SUCCINCT_USE_CPU_DISPATCH
+namespace detail {
+// flatten inlines the whole query, so that its scalar kernels are compiled
+// for the target of the copy
+template <typename Query>
+__INTRIN_TARGET("popcnt") __attribute__((flatten)) auto run_query_popcnt(Query const &query) {
+  return query.template operator()<kernel_tier::popcnt>();
+}
+
+template <typename Query>
+__INTRIN_TARGET("popcnt,bmi,bmi2") __attribute__((flatten)) auto run_query_bmi2(Query const &query) {
+  return query.template operator()<kernel_tier::bmi2>();
+}
+}  // namespace detail
+#endif
+
+// Runs query.template operator()<Tier>() with Tier = query_kernel_tier().
+// The tier is checked once per call, and each tier runs its own copy of
+// the query compiled for it, so the scalar kernels in the query loops
+// need no check per word.
+template <typename Query>
+inline auto dispatch_query(Query const &query) {
+#if SUCCINCT_USE_CPU_DISPATCH
+  switch (query_kernel_tier()) {
+    case kernel_tier::generic: return query.template operator()<kernel_tier::generic>();
+    case kernel_tier::popcnt: return detail::run_query_popcnt(query);
+    default: return detail::run_query_bmi2(query);
+  }
+#elif SUCCINCT_USE_POPCNT
+  return query.template operator()<kernel_tier::popcnt>();
+#else
+  return query.template operator()<kernel_tier::generic>();
+#endif
+}
+
+const char *kernel_tier_name(kernel_tier tier);
+
+// Bulk kernels, dispatched at runtime to the detected tier. The overloads
+// taking an explicit tier are meant for testing and benchmarking, and
+// require tier <= detected_kernel_tier().
+
+// counts[i] = popcount(words[i])
+void popcount_each(uint64_t const *words, size_t n, uint8_t *counts);
+void popcount_each(uint64_t const *words, size_t n, uint8_t *counts, kernel_tier tier);
+
+// sum of popcount(words[i])
+uint64_t popcount_words(uint64_t const *words, size_t n);
+uint64_t popcount_words(uint64_t const *words, size_t n, kernel_tier tier);
+
+// out[i] = the width bits starting at bit_offset + i * width in words, for
+// width <= 64
+void unpack_bits(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out);
+void unpack_bits(uint64_t const *words, uint64_t bit_offset, size_t width, size_t n, uint64_t *out, kernel_tier tier);
+
+// out[i] = position of the i-th one at or after pos in words, for n > 0;
+// words must contain at least n such ones. Returns out[n - 1].
+uint64_t one_positions(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out);
+uint64_t one_positions(uint64_t const *words, uint64_t pos, size_t n, uint64_t *out, kernel_tier tier);
+
+// number of values[i] < x
+uint64_t count_less(uint64_t const *values, size_t n, uint64_t x);
+uint64_t count_less(uint64_t const *values, size_t n, uint64_t x, kernel_tier tier);
+
+// out[i] = the nibble begin + i of bytes, low nibble of each byte first
+void unpack_nibbles(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out);
+void unpack_nibbles(uint8_t const *bytes, uint64_t begin, size_t n, uint8_t *out, kernel_tier tier);
+
+// Decodes n Stream-VByte values: the byte length minus one of value i is in
+// bits 2 * (i % 4) of control[i / 4], and its bytes are stored little-endian
+// one value after the other in data. data must be readable up to 16 bytes
+// past the end of the values. Returns the number of data bytes decoded.
+uint64_t decode_stream_vbyte(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out);
+uint64_t decode_stream_vbyte(uint8_t const *control, uint8_t const *data, size_t n, uint32_t *out, kernel_tier tier);
+
 }  // namespace broadword
 }  // namespace succinct
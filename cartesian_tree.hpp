@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <ranges>
 #include <vector>
 
@@ -31,12 +32,23 @@ namespace succinct {
 //
 // - Our data structures have 0-based indices, so the operations
 //   are slightly different from those in the paper
+//
+// - In the hybrid mode, rmq() answers ranges shorter than
+//   short_range_size with a bounded scan of the BP words, without
+//   excess_rmq and mostly without select0: see short_range_index.
 
 class cartesian_tree {
  public:
   cartesian_tree(const cartesian_tree &)            = delete;
   cartesian_tree &operator=(const cartesian_tree &) = delete;
 
+  // succinct answers every query with select0 and excess_rmq on the BP;
+  // hybrid adds a short_range_index (half a bit per element) for the
+  // ranges shorter than short_range_size
+  enum class rmq_mode { succinct, hybrid };
+
+  static const uint64_t short_range_size = 256;
+
   template <typename T>
   class builder {
    public:
@@ -79,18 +91,28 @@ class cartesian_tree {
   cartesian_tree() {}
 
   template <typename T>
-  cartesian_tree(builder<T> *b) {
+  cartesian_tree(builder<T> *b, rmq_mode mode = rmq_mode::succinct) {
     bp_vector(&b->finalize(), false, true).swap(m_bp);
+    if (mode == rmq_mode::hybrid) { m_short_range.build(m_bp); }
   }
 
   template <typename Range>
-  cartesian_tree(Range const &v) {
-    build_from_range(v, std::less<typename std::ranges::range_value_t<Range>>());
-  }
+  cartesian_tree(Range const &v, rmq_mode mode = rmq_mode::succinct)
+    : cartesian_tree(v, std::less<typename std::ranges::range_value_t<Range>>(), mode) {}
 
   template <typename Range, typename Comparator>
-  cartesian_tree(Range const &v, Comparator const &comp) {
+  cartesian_tree(Range const &v, Comparator const &comp, rmq_mode mode = rmq_mode::succinct) {
     build_from_range(v, comp);
+    if (mode == rmq_mode::hybrid) { m_short_range.build(m_bp); }
+  }
+
+  // Same as cartesian_tree(v, comp), built with num_threads threads (0
+  // means one per hardware thread) for random access ranges; the result
+  // does not depend on num_threads. See build_from_range_parallel.
+  template <typename Range, typename Comparator>
+  cartesian_tree(Range const &v, Comparator const &comp, size_t num_threads, rmq_mode mode = rmq_mode::succinct) {
+    build_from_range_parallel(v, comp, num_threads);
+    if (mode == rmq_mode::hybrid) { m_short_range.build(m_bp); }
   }
 
   // NOTE: this is RMQ in the interval [a, b], b inclusive
@@ -104,15 +126,22 @@ class cartesian_tree {
 
     uint64_t n = size();
 
-    uint64_t t     = m_bp.select0(n - b - 1);
-    excess_t exc_t = excess_t(t - 2 * (n - b - 1));
-    assert(exc_t - 1 == m_bp.excess(t + 1));
+    if (b - a < short_range_size && m_short_range.size()) {
+      uint64_t ret = b - m_short_range.min_zeros_after(m_bp, n - b - 1, b - a);
+      assert(ret >= a);
+      return ret;
+    }
 
+    uint64_t t = m_bp.select0(n - b - 1);
     uint64_t x = m_bp.select0(n - b);
     uint64_t y = m_bp.select0(n - a);
 
+    excess_t exc_t = excess_t(t - 2 * (n - b - 1));
+    assert(exc_t - 1 == m_bp.excess(t + 1));
+
+    // t is a zero and is followed by ones up to x
     excess_t exc_w;
-    uint64_t w       = m_bp.excess_rmq(x, y, exc_w);
+    uint64_t w       = m_bp.excess_rmq(x, y, exc_w, exc_t + excess_t(x - t) - 2);
     uint64_t rank0_w = (w - uint64_t(exc_w)) / 2;
     assert(m_bp[w - 1] == 0);
 
@@ -132,14 +161,168 @@ class cartesian_tree {
 
   uint64_t size() const { return m_bp.size() / 2 - 1; }
 
+  rmq_mode mode() const { return m_short_range.size() ? rmq_mode::hybrid : rmq_mode::succinct; }
+
   template <typename Visitor>
   void map(Visitor &visit) {
-    visit(m_bp, "m_bp");
+    // legacy files have no short range index
+    visit(m_bp, "m_bp").versioned(m_short_range, "m_short_range");
   }
 
-  void swap(cartesian_tree &other) { other.m_bp.swap(m_bp); }
+  void swap(cartesian_tree &other) {
+    other.m_bp.swap(m_bp);
+    other.m_short_range.swap(m_short_range);
+  }
 
  protected:
+  // The excess right after a zero of the BP is smaller than at any
+  // position up to the previous zero, so the minimum of excess_rmq(x, y)
+  // in rmq() is either the excess right after t or right after one of the
+  // b - a zeros that follow t. A short range is answered by scanning the
+  // words from t on until the minimum cannot change anymore: each zero
+  // takes the excess down by one and there are at most b - a of them left,
+  // so the scan stops after at most b - a + 1 ones, however long the runs
+  // of ones are. The index holds:
+  //
+  // - the position of every zeros_per_sample-th zero, from which t is
+  //   found by scanning at most max_scan_words words, or by select0
+  //   where the samples are sparser than that;
+  //
+  // - the minimum excess within each word of the BP, relative to its
+  //   start, so that the scan reads a byte per word and looks into the
+  //   bits of a single word to find the position of the minimum.
+  class short_range_index {
+   public:
+    template <typename Visitor>
+    void map(Visitor &visit) {
+      visit(m_zero_samples, "m_zero_samples")(m_word_min, "m_word_min");
+    }
+
+    void swap(short_range_index &other) {
+      m_zero_samples.swap(other.m_zero_samples);
+      m_word_min.swap(other.m_word_min);
+    }
+
+    inline uint64_t size() const { return m_zero_samples.size(); }
+
+    void build(bp_vector const &bp) {
+      std::vector<uint64_t> zero_samples;
+      zero_samples.reserve(util::ceil_div(bp.num_zeros(), zeros_per_sample));
+      std::vector<uint8_t> word_min(bp.data().size());
+      auto const &bits = bp.data();
+      uint64_t rank0   = 0;
+      for (uint64_t word_idx = 0; word_idx < bits.size(); ++word_idx) {
+        uint64_t word = ~bits[word_idx];
+        if (word_idx == bits.size() - 1 && bp.size() % 64) { word &= (uint64_t(1) << (bp.size() % 64)) - 1; }
+        uint64_t zeros = broadword::popcount(word);
+        // next sampled zero, if it is in this word
+        uint64_t next = util::ceil_div(rank0, zeros_per_sample) * zeros_per_sample;
+        for (; next < rank0 + zeros; next += zeros_per_sample) {
+          zero_samples.push_back(word_idx * 64 + broadword::select_in_word(word, next - rank0));
+        }
+        rank0 += zeros;
+
+        bp_vector::excess_t min_exc;
+        bp_vector::word_excess_rmq(~word, min_exc);
+        word_min[word_idx] = uint8_t(-min_exc);
+      }
+      m_zero_samples.steal(zero_samples);
+      m_word_min.steal(word_min);
+    }
+
+    // Number of zeros, among the count zeros following the zero of rank r,
+    // before the leftmost position where the excess goes below the excess
+    // right after that zero, or 0 if it never does
+    inline uint64_t min_zeros_after(bp_vector const &bp, uint64_t r, uint64_t count) const {
+      return broadword::dispatch_query(
+        [&]<broadword::kernel_tier Tier>() { return min_zeros_after<Tier>(bp, r, count); });
+    }
+
+    template <broadword::kernel_tier Tier>
+    inline uint64_t min_zeros_after(bp_vector const &bp, uint64_t r, uint64_t count) const {
+      typedef bp_vector::excess_t excess_t;
+      assert(count);
+      auto const &bits = bp.data();
+      uint64_t pos     = select0<Tier>(bp, r) + 1;
+
+      // the first word is padded with ones so that it starts at pos
+      uint64_t word_idx = pos / 64;
+      uint64_t word_len = 64 - pos % 64;
+      uint64_t word     = bits[word_idx] >> (pos % 64);
+      if (word_len < 64) { word |= ~uint64_t(0) << word_len; }
+
+      // the word minima are looked up in m_word_min, except for the padded
+      // words, and only the word holding the minimum is scanned for its
+      // position
+      excess_t exc = 0, min_exc = 0, min_word_exc = 0;
+      uint64_t zeros = 0, min_word = 0, min_word_zeros = 0;
+      while (true) {
+        uint64_t word_zeros = broadword::popcount<Tier>(~word);
+        bool last           = word_zeros >= count;
+        if (last) {
+          // pad with ones after the count-th zero
+          uint64_t end = broadword::select_in_word<Tier>(~word, count - 1) + 1;
+          if (end < 64) { word |= ~uint64_t(0) << end; }
+        }
+
+        excess_t word_min_exc = -excess_t(m_word_min[word_idx]);
+        if (last || word_len < 64) { bp_vector::word_excess_rmq(word, word_min_exc); }
+        if (exc + word_min_exc < min_exc) {
+          min_exc        = exc + word_min_exc;
+          min_word       = word;
+          min_word_exc   = exc;
+          min_word_zeros = zeros;
+        }
+        if (last) { break; }
+
+        exc += excess_t(word_len) - 2 * excess_t(word_zeros);
+        zeros += word_zeros;
+        count -= word_zeros;
+        // the zeros left cannot take the excess below min_exc
+        if (exc - excess_t(count) >= min_exc) { break; }
+
+        word     = bits[++word_idx];
+        word_len = 64;
+      }
+      if (min_exc == 0) { return 0; }
+
+      excess_t word_min_exc;
+      uint64_t offset = bp_vector::word_excess_rmq(min_word, word_min_exc);
+      assert(min_word_exc + word_min_exc == min_exc);
+      (void)min_word_exc;
+      return min_word_zeros + (offset - uint64_t(word_min_exc)) / 2;
+    }
+
+    static const uint64_t zeros_per_sample = 256;
+    static const uint64_t max_scan_words   = 16;
+
+   protected:
+    template <broadword::kernel_tier Tier>
+    inline uint64_t select0(bp_vector const &bp, uint64_t r) const {
+      uint64_t sample = r / zeros_per_sample;
+      uint64_t pos    = m_zero_samples[sample];
+      uint64_t end    = sample + 1 < m_zero_samples.size() ? m_zero_samples[sample + 1] : bp.size();
+      if (end / 64 - pos / 64 > max_scan_words) { return bp.select0<Tier>(r); }
+
+      auto const &bits  = bp.data();
+      uint64_t i        = r % zeros_per_sample;
+      uint64_t word_idx = pos / 64;
+      uint64_t word     = ~bits[word_idx] & (~uint64_t(0) << (pos % 64));
+      uint64_t zeros    = broadword::popcount<Tier>(word);
+      while (zeros <= i) {
+        i -= zeros;
+        word  = ~bits[++word_idx];
+        zeros = broadword::popcount<Tier>(word);
+      }
+      uint64_t ret = word_idx * 64 + broadword::select_in_word<Tier>(word, i);
+      assert(ret == bp.select0(r));
+      return ret;
+    }
+
+    mapper::mappable_vector<uint64_t> m_zero_samples;
+    mapper::mappable_vector<uint8_t> m_word_min;
+  };
+
   template <typename Range, typename Comparator>
   void build_from_range(Range const &v, Comparator const &comp) {
     using value_type = std::ranges::range_value_t<Range>;
@@ -149,7 +332,93 @@ class cartesian_tree {
     cartesian_tree(&b).swap(*this);
   }
 
+  // The builder emits, for each value, a 0 followed by a 1 for each value it
+  // pops from the stack. The array is split in chunks whose stacks are
+  // simulated independently: a value pops the same values of its own chunk
+  // as in the sequential build, and reaches the values left by the previous
+  // chunks only when it empties its chunk's stack. A sequential merge of the
+  // leftover stacks counts these extra pops, then the chunks emit their bits
+  // (reversed, as finalize() does) in parallel and are concatenated.
+  template <typename Range, typename Comparator>
+  void build_from_range_parallel(Range const &v, Comparator const &comp, size_t num_threads) {
+    using value_type = std::ranges::range_value_t<Range>;
+    static_assert(std::ranges::random_access_range<Range const>, "parallel build needs a random access range");
+
+    auto first = std::ranges::begin(v);
+    uint64_t n = uint64_t(std::ranges::size(v));
+    num_threads =
+      std::max<size_t>(1, std::min<uint64_t>(util::resolve_num_threads(num_threads), n / min_values_per_thread));
+    if (num_threads == 1) {
+      build_from_range(v, comp);
+      return;
+    }
+
+    struct chunk {
+      std::vector<uint64_t> stack_emptying;  // values that found the chunk stack empty
+      std::vector<uint64_t> extra_pops;      // values they pop from the previous chunks
+      std::vector<value_type> stack;         // chunk stack at the end
+      bit_vector_builder bits;
+    };
+    std::vector<chunk> chunks(num_threads);
+
+    util::parallel_ranges(n, num_threads, [&](size_t t, uint64_t begin, uint64_t end) {
+      chunk &c = chunks[t];
+      for (uint64_t i = begin; i < end; ++i) {
+        while (!c.stack.empty() && comp(first[i], c.stack.back())) { c.stack.pop_back(); }
+        if (c.stack.empty()) { c.stack_emptying.push_back(i); }
+        c.stack.push_back(first[i]);
+      }
+    });
+
+    std::vector<value_type> stack;
+    for (chunk &c : chunks) {
+      c.extra_pops.resize(c.stack_emptying.size());
+      for (size_t j = 0; j < c.stack_emptying.size(); ++j) {
+        while (!stack.empty() && comp(first[c.stack_emptying[j]], stack.back())) {
+          stack.pop_back();
+          c.extra_pops[j] += 1;
+        }
+      }
+      stack.insert(stack.end(), c.stack.begin(), c.stack.end());
+      std::vector<value_type>().swap(c.stack);
+    }
+
+    util::parallel_ranges(n, num_threads, [&](size_t t, uint64_t begin, uint64_t end) {
+      chunk &c = chunks[t];
+      std::vector<value_type> local_stack;
+      size_t emptying = 0;
+      c.bits.reserve(2 * (end - begin));
+      for (uint64_t i = begin; i < end; ++i) {
+        c.bits.push_back(0);
+        while (!local_stack.empty() && comp(first[i], local_stack.back())) {
+          local_stack.pop_back();
+          c.bits.push_back(1);
+        }
+        if (local_stack.empty()) { c.bits.one_extend(c.extra_pops[emptying++]); }
+        local_stack.push_back(first[i]);
+      }
+      c.bits.reverse();
+    });
+
+    // finalize() appends the super-root, the pops of the leftover stack and
+    // a closing 1, which come first once reversed
+    bit_vector_builder bp;
+    bp.reserve(2 * n + 2);
+    bp.push_back(1);
+    bp.one_extend(stack.size());
+    bp.push_back(0);
+    for (size_t t = num_threads; t-- > 0;) {
+      bp.append(chunks[t].bits);
+      bit_vector_builder().swap(chunks[t].bits);
+    }
+
+    bp_vector(&bp, false, true, bp_vector::min_tree_layout::binary, num_threads).swap(m_bp);
+  }
+
+  static const uint64_t min_values_per_thread = 1 << 16;
+
   bp_vector m_bp;
+  short_range_index m_short_range;
 };
 
 }  // namespace succinct
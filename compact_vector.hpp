@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "bit_vector.hpp"
+#include "broadword.hpp"
+#include "forward_enumerator.hpp"
+
+namespace succinct {
+
+// Array of unsigned integers stored in a fixed number of bits each, from 1
+// to 64, packed back to back in a bit_vector. The width is chosen at
+// construction time, either explicitly or as the number of bits of the
+// largest value.
+class compact_vector {
+ public:
+  typedef uint64_t value_type;
+
+  class builder {
+   public:
+    builder(uint64_t width, uint64_t n = 0) : m_width(width), m_size(0) {
+      if (!width || width > 64) { throw std::invalid_argument("compact_vector width must be in [1, 64]"); }
+      m_bits.reserve(n * width);
+    }
+
+    void push_back(uint64_t val) {
+      assert(m_width == 64 || (val >> m_width) == 0);
+      m_bits.append_bits(val, m_width);
+      m_size += 1;
+    }
+
+    // overwrite a value already pushed
+    void set(uint64_t idx, uint64_t val) {
+      assert(idx < m_size);
+      m_bits.set_bits(idx * m_width, val, m_width);
+    }
+
+    uint64_t size() const { return m_size; }
+
+    uint64_t width() const { return m_width; }
+
+   private:
+    friend class compact_vector;
+
+    uint64_t m_width;
+    uint64_t m_size;
+    bit_vector_builder m_bits;
+  };
+
+  compact_vector() : m_size(0), m_width(0) {}
+
+  compact_vector(builder *from) : m_size(from->m_size), m_width(from->m_width) {
+    bit_vector(&from->m_bits).swap(m_bits);
+  }
+
+  // width is the number of bits of the largest value, at least 1
+  template <typename Range>
+  compact_vector(Range const &values) : m_size(0), m_width(0) {
+    uint64_t max_val = 0;
+    for (auto iter = std::begin(values); iter != std::end(values); ++iter) {
+      max_val = std::max<uint64_t>(max_val, *iter);
+    }
+    build(values, max_val ? broadword::msb(max_val) + 1 : 1);
+  }
+
+  template <typename Range>
+  compact_vector(Range const &values, uint64_t width) : m_size(0), m_width(0) {
+    build(values, width);
+  }
+
+  template <typename Visitor>
+  void map(Visitor &visit) {
+    visit(m_size, "m_size")(m_width, "m_width")(m_bits, "m_bits");
+  }
+
+  void swap(compact_vector &other) {
+    std::swap(m_size, other.m_size);
+    std::swap(m_width, other.m_width);
+    m_bits.swap(other.m_bits);
+  }
+
+  inline value_type operator[](uint64_t idx) const {
+    assert(idx < m_size);
+    return m_bits.get_bits(idx * m_width, m_width);
+  }
+
+  // out[i] = (*this)[begin + i] for i < n, unpacked in bulk
+  void get_range(uint64_t begin, size_t n, value_type *out) const {
+    assert(begin + n <= m_size);
+    broadword::unpack_bits(m_bits.data().data(), begin * m_width, m_width, n, out);
+  }
+
+  inline uint64_t size() const { return m_size; }
+
+  inline uint64_t width() const { return m_width; }
+
+  bit_vector const &bits() const { return m_bits; }
+
+ private:
+  template <typename Range>
+  void build(Range const &values, uint64_t width) {
+    builder b(width);
+    for (auto iter = std::begin(values); iter != std::end(values); ++iter) { b.push_back(*iter); }
+    compact_vector(&b).swap(*this);
+  }
+
+  uint64_t m_size;
+  uint64_t m_width;
+  bit_vector m_bits;
+};
+
+template <>
+struct forward_enumerator<compact_vector> {
+  typedef compact_vector::value_type value_type;
+
+  forward_enumerator(compact_vector const &c, size_t idx = 0)
+    : m_c(&c), m_idx(idx), m_bits_enumerator(c.bits(), idx * c.width()) {}
+
+  value_type next() {
+    assert(m_idx < m_c->size());
+    m_idx += 1;
+    return m_bits_enumerator.take(m_c->width());
+  }
+
+  // same as n calls to next()
+  void decode(value_type *out, size_t n) {
+    m_c->get_range(m_idx, n, out);
+    m_idx += n;
+    m_bits_enumerator = bit_vector::enumerator(m_c->bits(), m_idx * m_c->width());
+  }
+
+ private:
+  compact_vector const *m_c;
+  uint64_t m_idx;
+  bit_vector::enumerator m_bits_enumerator;
+};
+
+}  // namespace succinct
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <numeric>
+
 #include "bit_vector.hpp"
+#include "util.hpp"
 
 namespace succinct {
 
@@ -11,27 +14,30 @@ class darray {
  public:
   darray() : m_positions() {}
 
-  darray(bit_vector const &bv) : m_positions() {
-    mapper::mappable_vector<uint64_t> const &data = bv.data();
-
-    std::vector<uint64_t> cur_block_positions;
-    std::vector<int64_t> block_inventory;
-    std::vector<uint16_t> subblock_inventory;
-    std::vector<uint64_t> overflow_positions;
+  // Incremental construction from the words of a bit vector of the given
+  // size, fed in order; used to index bit vectors that are not kept in
+  // memory. expected_positions is only used to reserve space.
+  class builder {
+   public:
+    builder(uint64_t size, uint64_t expected_positions = 0) : m_size(size), m_cur_pos(0), m_positions(0) {
+      m_block_inventory.reserve(util::ceil_div(expected_positions, block_size));
+      m_subblock_inventory.reserve(util::ceil_div(expected_positions, subblock_size));
+    }
 
-    for (size_t word_idx = 0; word_idx < data.size(); ++word_idx) {
-      size_t cur_pos    = word_idx * 64;
-      uint64_t cur_word = WordGetter()(data, word_idx);
+    void append_word(uint64_t word) {
+      size_t cur_pos    = m_cur_pos;
+      uint64_t cur_word = WordGetter()(word);
+      m_cur_pos += 64;
       unsigned long l;
       while (broadword::lsb(cur_word, l)) {
         cur_pos += l;
         cur_word >>= l;
-        if (cur_pos >= bv.size()) break;
+        if (cur_pos >= m_size) break;
 
-        cur_block_positions.push_back(cur_pos);
+        m_cur_block_positions.push_back(cur_pos);
 
-        if (cur_block_positions.size() == block_size) {
-          flush_cur_block(cur_block_positions, block_inventory, subblock_inventory, overflow_positions);
+        if (m_cur_block_positions.size() == block_size) {
+          flush_cur_block(m_cur_block_positions, m_block_inventory, m_subblock_inventory, m_overflow_positions);
         }
 
         // can't do >>= l + 1, can be 64
@@ -40,10 +46,103 @@ class darray {
         m_positions += 1;
       }
     }
-    if (cur_block_positions.size()) {
-      flush_cur_block(cur_block_positions, block_inventory, subblock_inventory, overflow_positions);
+
+    void build(darray &d) {
+      if (m_cur_block_positions.size()) {
+        flush_cur_block(m_cur_block_positions, m_block_inventory, m_subblock_inventory, m_overflow_positions);
+      }
+      d.m_positions = m_positions;
+      d.m_block_inventory.steal(m_block_inventory);
+      d.m_subblock_inventory.steal(m_subblock_inventory);
+      d.m_overflow_positions.steal(m_overflow_positions);
+    }
+
+   private:
+    uint64_t m_size;
+    uint64_t m_cur_pos;
+    size_t m_positions;
+    std::vector<uint64_t> m_cur_block_positions;
+    std::vector<int64_t> m_block_inventory;
+    std::vector<uint16_t> m_subblock_inventory;
+    std::vector<uint64_t> m_overflow_positions;
+  };
+
+  darray(bit_vector const &bv) : m_positions() {
+    mapper::mappable_vector<uint64_t> const &data = bv.data();
+    builder b(bv.size(), WordGetter::count(bv));
+    for (size_t word_idx = 0; word_idx < data.size(); ++word_idx) { b.append_word(data[word_idx]); }
+    b.build(*this);
+  }
+
+  // Same as darray(bv), built with num_threads threads (0 means one per
+  // hardware thread): each thread collects the blocks whose first position
+  // is in its range of words, reading past the range to complete the last
+  // one, and the inventories of the ranges are concatenated
+  darray(bit_vector const &bv, size_t num_threads) : m_positions() {
+    mapper::mappable_vector<uint64_t> const &data = bv.data();
+    num_threads = std::max<size_t>(
+      1, std::min<uint64_t>(util::resolve_num_threads(num_threads), data.size() / min_words_per_thread));
+    if (num_threads == 1) {
+      darray(bv).swap(*this);
+      return;
     }
 
+    auto word_at = [&](uint64_t word_idx) {
+      uint64_t word = WordGetter()(data, word_idx);
+      if (word_idx == data.size() - 1 && bv.size() % 64) { word &= (uint64_t(1) << (bv.size() % 64)) - 1; }
+      return word;
+    };
+
+    // number of positions before each range of words
+    std::vector<uint64_t> range_positions(num_threads + 1);
+    util::parallel_ranges(data.size(), num_threads, [&](size_t t, uint64_t begin, uint64_t end) {
+      uint64_t count = 0;
+      for (uint64_t word_idx = begin; word_idx < end; ++word_idx) { count += broadword::popcount(word_at(word_idx)); }
+      range_positions[t + 1] = count;
+    });
+    std::partial_sum(range_positions.begin(), range_positions.end(), range_positions.begin());
+    m_positions = range_positions.back();
+
+    struct inventories {
+      std::vector<int64_t> blocks;
+      std::vector<uint16_t> subblocks;
+      std::vector<uint64_t> overflow;
+    };
+    std::vector<inventories> parts(num_threads);
+    util::parallel_ranges(data.size(), num_threads, [&](size_t t, uint64_t begin, uint64_t) {
+      uint64_t idx   = range_positions[t];
+      uint64_t first = util::ceil_div(idx, uint64_t(block_size)) * block_size;
+      uint64_t last  = std::min<uint64_t>(util::ceil_div(range_positions[t + 1], uint64_t(block_size)) * block_size,
+                                          m_positions);
+      inventories &part = parts[t];
+      std::vector<uint64_t> cur_block_positions;
+      cur_block_positions.reserve(block_size);
+      for (uint64_t word_idx = begin; idx < last; ++word_idx) {
+        uint64_t word = word_at(word_idx);
+        unsigned long pos_in_word;
+        for (; idx < last && broadword::lsb(word, pos_in_word); ++idx, word &= word - 1) {
+          if (idx < first) continue;
+          cur_block_positions.push_back(word_idx * 64 + pos_in_word);
+          if (cur_block_positions.size() == block_size) {
+            flush_cur_block(cur_block_positions, part.blocks, part.subblocks, part.overflow);
+          }
+        }
+      }
+      if (cur_block_positions.size()) {
+        flush_cur_block(cur_block_positions, part.blocks, part.subblocks, part.overflow);
+      }
+    });
+
+    std::vector<int64_t> block_inventory;
+    std::vector<uint16_t> subblock_inventory;
+    std::vector<uint64_t> overflow_positions;
+    for (auto &part : parts) {
+      // overflow blocks store -(offset in overflow_positions) - 1
+      int64_t overflow_base = int64_t(overflow_positions.size());
+      for (int64_t block : part.blocks) { block_inventory.push_back(block < 0 ? block - overflow_base : block); }
+      subblock_inventory.insert(subblock_inventory.end(), part.subblocks.begin(), part.subblocks.end());
+      overflow_positions.insert(overflow_positions.end(), part.overflow.begin(), part.overflow.end());
+    }
     m_block_inventory.steal(block_inventory);
     m_subblock_inventory.steal(subblock_inventory);
     m_overflow_positions.steal(overflow_positions);
@@ -62,6 +161,12 @@ class darray {
     m_overflow_positions.swap(other.m_overflow_positions);
   }
 
+  inline uint64_t select(bit_vector const &bv, uint64_t idx) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(bv, idx); });
+  }
+
+  // Same as select(bv, idx), with the scalar kernels of the given tier
+  template <broadword::kernel_tier Tier>
   inline uint64_t select(bit_vector const &bv, uint64_t idx) const {
     assert(idx < num_positions());
     uint64_t block    = idx / block_size;
@@ -84,13 +189,13 @@ class darray {
       uint64_t word     = WordGetter()(data, word_idx) & (uint64_t(-1) << word_shift);
 
       while (true) {
-        size_t popcnt = broadword::popcount(word);
+        size_t popcnt = broadword::popcount<Tier>(word);
         if (reminder < popcnt) break;
         reminder -= popcnt;
         word = WordGetter()(data, ++word_idx);
       }
 
-      return 64 * word_idx + broadword::select_in_word(word, reminder);
+      return 64 * word_idx + broadword::select_in_word<Tier>(word, reminder);
     }
   }
 
@@ -117,6 +222,7 @@ class darray {
   static const size_t block_size            = 1024;
   static const size_t subblock_size         = 32;
   static const size_t max_in_block_distance = 1 << 16;
+  static const size_t min_words_per_thread  = 1 << 12;
 
   size_t m_positions;
   mapper::mappable_vector<int64_t> m_block_inventory;
@@ -126,10 +232,21 @@ class darray {
 
 struct identity_getter {
   uint64_t operator()(mapper::mappable_vector<uint64_t> const &data, size_t idx) const { return data[idx]; }
+
+  uint64_t operator()(uint64_t word) const { return word; }
+
+  // number of positions the darray will index
+  static uint64_t count(bit_vector const &bv) {
+    return broadword::popcount_words(bv.data().data(), bv.data().size());
+  }
 };
 
 struct negating_getter {
   uint64_t operator()(mapper::mappable_vector<uint64_t> const &data, size_t idx) const { return ~data[idx]; }
+
+  uint64_t operator()(uint64_t word) const { return ~word; }
+
+  static uint64_t count(bit_vector const &bv) { return bv.size() - identity_getter::count(bv); }
 };
 }  // namespace detail
 
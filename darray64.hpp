@@ -1,5 +1,8 @@
 #pragma once
 
+#include <optional>
+#include <stdexcept>
+
 #include "bit_vector.hpp"
 #include "broadword.hpp"
 
@@ -27,6 +30,51 @@ struct darray64 {
     std::vector<uint16_t> subblock_inventory;
   };
 
+  // Streaming counterpart of builder: the bits are written to out as they
+  // are appended and the inventories when finish() is called, producing the
+  // same frozen data as freezing darray64(&builder). The number of ones and
+  // the final size of the bit vector must be known in advance.
+  class stream_builder {
+   public:
+    stream_builder(mapper::stream_freezer &out, size_t num_ones, uint64_t num_bits)
+      : m_out(out), m_expected_ones(num_ones), m_ones(0) {
+      out.write_pod(num_ones);
+      m_bits.emplace(out, num_bits);
+      m_block_inventory.reserve(util::ceil_div(num_ones, block_size));
+      m_subblock_inventory.reserve(util::ceil_div(num_ones, subblock_size));
+    }
+
+    void append1(size_t skip0 = 0) {
+      m_bits->zero_extend(skip0);
+      m_bits->push_back(1);
+
+      if (m_ones % block_size == 0) { m_block_inventory.push_back(m_bits->size() - 1); }
+      if (m_ones % subblock_size == 0) {
+        m_subblock_inventory.push_back(uint16_t(m_bits->size() - 1 - m_block_inventory[m_ones / block_size]));
+      }
+
+      m_ones += 1;
+    }
+
+    // zeros after the last one, up to the declared size
+    void zero_extend(uint64_t n) { m_bits->zero_extend(n); }
+
+    void finish() {
+      if (m_ones != m_expected_ones) { throw std::logic_error("darray64::stream_builder got a wrong number of ones"); }
+      m_bits->finish();
+      m_out.write_vector(m_block_inventory);
+      m_out.write_vector(m_subblock_inventory);
+    }
+
+   private:
+    mapper::stream_freezer &m_out;
+    size_t m_expected_ones;
+    size_t m_ones;
+    std::optional<bit_vector_stream_builder> m_bits;  // constructed after m_num_ones is written
+    std::vector<uint64_t> m_block_inventory;
+    std::vector<uint16_t> m_subblock_inventory;
+  };
+
   darray64() : m_num_ones(0) {}
 
   darray64(builder *b) {
@@ -53,6 +101,12 @@ struct darray64 {
 
   bit_vector const &bits() const { return m_bits; }
 
+  size_t select(size_t idx) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(idx); });
+  }
+
+  // Same as select(idx), with the scalar kernels of the given tier
+  template <broadword::kernel_tier Tier>
   size_t select(size_t idx) const {
     assert(idx < num_ones());
     size_t block     = idx / block_size;
@@ -70,13 +124,13 @@ struct darray64 {
       uint64_t word     = m_bits.data()[word_idx] & (uint64_t(-1) << word_shift);
 
       while (true) {
-        size_t popcnt = broadword::popcount(word);
+        size_t popcnt = broadword::popcount<Tier>(word);
         if (reminder < popcnt) break;
         reminder -= popcnt;
         word = m_bits.data()[++word_idx];
       }
 
-      return 64 * word_idx + broadword::select_in_word(word, reminder);
+      return 64 * word_idx + broadword::select_in_word<Tier>(word, reminder);
     }
   }
 
@@ -1,5 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
 #include "bit_vector.hpp"
 #include "darray.hpp"
 
@@ -65,12 +72,126 @@ class elias_fano {
     bit_vector_builder m_low_bits;
   };
 
+  // Streaming counterpart of elias_fano_builder, which writes the same
+  // frozen data as freezing elias_fano(&builder) without materializing it:
+  // the high bits are written to out as they are produced, the low bits
+  // are spilled to a temporary file and copied to out by finish(), and only
+  // the darray inventories are kept in memory.
+  class stream_builder {
+   public:
+    stream_builder(mapper::stream_freezer &out, uint64_t n, uint64_t m, bool with_rank_index = true)
+      : m_out(out),
+        m_n(n),
+        m_m(m),
+        m_pos(0),
+        m_last(0),
+        m_l(uint8_t((m && n / m) ? broadword::msb(n / m) : 0)),
+        m_high_size((m + 1) + (n >> m_l) + 1),
+        m_d1_builder(m_high_size, m),
+        m_low_pos(0),
+        m_low_word(0),
+        m_low_spill(nullptr, &fclose) {
+      assert(m_l < 64);  // for the correctness of low_mask
+      if (with_rank_index) { m_d0_builder.emplace(m_high_size, m_high_size - m); }
+      if (m_l) {
+        m_low_spill.reset(std::tmpfile());
+        if (!m_low_spill) { throw std::runtime_error("Unable to create a temporary file for the low bits"); }
+        m_low_buffer.reserve(low_buffer_words);
+      }
+
+      out.write_pod(n);
+      m_high_bits.emplace(out, m_high_size, [this](uint64_t word) {
+        m_d1_builder.append_word(word);
+        if (m_d0_builder) { m_d0_builder->append_word(word); }
+      });
+    }
+
+    inline void push_back(uint64_t i) {
+      assert(i >= m_last && i <= m_n);
+      m_last            = i;
+      uint64_t low_mask = (1ULL << m_l) - 1;
+
+      if (m_l) { append_low_bits(i & low_mask); }
+      uint64_t high_pos = (i >> m_l) + m_pos;
+      m_high_bits->zero_extend(high_pos - m_high_bits->size());
+      m_high_bits->push_back(1);
+      ++m_pos;
+      assert(m_pos <= m_m);
+    }
+
+    void finish() {
+      if (m_pos != m_m) { throw std::logic_error("elias_fano::stream_builder got a wrong number of elements"); }
+      m_high_bits->zero_extend(m_high_size - m_high_bits->size());
+      m_high_bits->finish();
+
+      darray1 d1;
+      m_d1_builder.build(d1);
+      m_out(d1, "m_high_bits_d1");
+      darray0 d0;
+      if (m_d0_builder) { m_d0_builder->build(d0); }
+      m_out(d0, "m_high_bits_d0");
+
+      uint64_t low_size = m_m * m_l;
+      m_out.write_pod(low_size);
+      auto low_words = m_out.begin_vector<uint64_t>(detail::words_for(low_size));
+      if (m_l) {
+        if (m_low_pos % 64) { m_low_buffer.push_back(m_low_word); }
+        spill_low_buffer();
+        std::rewind(m_low_spill.get());
+        std::vector<uint64_t> buf(low_buffer_words);
+        size_t read;
+        while ((read = std::fread(buf.data(), sizeof(uint64_t), buf.size(), m_low_spill.get()))) {
+          low_words.write(buf.data(), read);
+        }
+        if (std::ferror(m_low_spill.get())) { throw std::runtime_error("Error reading back the low bits"); }
+      }
+      low_words.finish();
+      m_out.write_pod(m_l);
+    }
+
+   private:
+    static const size_t low_buffer_words = 1 << 16;
+
+    void append_low_bits(uint64_t bits) {
+      uint64_t pos_in_word = m_low_pos % 64;
+      m_low_pos += m_l;
+      m_low_word |= bits << pos_in_word;
+      if (pos_in_word + m_l >= 64) {
+        m_low_buffer.push_back(m_low_word);
+        m_low_word = pos_in_word ? bits >> (64 - pos_in_word) : 0;
+        if (m_low_buffer.size() == low_buffer_words) { spill_low_buffer(); }
+      }
+    }
+
+    void spill_low_buffer() {
+      if (std::fwrite(m_low_buffer.data(), sizeof(uint64_t), m_low_buffer.size(), m_low_spill.get()) !=
+          m_low_buffer.size()) {
+        throw std::runtime_error("Error spilling the low bits to a temporary file");
+      }
+      m_low_buffer.clear();
+    }
+
+    mapper::stream_freezer &m_out;
+    uint64_t m_n;
+    uint64_t m_m;
+    uint64_t m_pos;
+    uint64_t m_last;
+    uint8_t m_l;
+    uint64_t m_high_size;
+    darray1::builder m_d1_builder;
+    std::optional<darray0::builder> m_d0_builder;
+    std::optional<bit_vector_stream_builder> m_high_bits;  // constructed after m_size is written
+    uint64_t m_low_pos;
+    uint64_t m_low_word;
+    std::vector<uint64_t> m_low_buffer;
+    std::unique_ptr<FILE, decltype(&fclose)> m_low_spill;
+  };
+
   elias_fano(bit_vector_builder *bvb, bool with_rank_index = true) {
     bit_vector_builder::bits_type &bits = bvb->move_bits();
     uint64_t n                          = bvb->size();
 
-    uint64_t m = 0;
-    for (size_t i = 0; i < bits.size(); ++i) { m += broadword::popcount(bits[i]); }
+    uint64_t m = broadword::popcount_words(bits.data(), bits.size());
 
     bit_vector bv(bvb);
     elias_fano_builder builder(n, m);
@@ -87,6 +208,62 @@ class elias_fano {
 
   elias_fano(elias_fano_builder *builder, bool with_rank_index = true) { build(*builder, with_rank_index); }
 
+  // Same as pushing the values of sorted_values, a random-access range of
+  // non-decreasing values not greater than n, to an elias_fano_builder(n,
+  // sorted_values.size()), with num_threads threads (0 means one per
+  // hardware thread). Each thread writes the high and low bits of a range
+  // of values in place; only the words at the ends of the ranges are shared,
+  // and those are updated atomically. The darrays are built in parallel too.
+  template <typename Range>
+  elias_fano(Range const &sorted_values, uint64_t n, bool with_rank_index = true, size_t num_threads = 1) {
+    uint64_t m = uint64_t(sorted_values.size());
+    m_size     = n;
+    m_l        = uint8_t((m && n / m) ? broadword::msb(n / m) : 0);
+    assert(m_l < 64);  // for the correctness of low_mask
+
+    bit_vector_builder high_bits((m + 1) + (n >> m_l) + 1);
+    bit_vector_builder low_bits(m * m_l);
+    uint64_t *high_words = high_bits.move_bits().data();
+    uint64_t *low_words  = low_bits.move_bits().data();
+    uint64_t l           = m_l;
+    uint64_t low_mask    = (uint64_t(1) << l) - 1;
+
+    num_threads =
+      std::max<size_t>(1, std::min<uint64_t>(util::resolve_num_threads(num_threads), m / min_values_per_thread));
+    util::parallel_ranges(m, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+      if (begin == end) return;
+      uint64_t high_first = ((uint64_t(sorted_values[begin]) >> l) + begin) / 64;
+      uint64_t high_last  = ((uint64_t(sorted_values[end - 1]) >> l) + end - 1) / 64;
+      uint64_t low_first  = begin * l / 64;
+      uint64_t low_last   = (end * l + 63) / 64 - 1;
+      auto set_bits       = [](uint64_t *words, uint64_t word_idx, uint64_t bits, uint64_t first, uint64_t last) {
+        if (word_idx == first || word_idx == last) {
+          std::atomic_ref<uint64_t>(words[word_idx]).fetch_or(bits, std::memory_order_relaxed);
+        } else {
+          words[word_idx] |= bits;
+        }
+      };
+
+      for (uint64_t i = begin; i < end; ++i) {
+        uint64_t v = uint64_t(sorted_values[i]);
+        assert(v <= n && (i == begin || v >= uint64_t(sorted_values[i - 1])));
+        uint64_t high_pos = (v >> l) + i;
+        set_bits(high_words, high_pos / 64, uint64_t(1) << (high_pos % 64), high_first, high_last);
+        if (l) {
+          uint64_t low = v & low_mask;
+          uint64_t pos = i * l;
+          set_bits(low_words, pos / 64, low << (pos % 64), low_first, low_last);
+          if (pos % 64 + l > 64) { set_bits(low_words, pos / 64 + 1, low >> (64 - pos % 64), low_first, low_last); }
+        }
+      }
+    });
+
+    bit_vector(&high_bits).swap(m_high_bits);
+    darray1(m_high_bits, num_threads).swap(m_high_bits_d1);
+    if (with_rank_index) { darray0(m_high_bits, num_threads).swap(m_high_bits_d0); }
+    bit_vector(&low_bits).swap(m_low_bits);
+  }
+
   template <typename Visitor>
   void map(Visitor &visit) {
     visit(m_size, "m_size")(m_high_bits, "m_high_bits")(m_high_bits_d1, "m_high_bits_d1")(
@@ -106,76 +283,91 @@ class elias_fano {
 
   inline uint64_t num_ones() const { return m_high_bits_d1.num_positions(); }
 
+  // The queries dispatch once per call to the overloads templated on the
+  // kernel tier (see broadword::dispatch_query)
   inline bool operator[](uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return get<Tier>(pos); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline bool get(uint64_t pos) const {
     assert(pos <= size());
     assert(m_high_bits_d0.num_positions());  // needs rank index
     uint64_t h_rank = pos >> m_l;
-    uint64_t h_pos  = m_high_bits_d0.select(m_high_bits, h_rank);
+    uint64_t h_pos  = m_high_bits_d0.select<Tier>(m_high_bits, h_rank);
     uint64_t rank   = h_pos - h_rank;
     uint64_t l_pos  = pos & ((1ULL << m_l) - 1);
 
-    while (h_pos > 0 && m_high_bits[h_pos - 1]) {
-      --rank;
-      --h_pos;
-      uint64_t cur_low_bits = m_low_bits.get_bits(rank * m_l, m_l);
-      if (cur_low_bits == l_pos) {
-        return true;
-      } else if (cur_low_bits < l_pos) {
-        return false;
-      }
-    }
+    uint64_t first_geq = bucket_lower_bound<Tier>(h_rank, h_pos, rank, l_pos);
+    return first_geq < rank && m_low_bits.get_bits(first_geq * m_l, m_l) == l_pos;
+  }
 
-    return false;
+  inline uint64_t select(uint64_t n) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(n); });
   }
 
+  template <broadword::kernel_tier Tier>
   inline uint64_t select(uint64_t n) const {
-    return ((m_high_bits_d1.select(m_high_bits, n) - n) << m_l) | m_low_bits.get_bits(n * m_l, m_l);
+    return ((m_high_bits_d1.select<Tier>(m_high_bits, n) - n) << m_l) | m_low_bits.get_bits(n * m_l, m_l);
   }
 
+  inline uint64_t rank(uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return rank<Tier>(pos); });
+  }
+
+  template <broadword::kernel_tier Tier>
   inline uint64_t rank(uint64_t pos) const {
     assert(pos <= m_size);
     assert(m_high_bits_d0.num_positions());  // needs rank index
 
     uint64_t h_rank = pos >> m_l;
-    uint64_t h_pos  = m_high_bits_d0.select(m_high_bits, h_rank);
+    uint64_t h_pos  = m_high_bits_d0.select<Tier>(m_high_bits, h_rank);
     uint64_t rank   = h_pos - h_rank;
     uint64_t l_pos  = pos & ((1ULL << m_l) - 1);
 
-    while (rank > 0 && h_pos > 0 && m_high_bits[h_pos - 1] && m_low_bits.get_bits((rank - 1) * m_l, m_l) >= l_pos) {
-      --rank;
-      --h_pos;
-    }
+    return bucket_lower_bound<Tier>(h_rank, h_pos, rank, l_pos);
+  }
 
-    return rank;
+  inline uint64_t predecessor1(uint64_t pos) const {
+    return broadword::dispatch_query(
+      [&]<broadword::kernel_tier Tier>() { return select<Tier>(rank<Tier>(pos + 1) - 1); });
   }
 
-  inline uint64_t predecessor1(uint64_t pos) const { return select(rank(pos + 1) - 1); }
+  inline uint64_t successor1(uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(rank<Tier>(pos)); });
+  }
 
-  inline uint64_t successor1(uint64_t pos) const { return select(rank(pos)); }
+  // Equivalent to select(n) - select(n - 1) (and select(0) for n = 0).
+  // The previous element is found by scanning the high bits backwards for
+  // a few words, then with a second select if the gap is longer
+  inline uint64_t delta(uint64_t n) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return delta<Tier>(n); });
+  }
 
-  // Equivalent to select(n) - select(n - 1) (and select(0) for n = 0)
-  // Involves a linear search for predecessor in high bits.
-  // Efficient only if there are no large gaps in high bits
-  // XXX(ot): could make this adaptive
+  template <broadword::kernel_tier Tier>
   inline uint64_t delta(uint64_t n) const {
-    uint64_t high_val = m_high_bits_d1.select(m_high_bits, n);
+    uint64_t high_val = m_high_bits_d1.select<Tier>(m_high_bits, n);
     uint64_t low_val  = m_low_bits.get_bits(n * m_l, m_l);
     if (n) {
       return
         // need a + here instead of an | for carry
-        ((high_val - m_high_bits.predecessor1(high_val - 1) - 1) << m_l) + low_val -
-        m_low_bits.get_bits((n - 1) * m_l, m_l);
+        ((high_val - prev_high_pos<Tier>(n, high_val) - 1) << m_l) + low_val - m_low_bits.get_bits((n - 1) * m_l, m_l);
     } else {
       return ((high_val - n) << m_l) | low_val;
     }
   }
 
   // same as delta()
+  inline std::pair<uint64_t, uint64_t> select_range(uint64_t n) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select_range<Tier>(n); });
+  }
+
+  template <broadword::kernel_tier Tier>
   inline std::pair<uint64_t, uint64_t> select_range(uint64_t n) const {
     assert(n + 1 < num_ones());
-    uint64_t high_val_b = m_high_bits_d1.select(m_high_bits, n);
+    uint64_t high_val_b = m_high_bits_d1.select<Tier>(m_high_bits, n);
     uint64_t low_val_b  = m_low_bits.get_bits(n * m_l, m_l);
-    uint64_t high_val_e = m_high_bits.successor1(high_val_b + 1);
+    uint64_t high_val_e = next_high_pos<Tier>(n, high_val_b);
     uint64_t low_val_e  = m_low_bits.get_bits((n + 1) * m_l, m_l);
     return std::make_pair(((high_val_b - n) << m_l) | low_val_b, ((high_val_e - n - 1) << m_l) | low_val_e);
   }
@@ -214,6 +406,37 @@ class elias_fano {
       return ret;
     }
 
+    // Equivalent to n calls to next(), writing the values to out. The high
+    // parts are found with a bulk scan of the unary codes and the low parts
+    // unpacked together, rather than one value at a time.
+    void decode_block(uint64_t *out, size_t n) {
+      if (!n) return;
+      assert(m_i + n <= m_ef->num_ones());
+
+      uint64_t last = out[0] = m_high_enum.next();
+      if (n > 1) { last = broadword::one_positions(m_ef->m_high_bits.data().data(), out[0] + 1, n - 1, out + 1); }
+      m_high_enum = bit_vector::unary_enumerator(m_ef->m_high_bits, last + 1);
+
+      static const size_t chunk_size = 256;
+      uint64_t low[chunk_size];
+      for (size_t begin = 0; begin < n; begin += chunk_size) {
+        size_t end = std::min(n, begin + chunk_size);
+        if (m_l) {
+          broadword::unpack_bits(m_ef->m_low_bits.data().data(), (m_i + begin) * m_l, m_l, end - begin, low);
+        }
+        for (size_t k = begin; k < end; ++k) {
+          out[k] = ((out[k] - (m_i + k)) << m_l) | (m_l ? low[k - begin] : 0);
+        }
+      }
+
+      m_i += n;
+      if (m_l) {
+        m_chunks_avail = 0;
+      } else {
+        m_chunks_avail -= n;
+      }
+    }
+
    private:
     elias_fano const *m_ef;
     uint64_t m_i;
@@ -225,7 +448,171 @@ class elias_fano {
     uint64_t m_chunks_avail;
   };
 
+  // Forward-only cursor for successor queries with non-decreasing targets,
+  // as in posting list intersection. Short jumps are resolved by scanning
+  // the high bits from the current position, longer ones with
+  // m_high_bits_d0 (if built) instead of starting from scratch each time
+  // as successor1 does.
+  struct next_geq_enumerator {
+    next_geq_enumerator(elias_fano const &ef) : m_ef(&ef), m_i(0), m_high_pos(0) {
+      if (!m_ef->num_ones()) {
+        m_value = end_value;
+        return;
+      }
+      m_high_pos = m_ef->m_high_bits_d1.select(m_ef->m_high_bits, 0);
+      m_value    = value(0, m_high_pos);
+    }
+
+    // Moves to the first value >= x at or after the current position and
+    // returns it, or returns uint64_t(-1) (with position() == num_ones()) if
+    // there is none
+    uint64_t next_geq(uint64_t x) {
+      return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return next_geq<Tier>(x); });
+    }
+
+    template <broadword::kernel_tier Tier>
+    uint64_t next_geq(uint64_t x) {
+      if (x <= m_value) { return m_value; }
+      if (x > m_ef->size()) { return exhaust(); }
+
+      uint64_t const *words = m_ef->m_high_bits.data().data();
+      uint64_t h            = x >> m_ef->m_l;
+      uint64_t cur_h        = m_high_pos - m_i;
+      uint64_t pos;  // first position of bucket h, or the current one if in the same bucket
+      if (h == cur_h) {
+        pos = m_high_pos;
+      } else if (h - cur_h > linear_scan_buckets && m_ef->m_high_bits_d0.num_positions()) {
+        pos = m_ef->m_high_bits_d0.select<Tier>(m_ef->m_high_bits, h - 1) + 1;
+      } else {
+        // skip the zeros closing the buckets up to h - 1
+        uint64_t to_skip = h - cur_h;
+        uint64_t block   = m_high_pos / 64;
+        uint64_t word    = ~words[block] & (uint64_t(-1) << (m_high_pos % 64));
+        uint64_t cnt;
+        while ((cnt = broadword::popcount<Tier>(word)) < to_skip) {
+          to_skip -= cnt;
+          word = ~words[++block];
+        }
+        pos = block * 64 + broadword::select_in_word<Tier>(word, to_skip - 1) + 1;
+      }
+
+      uint64_t block = pos / 64;
+      uint64_t word  = words[block] & (uint64_t(-1) << (pos % 64));
+      for (uint64_t i = pos - h; i < m_ef->num_ones(); ++i) {
+        unsigned long pos_in_word;
+        while (!broadword::lsb(word, pos_in_word)) { word = words[++block]; }
+        uint64_t high_pos = block * 64 + pos_in_word;
+        uint64_t v        = value(i, high_pos);
+        if (v >= x) {
+          m_i        = i;
+          m_high_pos = high_pos;
+          m_value    = v;
+          return v;
+        }
+        word &= word - 1;
+      }
+      return exhaust();
+    }
+
+    uint64_t position() const { return m_i; }
+
+   private:
+    static const uint64_t end_value           = uint64_t(-1);
+    static const uint64_t linear_scan_buckets = 256;  // about 8 words of high bits
+
+    inline uint64_t value(uint64_t i, uint64_t high_pos) const {
+      return ((high_pos - i) << m_ef->m_l) | m_ef->m_low_bits.get_bits(i * m_ef->m_l, m_ef->m_l);
+    }
+
+    uint64_t exhaust() {
+      m_i     = m_ef->num_ones();
+      m_value = end_value;
+      return m_value;
+    }
+
+    elias_fano const *m_ef;
+    uint64_t m_i;
+    uint64_t m_high_pos;
+    uint64_t m_value;
+  };
+
  protected:
+  static const uint64_t min_values_per_thread = 1 << 16;
+  static const uint64_t gap_scan_words        = 4;   // longer gaps between elements are jumped with a select
+  static const uint64_t bucket_linear_scan    = 8;   // elements of a bucket scanned one at a time
+  static const uint64_t bucket_window         = 64;  // the rest is binary searched down to this size
+
+  // Position in the high bits of the (n - 1)-th element, given the
+  // position of the n-th one, with n > 0
+  template <broadword::kernel_tier Tier>
+  inline uint64_t prev_high_pos(uint64_t n, uint64_t high_pos) const {
+    uint64_t const *words = m_high_bits.data().data();
+    uint64_t block        = high_pos / 64;
+    uint64_t word         = words[block] & ((uint64_t(1) << (high_pos % 64)) - 1);
+    for (uint64_t i = 1; i < gap_scan_words && block > 0 && !word; ++i) { word = words[--block]; }
+    unsigned long pos_in_word;
+    if (broadword::msb(word, pos_in_word)) { return block * 64 + pos_in_word; }
+    return m_high_bits_d1.select<Tier>(m_high_bits, n - 1);
+  }
+
+  // Position in the high bits of the (n + 1)-th element, given the
+  // position of the n-th one, with n + 1 < num_ones()
+  template <broadword::kernel_tier Tier>
+  inline uint64_t next_high_pos(uint64_t n, uint64_t high_pos) const {
+    uint64_t const *words = m_high_bits.data().data();
+    uint64_t block        = high_pos / 64;
+    uint64_t word         = words[block] & (uint64_t(-2) << (high_pos % 64));
+    for (uint64_t i = 1; i < gap_scan_words && block + 1 < m_high_bits.data().size() && !word; ++i) {
+      word = words[++block];
+    }
+    unsigned long pos_in_word;
+    if (broadword::lsb(word, pos_in_word)) { return block * 64 + pos_in_word; }
+    return m_high_bits_d1.select<Tier>(m_high_bits, n + 1);
+  }
+
+  // Index of the first element with low part >= low in the h_rank-th
+  // bucket, which is closed by the zero at h_pos and whose last element is
+  // the (end - 1)-th. Short buckets are scanned backwards one element at a
+  // time; in longer ones the low parts, which are sorted within a bucket,
+  // are binary searched down to a window that is unpacked and compared all
+  // at once.
+  template <broadword::kernel_tier Tier>
+  inline uint64_t bucket_lower_bound(uint64_t h_rank, uint64_t h_pos, uint64_t end, uint64_t low) const {
+    uint64_t rank = end;
+    uint64_t pos  = h_pos;
+    for (uint64_t i = 0; i < bucket_linear_scan; ++i, --rank, --pos) {
+      if (rank == 0 || pos == 0 || !m_high_bits[pos - 1] || m_low_bits.get_bits((rank - 1) * m_l, m_l) < low) {
+        return rank;
+      }
+    }
+
+    uint64_t begin = end - bucket_size<Tier>(h_rank, h_pos);
+    end            = rank;
+    while (end - begin > bucket_window) {
+      uint64_t mid = begin + (end - begin) / 2;
+      if (m_low_bits.get_bits(mid * m_l, m_l) < low) {
+        begin = mid + 1;
+      } else {
+        end = mid;
+      }
+    }
+    uint64_t lows[bucket_window];
+    broadword::unpack_bits(m_low_bits.data().data(), begin * m_l, m_l, end - begin, lows);
+    return begin + broadword::count_less(lows, end - begin, low);
+  }
+
+  // Number of elements of the h_rank-th bucket, closed by the zero at
+  // h_pos: the ones right before h_pos are counted a word at a time, and
+  // buckets longer than a word are delimited with the previous zero
+  template <broadword::kernel_tier Tier>
+  inline uint64_t bucket_size(uint64_t h_rank, uint64_t h_pos) const {
+    uint64_t len  = std::min<uint64_t>(64, h_pos);
+    uint64_t zero = len ? ~(m_high_bits.get_bits(h_pos - len, len) << (64 - len)) : 1;
+    if (zero) { return std::min<uint64_t>(63 - broadword::msb(zero), len); }
+    if (!h_rank) { return h_pos; }
+    return h_pos - m_high_bits_d0.select<Tier>(m_high_bits, h_rank - 1) - 1;
+  }
+
   void build(elias_fano_builder &builder, bool with_rank_index) {
     m_size = builder.m_n;
     m_l    = builder.m_l;
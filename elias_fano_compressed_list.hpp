@@ -3,6 +3,7 @@
 #include <ranges>
 
 #include "elias_fano.hpp"
+#include "forward_enumerator.hpp"
 
 namespace succinct {
 
@@ -58,8 +59,44 @@ struct elias_fano_compressed_list {
   }
 
  private:
+  friend struct forward_enumerator<elias_fano_compressed_list>;
   elias_fano m_ef;
   bit_vector m_bits;
 };
 
+template <>
+struct forward_enumerator<elias_fano_compressed_list> {
+  typedef elias_fano_compressed_list::value_type value_type;
+
+  forward_enumerator(elias_fano_compressed_list const &c, size_t idx = 0)
+    : m_endpoints(c.m_ef, idx), m_pos(m_endpoints.next()), m_bits_enumerator(c.m_bits, m_pos) {}
+
+  value_type next() {
+    uint64_t end = m_endpoints.next();
+    uint64_t l   = end - m_pos;
+    m_pos        = end;
+    return ((uint64_t(1) << l) | m_bits_enumerator.take(l)) - 1;
+  }
+
+  // same as n calls to next(), with the endpoints decoded in blocks
+  void decode(value_type *out, size_t n) {
+    static const size_t block_size = 256;
+    uint64_t ends[block_size];
+    for (size_t begin = 0; begin < n; begin += block_size) {
+      size_t len = std::min(n - begin, size_t(block_size));
+      m_endpoints.decode_block(ends, len);
+      for (size_t i = 0; i < len; ++i) {
+        uint64_t l     = ends[i] - m_pos;
+        m_pos          = ends[i];
+        out[begin + i] = ((uint64_t(1) << l) | m_bits_enumerator.take(l)) - 1;
+      }
+    }
+  }
+
+ private:
+  elias_fano::select_enumerator m_endpoints;
+  uint64_t m_pos;
+  bit_vector::enumerator m_bits_enumerator;
+};
+
 }  // namespace succinct
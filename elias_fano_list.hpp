@@ -3,6 +3,7 @@
 #include <ranges>
 
 #include "elias_fano.hpp"
+#include "forward_enumerator.hpp"
 
 namespace succinct {
 
@@ -13,7 +14,7 @@ struct elias_fano_list {
 
   template <typename Range>
   elias_fano_list(Range const &ints) {
-    using iterator_t = std::ranges::const_iterator_t<Range>::type;
+    using iterator_t = std::ranges::iterator_t<Range const>;
 
     size_t s = 0;
     size_t n = 0;
@@ -45,7 +46,37 @@ struct elias_fano_list {
   }
 
  private:
+  friend struct forward_enumerator<elias_fano_list>;
   elias_fano m_ef;
 };
 
+template <>
+struct forward_enumerator<elias_fano_list> {
+  typedef elias_fano_list::value_type value_type;
+
+  forward_enumerator(elias_fano_list const &c, size_t idx = 0)
+    : m_prefix_sums(c.m_ef, idx < c.size() ? idx : 0), m_prev(idx && idx < c.size() ? c.m_ef.select(idx - 1) : 0) {}
+
+  value_type next() {
+    uint64_t cur = m_prefix_sums.next();
+    uint64_t val = cur - m_prev;
+    m_prev       = cur;
+    return val;
+  }
+
+  // same as n calls to next()
+  void decode(value_type *out, size_t n) {
+    m_prefix_sums.decode_block(out, n);
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t cur = out[i];
+      out[i]       = cur - m_prev;
+      m_prev       = cur;
+    }
+  }
+
+ private:
+  elias_fano::select_enumerator m_prefix_sums;
+  uint64_t m_prev;
+};
+
 }  // namespace succinct
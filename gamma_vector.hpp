@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <ranges>
 
 #include "broadword.hpp"
@@ -71,12 +72,25 @@ struct forward_enumerator<gamma_vector> {
 
   forward_enumerator(gamma_vector const &c, size_t idx = 0) : m_c(&c), m_idx(idx), m_pos(0) {
     if (idx < m_c->size()) {
-      m_pos                  = m_c->m_high_bits.select(idx);
-      m_high_bits_enumerator = bit_vector::unary_enumerator(m_c->m_high_bits.bits(), m_pos + 1);
-      m_low_bits_enumerator  = bit_vector::enumerator(m_c->m_low_bits, m_pos - m_idx);
+      m_pos = m_c->m_high_bits.select(idx);
+      reset_enumerators();
     }
   }
 
+  // Move forward by k values: short skips scan the unary codes of the high
+  // bits a word at a time, longer ones jump there with a select
+  void skip(size_t k) {
+    if (!k) return;
+    assert(m_idx + k <= m_c->size());
+    if (k < skip_select_threshold) {
+      m_pos = m_high_bits_enumerator.skip_no_move(k - 1);
+    } else {
+      m_pos = m_c->m_high_bits.select(m_idx + k);
+    }
+    m_idx += k;
+    reset_enumerators();
+  }
+
   value_type next() {
     assert(m_idx <= m_c->size());
     size_t next_pos = m_high_bits_enumerator.next();
@@ -88,7 +102,41 @@ struct forward_enumerator<gamma_vector> {
     return val;
   }
 
+  // Same as n calls to next(). The code boundaries are found with a bulk
+  // scan of the ones in the high bits rather than one unary code at a time.
+  void next_block(value_type *out, size_t n) {
+    if (!n) return;
+    assert(m_idx + n <= m_c->size());
+    static const size_t block_size = 256;
+    uint64_t ends[block_size];
+    uint64_t const *high_bits = m_c->m_high_bits.bits().data().data();
+    uint64_t low_pos          = m_pos - m_idx;
+    for (size_t begin = 0; begin < n; begin += block_size) {
+      size_t len = std::min(n - begin, size_t(block_size));
+      broadword::one_positions(high_bits, m_pos + 1, len, ends);
+      for (size_t i = 0; i < len; ++i) {
+        size_t l       = ends[i] - m_pos - 1;
+        m_pos          = ends[i];
+        uint64_t chunk = m_c->m_low_bits.get_bits(low_pos, l);
+        out[begin + i] = (chunk | (uint64_t(1) << (l))) - 1;
+        low_pos += l;
+      }
+    }
+    m_idx += n;
+    reset_enumerators();
+  }
+
  private:
+  static const size_t skip_select_threshold = 64;
+
+  // position the enumerators on the code of the m_idx-th value, which
+  // starts at the one in m_pos
+  void reset_enumerators() {
+    if (m_idx >= m_c->size()) return;
+    m_high_bits_enumerator = bit_vector::unary_enumerator(m_c->m_high_bits.bits(), m_pos + 1);
+    m_low_bits_enumerator  = bit_vector::enumerator(m_c->m_low_bits, m_pos - m_idx);
+  }
+
   gamma_vector const *m_c;
   size_t m_idx;
   size_t m_pos;
@@ -23,6 +23,20 @@
 #include <smmintrin.h>
 #endif
 
+// Runtime dispatch relies on GCC/Clang function multiversioning
+// attributes and __builtin_cpu_supports, silently disable it elsewhere
+#if SUCCINCT_USE_CPU_DISPATCH && \
+  !(SUCCINCT_USE_INTRINSICS && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__))
+#undef SUCCINCT_USE_CPU_DISPATCH
+#define SUCCINCT_USE_CPU_DISPATCH 0
+#endif
+
+#if SUCCINCT_USE_CPU_DISPATCH
+#include <cpuid.h>
+#include <immintrin.h>
+#define __INTRIN_TARGET(features) __attribute__((__target__(features)))
+#endif
+
 namespace succinct {
 namespace intrinsics {
 
@@ -88,5 +102,59 @@ __INTRIN_INLINE uint64_t popcount(uint64_t x) { return uint64_t(_mm_popcnt_u64(x
 
 #endif /* SUCCINCT_USE_POPCNT */
 
+#if SUCCINCT_USE_CPU_DISPATCH
+
+// __builtin_cpu_supports reads a table filled by libgcc at load time, so
+// these checks are just a load and a test; still, they are meant to be
+// done once per bulk kernel call or query, not per word
+
+inline bool cpu_has_popcnt() { return __builtin_cpu_supports("popcnt"); }
+
+inline bool cpu_has_bmi2() { return __builtin_cpu_supports("bmi2"); }
+
+// AMD CPUs before Zen 3 (family 19h), and the Zen-based Hygon ones,
+// implement PDEP/PEXT in microcode with a latency of hundreds of cycles,
+// so there BMI2 select is much slower than the broadword one
+inline bool cpu_has_fast_pdep() {
+  if (!cpu_has_bmi2()) { return false; }
+  unsigned int max_leaf, ebx, ecx, edx, eax;
+  if (!__get_cpuid(0, &max_leaf, &ebx, &ecx, &edx)) { return false; }
+  bool amd   = ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163;  // "AuthenticAMD"
+  bool hygon = ebx == 0x6f677948 && edx == 0x6e65476e && ecx == 0x656e6975;  // "HygonGenuine"
+  if (!amd && !hygon) { return true; }
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return false; }
+  unsigned int family = (eax >> 8) & 0xF;
+  if (family == 0xF) { family += (eax >> 20) & 0xFF; }
+  return family >= 0x19;
+}
+
+inline bool cpu_has_avx2() { return __builtin_cpu_supports("avx2"); }
+
+inline bool cpu_has_avx512_vpopcntdq() {
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+}
+
+inline bool cpu_has_avx512bw() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"); }
+
+// The following can only be inlined into functions compiled for the same
+// target
+
+// position of the k-th (0-based) one in x: deposit a single bit in the
+// k-th set position of x and count the zeros below it
+__INTRIN_TARGET("bmi,bmi2") inline uint64_t select_in_word_bmi2(uint64_t x, uint64_t k) {
+  return _tzcnt_u64(_pdep_u64(uint64_t(1) << k, x));
+}
+
+// Same as select_in_word_bmi2, for callers that are not compiled for BMI2
+// but only run on CPUs that have it: PDEP is emitted with inline asm, which
+// needs no target attribute
+__INTRIN_INLINE uint64_t select_in_word_pdep(uint64_t x, uint64_t k) {
+  uint64_t bit;
+  __asm__("pdep %2, %1, %0" : "=r"(bit) : "r"(uint64_t(1) << k), "rm"(x));
+  return uint64_t(__builtin_ctzll(bit));
+}
+
+#endif /* SUCCINCT_USE_CPU_DISPATCH */
+
 }  // namespace intrinsics
 }  // namespace succinct
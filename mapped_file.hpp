@@ -0,0 +1,176 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "mapper.hpp"
+#include "util.hpp"
+
+namespace succinct {
+namespace mapper {
+
+// Access pattern hints passed to madvise() on the whole mapping. random and
+// sequential are mutually exclusive; hugepage is best effort, as not all
+// kernels and filesystems support transparent huge pages on file mappings.
+struct advice_flags {
+  enum { random = 1, sequential = 2, willneed = 4, hugepage = 8 };
+};
+
+// How the pages of the mapping are faulted in before the first query:
+// none leaves it to the queries (and to willneed readahead, if requested),
+// parallel touches every page with num_threads threads before the
+// constructor returns, async does the same on a background thread and lets
+// the constructor return immediately.
+enum class warmup_mode { none, parallel, async };
+
+namespace detail {
+
+inline size_t page_size() {
+  static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+inline std::runtime_error system_error(std::string const &what, std::string const &filename) {
+  return std::runtime_error(what + " '" + filename + "': " + std::strerror(errno));
+}
+
+// Reads one byte per page in [begin, end), stopping early if stop is set
+inline void touch_pages(const char *begin, const char *end, std::atomic<bool> const &stop) {
+  size_t page = page_size();
+  char foo;
+  volatile char *bar = &foo;
+  for (const char *p = begin; p < end && !stop.load(std::memory_order_relaxed); p += page) { *bar = *p; }
+}
+
+}  // namespace detail
+
+// Owns a read-only mmap of a file produced by mapper::freeze and the T
+// mapped on top of it; the mapping lives as long as the mapped_file. The
+// file is mapped with bounds checking, so truncated or mismatched files
+// throw format_error.
+template <typename T>
+class mapped_file {
+ public:
+  mapped_file(const mapped_file &)            = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  mapped_file(const char *filename, uint64_t advice = 0, warmup_mode warmup = warmup_mode::none,
+              size_t num_threads = 0)
+    : m_data(0), m_size(0), m_stop_warmup(false) {
+    if ((advice & advice_flags::random) && (advice & advice_flags::sequential)) {
+      throw std::invalid_argument("advice_flags::random and advice_flags::sequential are mutually exclusive");
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) { throw detail::system_error("Unable to open file", filename); }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      auto error = detail::system_error("Unable to stat file", filename);
+      close(fd);
+      throw error;
+    }
+    m_size = size_t(st.st_size);
+    if (m_size < sizeof(uint64_t)) {
+      close(fd);
+      throw std::invalid_argument("File '" + std::string(filename) + "' is too small to be a frozen structure");
+    }
+    void *addr = mmap(0, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      auto error = detail::system_error("Unable to mmap file", filename);
+      close(fd);
+      throw error;
+    }
+    close(fd);  // the mapping keeps its own reference to the file
+    m_data = static_cast<const char *>(addr);
+
+    try {
+      apply_advice(advice, filename);
+      mapper::map(m_value, std::span<const char>(m_data, m_size), 0, &m_sections, filename);
+      // The warm-up stays inside the try: a failing parallel warm-up or a
+      // failed std::thread creation must not leak the mapping either
+      switch (warmup) {
+        case warmup_mode::none: break;
+        case warmup_mode::parallel: warm_up(num_threads); break;
+        case warmup_mode::async: m_warmup_thread = std::thread([this, num_threads] { warm_up(num_threads); }); break;
+      }
+    } catch (...) {
+      munmap(addr, m_size);
+      throw;
+    }
+  }
+
+  ~mapped_file() {
+    m_stop_warmup = true;
+    wait_warmup();
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+
+  // Blocks until an async warm-up has completed; returns immediately
+  // otherwise
+  void wait_warmup() {
+    if (m_warmup_thread.joinable()) { m_warmup_thread.join(); }
+  }
+
+  // Verifies the checksums of all the vector payloads, which are not
+  // checked while mapping; returns false if any of them is corrupt. Always
+  // true for files in the legacy format, which have no checksums.
+  bool verify_checksums() const { return verify_sections(m_sections); }
+
+  T const &get() const { return m_value; }
+
+  T const &operator*() const { return m_value; }
+
+  T const *operator->() const { return &m_value; }
+
+  const char *data() const { return m_data; }
+
+  size_t size() const { return m_size; }
+
+ protected:
+  void apply_advice(uint64_t advice, const char *filename) {
+    void *addr = const_cast<char *>(m_data);
+    if ((advice & advice_flags::random) && madvise(addr, m_size, MADV_RANDOM) < 0) {
+      throw detail::system_error("madvise(MADV_RANDOM) failed on", filename);
+    }
+    if ((advice & advice_flags::sequential) && madvise(addr, m_size, MADV_SEQUENTIAL) < 0) {
+      throw detail::system_error("madvise(MADV_SEQUENTIAL) failed on", filename);
+    }
+    if ((advice & advice_flags::willneed) && madvise(addr, m_size, MADV_WILLNEED) < 0) {
+      throw detail::system_error("madvise(MADV_WILLNEED) failed on", filename);
+    }
+#ifdef MADV_HUGEPAGE
+    // EINVAL only means that huge pages are not available for this mapping
+    if ((advice & advice_flags::hugepage) && madvise(addr, m_size, MADV_HUGEPAGE) < 0 && errno != EINVAL) {
+      throw detail::system_error("madvise(MADV_HUGEPAGE) failed on", filename);
+    }
+#endif
+  }
+
+  void warm_up(size_t num_threads) {
+    size_t pages = util::ceil_div(m_size, detail::page_size());
+    num_threads  = std::min<size_t>(util::resolve_num_threads(num_threads), pages);
+    util::parallel_ranges(pages, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+      detail::touch_pages(m_data + begin * detail::page_size(), m_data + std::min(end * detail::page_size(), m_size),
+                          m_stop_warmup);
+    });
+  }
+
+  const char *m_data;
+  size_t m_size;
+  T m_value;
+  std::vector<frozen_section> m_sections;
+  std::atomic<bool> m_stop_warmup;
+  std::thread m_warmup_thread;
+};
+
+}  // namespace mapper
+}  // namespace succinct
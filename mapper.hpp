@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "mappable_vector.hpp"
 
@@ -11,12 +16,23 @@ namespace succinct {
 namespace mapper {
 
 struct freeze_flags {
-  // enum {
-  // };
+  enum {
+    legacy_format = 1,  // unversioned, unaligned and unchecksummed format
+    page_aligned  = 2   // align vector payloads to pages instead of cache lines
+  };
 };
 
 struct map_flags {
-  enum { warmup = 1 };
+  enum {
+    warmup           = 1,
+    verify_checksums = 2  // verify every vector payload while mapping
+  };
+};
+
+// Thrown when mapping a buffer that is truncated, corrupt, or was frozen
+// from a different type
+struct format_error : std::runtime_error {
+  format_error(std::string const &what) : runtime_error(what) {}
 };
 
 struct size_node;
@@ -36,22 +52,185 @@ struct size_node {
 };
 
 namespace detail {
+
+// Frozen files start with a header made of these words, unless they were
+// written with freeze_flags::legacy_format, in which case the only header
+// is the freeze flags word. Each vector is then written as
+//
+//   [size][padding to the alignment][payload][padding to 8 bytes][checksum]
+//
+// with the checksum after the payload so that it can be computed while
+// streaming. Alignments are relative to the start of the frozen data.
+struct frozen_header {
+  static const uint64_t magic   = 0x54434E4943435553ULL;  // "SUCCINCT"
+  static const uint64_t version = 1;
+
+  uint64_t m_magic;
+  uint64_t m_version;
+  uint64_t m_flags;
+  uint64_t m_alignment;
+  uint64_t m_layout_hash;
+};
+
+static const uint64_t cache_line_alignment = 64;
+static const uint64_t page_alignment       = 4096;
+
+inline uint64_t padding(uint64_t offset, uint64_t alignment) { return (alignment - offset % alignment) % alignment; }
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Streaming 64-bit checksum of a byte sequence; the result does not depend
+// on how the sequence is split across calls to update()
+class checksum64 {
+ public:
+  checksum64() : m_hash(0x9E3779B97F4A7C15ULL), m_length(0), m_tail(0) {}
+
+  void update(const void *data, size_t n) {
+    const char *p = static_cast<const char *>(data);
+    m_length += n;
+    size_t tail_len = size_t((m_length - n) % 8);
+    if (tail_len) {
+      size_t take = std::min(n, 8 - tail_len);
+      std::memcpy(reinterpret_cast<char *>(&m_tail) + tail_len, p, take);
+      p += take;
+      n -= take;
+      if (tail_len + take < 8) { return; }
+      mix(m_tail);
+      m_tail = 0;
+    }
+    for (; n >= 8; p += 8, n -= 8) {
+      uint64_t word;
+      std::memcpy(&word, p, 8);
+      mix(word);
+    }
+    std::memcpy(&m_tail, p, n);
+  }
+
+  uint64_t digest() const {
+    uint64_t h = m_hash;
+    if (m_length % 8) { h = rotl64(h ^ (m_tail * k1), 31) * k2; }
+    h ^= m_length;
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+ private:
+  static const uint64_t k1 = 0x87C37B91114253D5ULL;
+  static const uint64_t k2 = 0x4CF5AD432745937FULL;
+
+  void mix(uint64_t word) { m_hash = rotl64(m_hash ^ (word * k1), 31) * k2; }
+
+  uint64_t m_hash;
+  uint64_t m_length;
+  uint64_t m_tail;
+};
+
+inline uint64_t checksum(const char *data, size_t n) {
+  checksum64 c;
+  c.update(data, n);
+  return c.digest();
+}
+
+// Hashes the shape of a type as seen by its map() method: the sequence of
+// POD fields and vector element sizes, and the nesting of sub-structures
+class layout_hash_visitor {
+ public:
+  layout_hash_visitor(const layout_hash_visitor &)            = delete;
+  layout_hash_visitor &operator=(const layout_hash_visitor &) = delete;
+
+  layout_hash_visitor() : m_hash(0xCBF29CE484222325ULL) {}
+
+  template <typename T>
+  layout_hash_visitor &operator()(T &val, const char * /* friendly_name */) {
+    if constexpr (std::is_standard_layout_v<T> && std::is_trivial_v<T>) {
+      mix('P');
+      mix(sizeof(T));
+    } else {
+      mix('{');
+      val.map(*this);
+      mix('}');
+    }
+    return *this;
+  }
+
+  template <typename T>
+  layout_hash_visitor &operator()(mappable_vector<T> & /* vec */, const char * /* friendly_name */) {
+    mix('V');
+    mix(sizeof(T));
+    return *this;
+  }
+
+  template <typename T>
+  layout_hash_visitor &versioned(T &val, const char *friendly_name) {
+    return (*this)(val, friendly_name);
+  }
+
+  uint64_t hash() const { return m_hash; }
+
+ private:
+  void mix(uint64_t x) { m_hash = (m_hash ^ x) * 0x100000001B3ULL; }
+
+  uint64_t m_hash;
+};
+
+template <typename T>
+uint64_t layout_hash(T &val) {
+  layout_hash_visitor hasher;
+  hasher(val, "");
+  return hasher.hash();
+}
+
+}  // namespace detail
+
+// A vector payload of a mapped structure, with the checksum recorded when
+// it was frozen; collected by map() so that payloads can be verified later
+// instead of while mapping
+struct frozen_section {
+  const char *data;
+  uint64_t size;
+  uint64_t checksum;
+
+  bool verify() const { return detail::checksum(data, size) == checksum; }
+};
+
+inline bool verify_sections(std::vector<frozen_section> const &sections) {
+  for (auto const &section : sections) {
+    if (!section.verify()) { return false; }
+  }
+  return true;
+}
+
+namespace detail {
+// true if val holds the same as a default-constructed T
+template <typename T>
+bool is_default(T &val);
+
 class freeze_visitor {
  public:
   freeze_visitor(const freeze_visitor &)            = delete;
   freeze_visitor &operator=(const freeze_visitor &) = delete;
 
-  freeze_visitor(std::ofstream &fout, uint64_t flags) : m_fout(fout), m_flags(flags), m_written(0) {
-    // Save freezing flags
-    m_fout.write(reinterpret_cast<const char *>(&m_flags), sizeof(m_flags));
-    m_written += sizeof(m_flags);
+  freeze_visitor(std::ostream &fout, uint64_t flags, uint64_t layout_hash)
+    : m_fout(fout), m_flags(flags), m_written(0), m_alignment(0) {
+    if (m_flags & freeze_flags::legacy_format) {
+      // Save freezing flags
+      write(&m_flags, sizeof(m_flags));
+    } else {
+      m_alignment = (m_flags & freeze_flags::page_aligned) ? page_alignment : cache_line_alignment;
+      frozen_header header = {frozen_header::magic, frozen_header::version, m_flags, m_alignment, layout_hash};
+      write(&header, sizeof(header));
+    }
   }
 
   template <typename T>
   freeze_visitor &operator()(T &val, const char * /* friendly_name */) {
     if constexpr (std::is_standard_layout_v<T> && std::is_trivial_v<T>) {
-      m_fout.write(reinterpret_cast<const char *>(&val), sizeof(T));
-      m_written += sizeof(T);
+      write(&val, sizeof(T));
     } else {
       val.map(*this);
     }
@@ -63,18 +242,45 @@ class freeze_visitor {
     (*this)(vec.m_size, "size");
 
     size_t n_bytes = static_cast<size_t>(vec.m_size * sizeof(T));
-    m_fout.write(reinterpret_cast<const char *>(vec.m_data), long(n_bytes));
-    m_written += n_bytes;
+    if (m_alignment) { write_padding(m_alignment); }
+    write(vec.m_data, n_bytes);
+    if (m_alignment) {
+      write_padding(sizeof(uint64_t));
+      uint64_t sum = checksum(reinterpret_cast<const char *>(vec.m_data), n_bytes);
+      write(&sum, sizeof(sum));
+    }
+
+    return *this;
+  }
 
+  // A field added after the legacy format, which has no room for it: it can
+  // only be left out of a legacy file if it holds its default value
+  template <typename T>
+  freeze_visitor &versioned(T &val, const char *friendly_name) {
+    if (m_alignment) { return (*this)(val, friendly_name); }
+    if (!is_default(val)) {
+      throw format_error(std::string("Cannot freeze ") + friendly_name + " in the legacy format");
+    }
     return *this;
   }
 
   size_t written() const { return m_written; }
 
  protected:
-  std::ofstream &m_fout;
+  void write(const void *data, size_t n) {
+    m_fout.write(reinterpret_cast<const char *>(data), long(n));
+    m_written += n;
+  }
+
+  void write_padding(uint64_t alignment) {
+    static const char zeros[page_alignment] = {};
+    write(zeros, padding(m_written, alignment));
+  }
+
+  std::ostream &m_fout;
   const uint64_t m_flags;
   uint64_t m_written;
+  uint64_t m_alignment;  // 0 for the legacy format
 };
 
 class map_visitor {
@@ -82,16 +288,37 @@ class map_visitor {
   map_visitor(const map_visitor &)            = delete;
   map_visitor &operator=(const map_visitor &) = delete;
 
-  map_visitor(const char *base_address, uint64_t flags) : m_base(base_address), m_cur(m_base), m_flags(flags) {
-    m_freeze_flags = *reinterpret_cast<const uint64_t *>(m_cur);
-    m_cur += sizeof(m_freeze_flags);
+  // end is one past the last readable byte, or null if the buffer is not
+  // bounds-checked
+  map_visitor(const char *base_address, const char *end, uint64_t flags, uint64_t layout_hash,
+              std::vector<frozen_section> *sections = nullptr)
+    : m_base(base_address), m_cur(m_base), m_end(end), m_flags(flags), m_alignment(0), m_sections(sections) {
+    uint64_t first_word;
+    std::memcpy(&first_word, take(sizeof(first_word)), sizeof(first_word));
+    if (first_word != frozen_header::magic) {
+      // legacy format, the first word is the freeze flags
+      m_freeze_flags = first_word;
+      return;
+    }
+
+    m_cur = m_base;
+    frozen_header header;
+    std::memcpy(&header, take(sizeof(header)), sizeof(header));
+    if (header.m_version != frozen_header::version) {
+      throw format_error("Unsupported frozen format version " + std::to_string(header.m_version));
+    }
+    if (header.m_alignment != cache_line_alignment && header.m_alignment != page_alignment) {
+      throw format_error("Invalid alignment " + std::to_string(header.m_alignment) + " in frozen header");
+    }
+    if (header.m_layout_hash != layout_hash) { throw format_error("Frozen data was written for a different type"); }
+    m_freeze_flags = header.m_flags;
+    m_alignment    = header.m_alignment;
   }
 
   template <typename T>
   map_visitor &operator()(T &val, const char * /* friendly_name */) {
     if constexpr (std::is_standard_layout_v<T> && std::is_trivial_v<T>) {
-      val = *reinterpret_cast<const T *>(m_cur);
-      m_cur += sizeof(T);
+      std::memcpy(&val, take(sizeof(T)), sizeof(T));
     } else {
       val.map(*this);
     }
@@ -99,12 +326,16 @@ class map_visitor {
   }
 
   template <typename T>
-  map_visitor &operator()(mappable_vector<T> &vec, const char * /* friendly_name */) {
+  map_visitor &operator()(mappable_vector<T> &vec, const char *friendly_name) {
     vec.clear();
-    (*this)(vec.m_size, "size");
+    uint64_t size;
+    (*this)(size, "size");
 
-    vec.m_data   = reinterpret_cast<const T *>(m_cur);
-    size_t bytes = vec.m_size * sizeof(T);
+    if (m_alignment) { take(padding(bytes_read(), m_alignment)); }
+    if (m_end && size > uint64_t(m_end - m_cur) / sizeof(T)) { throw truncated(); }
+    size_t bytes = size * sizeof(T);
+    vec.m_size   = size;
+    vec.m_data   = reinterpret_cast<const T *>(take(bytes));
 
     if (m_flags & map_flags::warmup) {
       T foo;
@@ -112,17 +343,53 @@ class map_visitor {
       for (size_t i = 0; i < vec.m_size; ++i) { *bar = vec.m_data[i]; }
     }
 
-    m_cur += bytes;
+    if (m_alignment) {
+      take(padding(bytes_read(), sizeof(uint64_t)));
+      frozen_section section = {reinterpret_cast<const char *>(vec.m_data), bytes, 0};
+      std::memcpy(&section.checksum, take(sizeof(uint64_t)), sizeof(uint64_t));
+      if ((m_flags & map_flags::verify_checksums) && !section.verify()) {
+        throw format_error(std::string("Checksum mismatch in ") + friendly_name);
+      }
+      if (m_sections) { m_sections->push_back(section); }
+    }
+
+    return *this;
+  }
+
+  // Legacy files predate the field, which is reset to its default
+  template <typename T>
+  map_visitor &versioned(T &val, const char *friendly_name) {
+    if (m_alignment) { return (*this)(val, friendly_name); }
+    if constexpr (std::is_standard_layout_v<T> && std::is_trivial_v<T>) {
+      val = T();
+    } else {
+      T().swap(val);
+    }
     return *this;
   }
 
   size_t bytes_read() const { return size_t(m_cur - m_base); }
 
  protected:
+  format_error truncated() const {
+    return format_error("Frozen data is truncated at offset " + std::to_string(bytes_read()));
+  }
+
+  // returns the current position and advances it by n bytes
+  const char *take(size_t n) {
+    if (m_end && n > size_t(m_end - m_cur)) { throw truncated(); }
+    const char *ret = m_cur;
+    m_cur += n;
+    return ret;
+  }
+
   const char *m_base;
   const char *m_cur;
+  const char *m_end;
   const uint64_t m_flags;
   uint64_t m_freeze_flags;
+  uint64_t m_alignment;  // 0 for the legacy format
+  std::vector<frozen_section> *m_sections;
 };
 
 class sizeof_visitor {
@@ -169,6 +436,11 @@ class sizeof_visitor {
     return *this;
   }
 
+  template <typename T>
+  sizeof_visitor &versioned(T &val, const char *friendly_name) {
+    return (*this)(val, friendly_name);
+  }
+
   size_t size() const { return m_size; }
 
   size_node_ptr size_tree() const {
@@ -188,11 +460,101 @@ class sizeof_visitor {
   size_node_ptr m_cur_size_node;
 };
 
+// Structures are compared by size, which tells apart the optional indices
+// that are empty by default
+template <typename T>
+bool is_default(T &val) {
+  T default_val{};
+  if constexpr (std::is_standard_layout_v<T> && std::is_trivial_v<T>) {
+    return std::memcmp(&val, &default_val, sizeof(T)) == 0;
+  } else {
+    sizeof_visitor val_size, default_size;
+    val_size(val, "");
+    default_size(default_val, "");
+    return val_size.size() == default_size.size();
+  }
+}
+
 }  // namespace detail
 
+// Writes a frozen structure piece by piece, so that structures produced in
+// order can be frozen without being materialized in memory first. The
+// pieces must be written in the order in which the map() method of the
+// frozen type visits them (whole sub-structures can be written with
+// operator()); the output is then identical to what freeze() writes.
+class stream_freezer : public detail::freeze_visitor {
+ public:
+  // Writes a vector of a known size, one chunk of elements at a time
+  template <typename T>
+  class vector_writer {
+   public:
+    vector_writer() : m_out(0), m_remaining(0) {}
+
+    void write(T const *data, size_t n) {
+      assert(n <= m_remaining);
+      m_remaining -= n;
+      size_t bytes = n * sizeof(T);
+      if (m_out->m_alignment) { m_checksum.update(data, bytes); }
+      m_out->write(data, bytes);
+    }
+
+    void push_back(T const &val) { write(&val, 1); }
+
+    void finish() {
+      if (m_remaining) { throw std::logic_error("vector_writer finished before all the elements were written"); }
+      if (m_out->m_alignment) {
+        m_out->write_padding(sizeof(uint64_t));
+        uint64_t sum = m_checksum.digest();
+        m_out->write(&sum, sizeof(sum));
+      }
+    }
+
+   private:
+    friend class stream_freezer;
+
+    vector_writer(stream_freezer &out, uint64_t size) : m_out(&out), m_remaining(size) {
+      out.write_pod(size);
+      if (out.m_alignment) { out.write_padding(out.m_alignment); }
+    }
+
+    stream_freezer *m_out;
+    uint64_t m_remaining;
+    detail::checksum64 m_checksum;
+  };
+
+  // layout_hash must be layout_hash_of<T>() for the T that will map the
+  // output
+  stream_freezer(std::ostream &fout, uint64_t layout_hash, uint64_t flags = 0)
+    : freeze_visitor(fout, flags, layout_hash) {}
+
+  template <typename T>
+  void write_pod(T const &val) {
+    static_assert(std::is_standard_layout_v<T> && std::is_trivial_v<T>);
+    write(&val, sizeof(T));
+  }
+
+  template <typename T>
+  vector_writer<T> begin_vector(uint64_t size) {
+    return vector_writer<T>(*this, size);
+  }
+
+  template <typename T>
+  void write_vector(std::vector<T> const &vec) {
+    vector_writer<T> writer = begin_vector<T>(vec.size());
+    writer.write(vec.data(), vec.size());
+    writer.finish();
+  }
+};
+
 template <typename T>
-size_t freeze(T &val, std::ofstream &fout, uint64_t flags = 0, const char *friendly_name = "<TOP>") {
-  detail::freeze_visitor freezer(fout, flags);
+uint64_t layout_hash_of() {
+  T val;
+  return detail::layout_hash(val);
+}
+
+template <typename T>
+size_t freeze(T &val, std::ostream &fout, uint64_t flags = 0, const char *friendly_name = "<TOP>") {
+  detail::freeze_visitor freezer(fout, flags, detail::layout_hash(val));
   freezer(val, friendly_name);
   return freezer.written();
 }
@@ -205,7 +567,19 @@ size_t freeze(T &val, const char *filename, uint64_t flags = 0, const char *frie
 
 template <typename T>
 size_t map(T &val, const char *base_address, uint64_t flags = 0, const char *friendly_name = "<TOP>") {
-  detail::map_visitor mapper(base_address, flags);
+  detail::map_visitor mapper(base_address, nullptr, flags, detail::layout_hash(val));
+  mapper(val, friendly_name);
+  return mapper.bytes_read();
+}
+
+// Bounds-checked version of map(): throws format_error instead of reading
+// past the end of buffer. If sections is not null, the vector payloads and
+// their checksums are appended to it, so that they can be verified later
+// with verify_sections().
+template <typename T>
+size_t map(T &val, std::span<const char> buffer, uint64_t flags = 0, std::vector<frozen_section> *sections = nullptr,
+           const char *friendly_name = "<TOP>") {
+  detail::map_visitor mapper(buffer.data(), buffer.data() + buffer.size(), flags, detail::layout_hash(val), sections);
   mapper(val, friendly_name);
   return mapper.bytes_read();
 }
@@ -1,35 +1,102 @@
 #pragma once
 
+#include <ranges>
+#include <stdexcept>
 #include <vector>
 
-#include <boost/range.hpp>
-
-#include "succinct/mappable_vector.hpp"
+#include "broadword.hpp"
+#include "mappable_vector.hpp"
+#include "mapper.hpp"
+#include "util.hpp"
 
 namespace succinct {
 
+// Array of 4-bit values, two per byte with the first one in the low nibble
 class nibble_vector {
  public:
-  nibble_vector() : m_size(0) {}
+  typedef uint8_t value_type;
 
-  template <class Range>
-  nibble_vector(Range const &from) : m_size(0) {
-    std::vector<uint8_t> nibbles;
-    bool parity      = 0;
-    uint8_t cur_byte = 0;
-    for (typename boost::range_const_iterator<Range>::type iter = boost::begin(from); iter != boost::end(from);
-         ++iter) {
-      assert(*iter < 16);
-      cur_byte |= *iter << (parity * 4);
-      parity = !parity;
-      if (!parity) {
-        nibbles.push_back(cur_byte);
-        cur_byte = 0;
+  class builder {
+   public:
+    builder(uint64_t n = 0) : m_size(0) { m_nibbles.reserve(util::ceil_div(n, 2)); }
+
+    void push_back(uint8_t val) {
+      assert(val < 16);
+      if (m_size % 2) {
+        m_nibbles.back() |= uint8_t(val << 4);
+      } else {
+        m_nibbles.push_back(val);
       }
       ++m_size;
     }
-    if (parity) { nibbles.push_back(cur_byte); }
-    m_nibbles.steal(nibbles);
+
+    uint64_t size() const { return m_size; }
+
+   private:
+    friend class nibble_vector;
+
+    size_t m_size;
+    std::vector<uint8_t> m_nibbles;
+  };
+
+  // Streaming counterpart of builder: the nibbles are written to out as
+  // they are appended, producing the same frozen data as freezing
+  // nibble_vector(&builder). The number of nibbles must be known in
+  // advance.
+  class stream_builder {
+   public:
+    stream_builder(mapper::stream_freezer &out, size_t size) : m_expected_size(size), m_size(0), m_cur_byte(0) {
+      out.write_pod(size);
+      m_writer = out.begin_vector<uint8_t>(util::ceil_div(size, 2));
+      m_buf.reserve(buf_size);
+    }
+
+    void push_back(uint8_t val) {
+      assert(val < 16);
+      assert(m_size < m_expected_size);
+      m_cur_byte |= uint8_t(val << ((m_size % 2) * 4));
+      if (++m_size % 2 == 0) { flush_byte(); }
+    }
+
+    void finish() {
+      if (m_size != m_expected_size) {
+        throw std::logic_error("nibble_vector::stream_builder got a wrong number of nibbles");
+      }
+      if (m_size % 2) { flush_byte(); }
+      m_writer.write(m_buf.data(), m_buf.size());
+      m_writer.finish();
+    }
+
+   private:
+    static const size_t buf_size = 4096;
+
+    void flush_byte() {
+      m_buf.push_back(m_cur_byte);
+      m_cur_byte = 0;
+      if (m_buf.size() == buf_size) {
+        m_writer.write(m_buf.data(), m_buf.size());
+        m_buf.clear();
+      }
+    }
+
+    mapper::stream_freezer::vector_writer<uint8_t> m_writer;
+    size_t m_expected_size;
+    size_t m_size;
+    uint8_t m_cur_byte;
+    std::vector<uint8_t> m_buf;
+  };
+
+  nibble_vector() : m_size(0) {}
+
+  nibble_vector(builder *from) : m_size(from->m_size) { m_nibbles.steal(from->m_nibbles); }
+
+  template <class Range>
+  nibble_vector(Range const &from) : m_size(0) {
+    using iterator_t = std::ranges::iterator_t<Range const>;
+
+    builder b;
+    for (iterator_t iter = std::begin(from); iter != std::end(from); ++iter) { b.push_back(uint8_t(*iter)); }
+    nibble_vector(&b).swap(*this);
   }
 
   template <typename Visitor>
@@ -44,9 +111,15 @@ class nibble_vector {
 
   size_t size() const { return m_size; }
 
-  uint8_t operator[](uint64_t pos) const {
+  value_type operator[](uint64_t pos) const {
     assert(pos < m_size);
-    return (m_nibbles[pos / 2] >> ((pos % 2) * 4)) & 0x0F;
+    return uint8_t((m_nibbles[pos / 2] >> ((pos % 2) * 4)) & 0x0F);
+  }
+
+  // out[i] = (*this)[begin + i] for i < n, unpacked in bulk
+  void get_range(uint64_t begin, size_t n, value_type *out) const {
+    assert(begin + n <= m_size);
+    broadword::unpack_nibbles(m_nibbles.data(), begin, n, out);
   }
 
  protected:
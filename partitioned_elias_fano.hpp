@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "elias_fano.hpp"
+
+namespace succinct {
+
+/**
+ * @brief Two-level Elias-Fano for clustered monotone sequences.
+ *
+ * The sequence is split in chunks of chunk_size elements, and each chunk is
+ * encoded relative to the last value of the previous chunk with whichever of
+ * these is smallest:
+ *
+ * - run:    the chunk is a run of consecutive integers, nothing is stored;
+ * - bitmap: a bitmap over the universe of the chunk (strictly increasing chunks);
+ * - ef:     an Elias-Fano encoding of the chunk with its own low bits width.
+ *
+ * The last value of every chunk and the offset of every chunk in m_data are
+ * kept in two top-level elias_fano sequences. The API is the same as the one
+ * of elias_fano.
+ */
+class partitioned_elias_fano {
+ public:
+  static const uint64_t chunk_size = 128;
+
+  partitioned_elias_fano() : m_size(0), m_num_ones(0) {}
+
+  struct builder {
+    /**
+     * @brief Construct a new partitioned elias fano builder object
+     *
+     * @param n : max universe, i.e., maximum value
+     * @param m : number of elements
+     */
+    builder(uint64_t n, uint64_t m) : m_n(n), m_m(m), m_pos(0), m_base(0) { m_chunk.reserve(chunk_size); }
+
+    inline void push_back(uint64_t i) {
+      assert((m_chunk.empty() || i >= m_chunk.back()) && i >= m_base && i <= m_n);
+      m_chunk.push_back(i);
+      ++m_pos;
+      assert(m_pos <= m_m);
+      if (m_chunk.size() == chunk_size || m_pos == m_m) { flush_chunk(); }
+    }
+
+    friend class partitioned_elias_fano;
+
+   private:
+    void flush_chunk() {
+      uint64_t k        = m_chunk.size();
+      uint64_t endpoint = m_chunk.back();
+      uint64_t u        = endpoint - m_base + 1;
+      auto repeated     = std::adjacent_find(m_chunk.begin(), m_chunk.end(), std::greater_equal<uint64_t>());
+      bool strict       = repeated == m_chunk.end();
+
+      m_offsets.push_back(m_data.size());
+      m_endpoints.push_back(endpoint);
+
+      uint64_t l = ef_low_bits(u, k);
+      if (strict && endpoint - m_chunk.front() == k - 1) {
+        m_data.append_bits(chunk_run, type_bits);
+      } else if (strict && u <= ef_bits(u, k)) {
+        m_data.append_bits(chunk_bitmap, type_bits);
+        uint64_t begin = m_data.size();
+        m_data.zero_extend(u);
+        for (uint64_t v : m_chunk) { m_data.set(begin + v - m_base, 1); }
+      } else {
+        m_data.append_bits(chunk_ef, type_bits);
+        if (l) {
+          for (uint64_t v : m_chunk) { m_data.append_bits((v - m_base) & ((uint64_t(1) << l) - 1), l); }
+        }
+        uint64_t begin = m_data.size();
+        m_data.zero_extend(((u - 1) >> l) + k);
+        for (uint64_t j = 0; j < k; ++j) { m_data.set(begin + ((m_chunk[j] - m_base) >> l) + j, 1); }
+      }
+
+      m_base = endpoint;
+      m_chunk.clear();
+    }
+
+    uint64_t m_n;
+    uint64_t m_m;
+    uint64_t m_pos;
+    uint64_t m_base;
+    std::vector<uint64_t> m_chunk;
+    std::vector<uint64_t> m_endpoints;
+    std::vector<uint64_t> m_offsets;
+    bit_vector_builder m_data;
+  };
+
+  partitioned_elias_fano(bit_vector_builder *bvb) {
+    bit_vector_builder::bits_type &bits = bvb->move_bits();
+    uint64_t n                          = bvb->size();
+    uint64_t m                          = broadword::popcount_words(bits.data(), bits.size());
+
+    bit_vector bv(bvb);
+    builder b(n, m);
+    uint64_t i = 0;
+    for (uint64_t pos = 0; pos < m; ++pos) {
+      i = bv.successor1(i);
+      b.push_back(i);
+      ++i;
+    }
+
+    build(b);
+  }
+
+  partitioned_elias_fano(builder *b) { build(*b); }
+
+  template <typename Visitor>
+  void map(Visitor &visit) {
+    visit(m_size, "m_size")(m_num_ones, "m_num_ones")(m_endpoints, "m_endpoints")(m_offsets, "m_offsets")(m_data,
+                                                                                                         "m_data");
+  }
+
+  void swap(partitioned_elias_fano &other) {
+    std::swap(other.m_size, m_size);
+    std::swap(other.m_num_ones, m_num_ones);
+    other.m_endpoints.swap(m_endpoints);
+    other.m_offsets.swap(m_offsets);
+    other.m_data.swap(m_data);
+  }
+
+  inline uint64_t size() const { return m_size; }
+
+  inline uint64_t num_ones() const { return m_num_ones; }
+
+  inline uint64_t num_chunks() const { return m_endpoints.num_ones(); }
+
+  // The queries dispatch once per call to the overloads templated on the
+  // kernel tier (see broadword::dispatch_query)
+  inline bool operator[](uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return get<Tier>(pos); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline bool get(uint64_t pos) const {
+    assert(pos <= size());
+    uint64_t r = rank<Tier>(pos);
+    return r < m_num_ones && select<Tier>(r) == pos;
+  }
+
+  inline uint64_t select(uint64_t n) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(n); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline uint64_t select(uint64_t n) const {
+    assert(n < m_num_ones);
+    chunk c    = get_chunk<Tier>(n / chunk_size);
+    uint64_t j = n % chunk_size;
+    switch (c.type) {
+      case chunk_run: return c.endpoint - (c.k - 1) + j;
+      case chunk_bitmap: return c.base + scan_select<Tier, true>(c.offset, c.offset + c.u, j) - c.offset;
+      default: {
+        uint64_t l         = ef_low_bits(c.u, c.k);
+        uint64_t high_base = c.offset + c.k * l;
+        uint64_t high      = scan_select<Tier, true>(high_base, high_base + ((c.u - 1) >> l) + c.k, j) - high_base - j;
+        return c.base + ((high << l) | m_data.get_bits(c.offset + j * l, l));
+      }
+    }
+  }
+
+  // number of elements smaller than pos
+  inline uint64_t rank(uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return rank<Tier>(pos); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline uint64_t rank(uint64_t pos) const {
+    assert(pos <= m_size);
+    if (!m_num_ones || pos > m_endpoints.size()) { return m_num_ones; }
+
+    // the chunks ending before pos are entirely smaller than pos
+    uint64_t c_idx = m_endpoints.rank<Tier>(pos);
+    if (c_idx == num_chunks()) { return m_num_ones; }
+    chunk c    = get_chunk<Tier>(c_idx);
+    uint64_t x = pos - c.base;  // can be 0 only in the first chunk
+    uint64_t r = c_idx * chunk_size;
+
+    switch (c.type) {
+      case chunk_run: {
+        uint64_t first = c.endpoint - (c.k - 1);
+        return r + (pos <= first ? 0 : pos - first);
+      }
+      case chunk_bitmap: return r + scan_rank<Tier>(c.offset, c.offset + x);
+      default: {
+        uint64_t l         = ef_low_bits(c.u, c.k);
+        uint64_t high_base = c.offset + c.k * l;
+        uint64_t high_end  = high_base + ((c.u - 1) >> l) + c.k;
+        uint64_t h         = x >> l;
+        uint64_t low       = x & ((uint64_t(1) << l) - 1);
+        // the ones before the h-th zero are the elements with high part <= h
+        uint64_t h_pos     = scan_select<Tier, false>(high_base, high_end, h);
+        uint64_t cur_rank  = h_pos - high_base - h;
+        while (cur_rank > 0 && h_pos > high_base && m_data[h_pos - 1] &&
+               m_data.get_bits(c.offset + (cur_rank - 1) * l, l) >= low) {
+          --cur_rank;
+          --h_pos;
+        }
+        return r + cur_rank;
+      }
+    }
+  }
+
+  inline uint64_t predecessor1(uint64_t pos) const {
+    return broadword::dispatch_query(
+      [&]<broadword::kernel_tier Tier>() { return select<Tier>(rank<Tier>(pos + 1) - 1); });
+  }
+
+  inline uint64_t successor1(uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(rank<Tier>(pos)); });
+  }
+
+  // Equivalent to select(n) - select(n - 1) (and select(0) for n = 0)
+  inline uint64_t delta(uint64_t n) const {
+    return broadword::dispatch_query(
+      [&]<broadword::kernel_tier Tier>() { return n ? select<Tier>(n) - select<Tier>(n - 1) : select<Tier>(n); });
+  }
+
+  // Decodes a chunk at a time, reading the top-level sequences with their
+  // own enumerators, so a scan does no select at all
+  struct select_enumerator {
+    select_enumerator(partitioned_elias_fano const &pef, uint64_t i)
+      : m_pef(&pef),
+        m_chunk(i / chunk_size),
+        m_pos(i % chunk_size),
+        m_chunk_len(0),
+        m_base(0),
+        m_endpoints(pef.m_endpoints, m_chunk < pef.num_chunks() ? m_chunk : 0),
+        m_offsets(pef.m_offsets, m_chunk < pef.num_chunks() ? m_chunk : 0) {
+      if (m_chunk < m_pef->num_chunks()) {
+        if (m_chunk) { m_base = m_pef->m_endpoints.select(m_chunk - 1); }
+        decode_next_chunk();
+      }
+    }
+
+    uint64_t next() {
+      if (m_pos == m_chunk_len) {
+        ++m_chunk;
+        decode_next_chunk();
+        m_pos = 0;
+      }
+      return m_buf[m_pos++];
+    }
+
+   private:
+    void decode_next_chunk() {
+      uint64_t endpoint = m_endpoints.next();
+      m_chunk_len       = m_pef->decode_chunk(m_pef->make_chunk(m_chunk, m_base, endpoint, m_offsets.next()), m_buf);
+      m_base            = endpoint;
+    }
+
+    partitioned_elias_fano const *m_pef;
+    uint64_t m_chunk;
+    uint64_t m_pos;
+    uint64_t m_chunk_len;
+    uint64_t m_base;
+    elias_fano::select_enumerator m_endpoints;
+    elias_fano::select_enumerator m_offsets;
+    uint64_t m_buf[chunk_size];
+  };
+
+ protected:
+  static const uint64_t type_bits    = 2;
+  static const uint64_t chunk_ef     = 0;
+  static const uint64_t chunk_bitmap = 1;
+  static const uint64_t chunk_run    = 2;
+
+  struct chunk {
+    uint64_t base;      // the chunk values are base + local value
+    uint64_t endpoint;  // last value of the chunk
+    uint64_t u;         // universe of the local values, endpoint - base + 1
+    uint64_t k;         // number of values
+    uint64_t type;
+    uint64_t offset;    // position in m_data of the chunk payload, after the type
+  };
+
+  static uint64_t ef_low_bits(uint64_t u, uint64_t k) { return (u / k) ? broadword::msb(u / k) : 0; }
+
+  static uint64_t ef_bits(uint64_t u, uint64_t k) {
+    uint64_t l = ef_low_bits(u, k);
+    return k * l + ((u - 1) >> l) + k;
+  }
+
+  void build(builder &b) {
+    assert(b.m_pos == b.m_m);
+    m_size     = b.m_n;
+    m_num_ones = b.m_m;
+
+    elias_fano::elias_fano_builder endpoints(b.m_endpoints.empty() ? 0 : b.m_endpoints.back(), b.m_endpoints.size());
+    for (uint64_t e : b.m_endpoints) { endpoints.push_back(e); }
+    elias_fano(&endpoints).swap(m_endpoints);
+
+    elias_fano::elias_fano_builder offsets(b.m_data.size(), b.m_offsets.size());
+    for (uint64_t o : b.m_offsets) { offsets.push_back(o); }
+    elias_fano(&offsets, false).swap(m_offsets);
+
+    bit_vector(&b.m_data).swap(m_data);
+  }
+
+  chunk make_chunk(uint64_t c_idx, uint64_t base, uint64_t endpoint, uint64_t offset) const {
+    chunk c;
+    c.base     = base;
+    c.endpoint = endpoint;
+    c.u        = endpoint - base + 1;
+    c.k        = std::min(uint64_t(chunk_size), m_num_ones - c_idx * chunk_size);
+    c.type     = m_data.get_bits(offset, type_bits);
+    c.offset   = offset + type_bits;
+    return c;
+  }
+
+  template <broadword::kernel_tier Tier>
+  chunk get_chunk(uint64_t c_idx) const {
+    if (!c_idx) { return make_chunk(c_idx, 0, m_endpoints.select<Tier>(0), m_offsets.select<Tier>(0)); }
+    auto [base, endpoint] = m_endpoints.select_range<Tier>(c_idx - 1);
+    return make_chunk(c_idx, base, endpoint, m_offsets.select<Tier>(c_idx));
+  }
+
+  // Position of the idx-th one (or zero, if !Bit) of m_data in [begin, end),
+  // or end if there are not enough of them
+  template <broadword::kernel_tier Tier, bool Bit>
+  uint64_t scan_select(uint64_t begin, uint64_t end, uint64_t idx) const {
+    for (uint64_t pos = begin; pos < end; pos += 64) {
+      uint64_t len  = std::min<uint64_t>(64, end - pos);
+      uint64_t word = m_data.get_bits(pos, len);
+      if (!Bit) { word = ~word & (uint64_t(-1) >> (64 - len)); }
+      uint64_t cnt = broadword::popcount<Tier>(word);
+      if (idx < cnt) { return pos + broadword::select_in_word<Tier>(word, idx); }
+      idx -= cnt;
+    }
+    return end;
+  }
+
+  // number of ones of m_data in [begin, end)
+  template <broadword::kernel_tier Tier>
+  uint64_t scan_rank(uint64_t begin, uint64_t end) const {
+    uint64_t ret = 0;
+    for (uint64_t pos = begin; pos < end; pos += 64) {
+      ret += broadword::popcount<Tier>(m_data.get_bits(pos, std::min<uint64_t>(64, end - pos)));
+    }
+    return ret;
+  }
+
+  // writes the values of the chunk to out and returns their number
+  uint64_t decode_chunk(chunk const &c, uint64_t *out) const {
+    switch (c.type) {
+      case chunk_run: {
+        uint64_t first = c.endpoint - (c.k - 1);
+        for (uint64_t j = 0; j < c.k; ++j) { out[j] = first + j; }
+        break;
+      }
+      case chunk_bitmap: {
+        uint64_t j = 0;
+        for (uint64_t pos = c.offset; pos < c.offset + c.u; pos += 64) {
+          uint64_t word = m_data.get_bits(pos, std::min<uint64_t>(64, c.offset + c.u - pos));
+          unsigned long bit;
+          while (broadword::lsb(word, bit)) {
+            out[j++] = c.base + pos - c.offset + bit;
+            word &= word - 1;
+          }
+        }
+        assert(j == c.k);
+        break;
+      }
+      default: {
+        uint64_t l            = ef_low_bits(c.u, c.k);
+        uint64_t high_base    = c.offset + c.k * l;
+        uint64_t const *words = m_data.data().data();
+        uint64_t low[chunk_size];
+        broadword::unpack_bits(words, c.offset, l, c.k, low);
+        broadword::one_positions(words, high_base, c.k, out);
+        for (uint64_t j = 0; j < c.k; ++j) { out[j] = c.base + (((out[j] - high_base - j) << l) | low[j]); }
+        break;
+      }
+    }
+    return c.k;
+  }
+
+  uint64_t m_size;
+  uint64_t m_num_ones;
+  elias_fano m_endpoints;
+  elias_fano m_offsets;
+  bit_vector m_data;
+};
+
+}  // namespace succinct
@@ -0,0 +1,65 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bp_tree.hpp"
+#include "perftest_common.hpp"
+#include "test_bp_vector_common.hpp"
+
+// Average time per operation on random nodes of a random tree, in
+// microseconds
+template <typename Op>
+double time_op(succinct::bp_tree const &tree, std::vector<uint64_t> const &nodes, Op op) {
+  volatile uint64_t foo = 0;  // prevent optimization
+  uint64_t sum          = 0;
+  double elapsed;
+  SUCCINCT_TIMEIT(elapsed) {
+    for (size_t i = 0; i + 1 < nodes.size(); ++i) { sum += op(tree, nodes[i], nodes[i + 1]); }
+  }
+  foo = sum;
+  (void)foo;
+  return elapsed / double(nodes.size() - 1);
+}
+
+void bp_tree_benchmark(size_t sample_size) {
+  std::cout << "SUCCINCT_BP_TREE\n";
+  std::cout << "log_size\tparent_us\tnext_sibling_us\tlast_child_us\tdepth_us\tsubtree_size_us\tlca_us\t"
+               "level_ancestor_us\tpostorder_rank_us\n";
+
+  for (size_t ln = 12; ln <= 26; ln += 2) {
+    std::vector<char> v;
+    succinct::random_bp(v, size_t(1) << ln);
+    succinct::bp_tree tree(v);
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> dist(0, tree.num_nodes() - 1);
+    std::vector<uint64_t> nodes(sample_size);
+    for (auto &x : nodes) { x = tree.preorder_select(dist(rng)); }
+
+    using tree_t = succinct::bp_tree const &;
+
+    double parent_us       = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.parent(x); });
+    double next_sibling_us = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.next_sibling(x); });
+    double last_child_us   = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.last_child(x); });
+    double depth_us        = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.depth(x); });
+    double subtree_size_us = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.subtree_size(x); });
+    double lca_us          = time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t y) { return t.lca(x, y); });
+    double level_ancestor_us =
+      time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.level_ancestor(x, t.depth(x) / 2); });
+    double postorder_rank_us =
+      time_op(tree, nodes, [](tree_t t, uint64_t x, uint64_t) { return t.postorder_rank(x); });
+
+    std::cout << ln << "\t" << parent_us << "\t" << next_sibling_us << "\t" << last_child_us << "\t" << depth_us
+              << "\t" << subtree_size_us << "\t" << lca_us << "\t" << level_ancestor_us << "\t" << postorder_rank_us
+              << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t sample_size = 1000000;
+  if (argc == 2) { sample_size = std::stoull(argv[1]); }
+
+  bp_tree_benchmark(sample_size);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <random>
@@ -26,9 +27,9 @@ struct succinct_bp_vector_traits {
   }
 };
 
-// Measure average time per find_close operation
+// Measure average time per find_close operation with the given word kernel
 template <typename BpVector>
-double time_visit(const BpVector &bp, size_t sample_size = 1000000) {
+double time_visit(const BpVector &bp, succinct::bp_vector::word_kernel kernel, size_t sample_size = 1000000) {
   std::vector<char> random_bits;
   random_bits.reserve(sample_size);
 
@@ -48,7 +49,7 @@ double time_visit(const BpVector &bp, size_t sample_size = 1000000) {
 
       while (bp[cur_node] && steps_done < sample_size) {
         if (random_bits[steps_done++]) {
-          size_t next_node = bp.find_close(cur_node);
+          size_t next_node = bp.find_close(cur_node, kernel);
           cur_node         = next_node + 1;
           ++find_close_performed;
         } else {
@@ -71,34 +72,161 @@ void build_random_binary_tree(typename BpVectorTraits::bp_vector_type &bp, size_
   BpVectorTraits::build(builder, bp);
 }
 
-// Benchmark BP vector operations
+// Benchmark BP vector operations, with each word kernel the CPU supports
 template <typename BpVectorTraits>
 void bp_benchmark(size_t runs) {
   static const size_t sample_size = 10000000;
+  using word_kernel               = succinct::bp_vector::word_kernel;
 
   std::cout << BpVectorTraits::log_header() << "\n";
-  std::cout << "log_height\tfind_close_us\tbits_per_bp\n";
+  std::cout << "log_height\tword_kernel\tfind_close_us\tbits_per_bp\n";
+
+  std::vector<std::pair<word_kernel, std::string>> kernels = {
+    {word_kernel::tables, "tables"}, {word_kernel::broadword, "broadword"}, {word_kernel::avx512, "avx512"}};
 
   for (size_t ln = 10; ln <= 28; ln += 2) {
-    size_t n           = 1 << ln;
-    double elapsed     = 0;
+    size_t n = 1 << ln;
+    std::vector<double> elapsed(kernels.size());
     double bits_per_bp = 0;
 
     for (size_t run = 0; run < runs; ++run) {
       typename BpVectorTraits::bp_vector_type bp;
       build_random_binary_tree<BpVectorTraits>(bp, n);
-      elapsed += time_visit(bp, sample_size);
+      for (size_t k = 0; k < kernels.size(); ++k) {
+        if (!succinct::bp_vector::word_kernel_supported(kernels[k].first)) continue;
+        elapsed[k] += time_visit(bp, kernels[k].first, sample_size);
+      }
       bits_per_bp += BpVectorTraits::bits_per_bp(bp);
     }
 
-    std::cout << ln << "\t" << elapsed / static_cast<double>(runs) << "\t" << bits_per_bp / static_cast<double>(runs)
+    for (size_t k = 0; k < kernels.size(); ++k) {
+      if (!succinct::bp_vector::word_kernel_supported(kernels[k].first)) continue;
+      std::cout << ln << "\t" << kernels[k].second << "\t" << elapsed[k] / static_cast<double>(runs) << "\t"
+                << bits_per_bp / static_cast<double>(runs) << "\n";
+    }
+  }
+}
+
+// Average time per find_close on random open parentheses, one at a time
+// and through find_close_batch
+void batch_benchmark(size_t runs) {
+  static const size_t sample_size = 1000000;
+
+  std::cout << "SUCCINCT_BATCH\n";
+  std::cout << "log_height\tfind_close_us\tfind_close_batch_us\n";
+
+  for (size_t ln = 10; ln <= 28; ln += 2) {
+    succinct::bit_vector_builder builder;
+    succinct::random_binary_tree(builder, size_t(1) << ln);
+    succinct::bp_vector bp(&builder, true, false);
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> dist(0, bp.num_ones() - 1);
+    std::vector<uint64_t> opens(sample_size);
+    for (auto &x : opens) { x = bp.select(dist(rng)); }
+    std::vector<uint64_t> single(sample_size), batch(sample_size);
+
+    double single_us = 0, batch_us = 0;
+    for (size_t run = 0; run < runs; ++run) {
+      double elapsed;
+      SUCCINCT_TIMEIT(elapsed) {
+        for (size_t i = 0; i < sample_size; ++i) { single[i] = bp.find_close(opens[i]); }
+      }
+      single_us += elapsed;
+
+      SUCCINCT_TIMEIT(elapsed) { bp.find_close_batch(opens, batch); }
+      batch_us += elapsed;
+    }
+
+    if (single != batch) {
+      std::cerr << "Mismatching find_close_batch results" << std::endl;
+      std::terminate();
+    }
+
+    std::cout << ln << "\t" << single_us / double(runs * sample_size) << "\t" << batch_us / double(runs * sample_size)
               << "\n";
   }
 }
 
+// Average time per operation on random_bp sequences with each min tree
+// layout, for sizes up to 2^30 (about 10^9) bits. Besides random opens,
+// find_close and find_open are timed on parentheses whose match is at
+// least far_distance bits away, so that every search goes through the min
+// tree.
+void layout_benchmark(size_t runs) {
+  static const size_t sample_size    = 100000;
+  static const uint64_t far_distance = 1 << 16;
+  using layout                       = succinct::bp_vector::min_tree_layout;
+
+  std::cout << "SUCCINCT_MIN_TREE_LAYOUT\n";
+  std::cout << "log_size\tlayout\tfind_close_us\tfar_find_close_us\tfar_find_open_us\tfar_find_close_batch_us\t"
+               "excess_rmq_us\n";
+
+  for (size_t ln = 24; ln <= 30; ln += 2) {
+    for (auto [l, name] : {std::pair{layout::binary, "binary"}, std::pair{layout::btree, "btree"}}) {
+      succinct::bit_vector_builder builder;
+      srand(42);  // same sequence for both layouts
+      succinct::random_bp(builder, size_t(1) << ln);
+      succinct::bp_vector bp(&builder, true, true, l);
+
+      std::mt19937_64 rng(42);
+      std::uniform_int_distribution<uint64_t> open_dist(0, bp.num_ones() - 1);
+      std::vector<uint64_t> opens(sample_size), far_opens, far_closes, ends(sample_size), out(sample_size);
+      for (size_t i = 0; i < sample_size; ++i) {
+        opens[i] = bp.select(open_dist(rng));
+        ends[i]  = std::min(bp.size() - 1, opens[i] + (rng() % (uint64_t(1) << (rng() % ln))));
+      }
+      while (far_opens.size() < sample_size) {
+        uint64_t open  = bp.select(open_dist(rng));
+        uint64_t close = bp.find_close(open);
+        if (close - open < far_distance) { continue; }
+        far_opens.push_back(open);
+        far_closes.push_back(close);
+      }
+      std::shuffle(far_closes.begin(), far_closes.end(), rng);
+
+      double find_close_us = 0, far_find_close_us = 0, far_find_open_us = 0, batch_us = 0, rmq_us = 0;
+      volatile uint64_t foo = 0;  // prevent optimization
+      for (size_t run = 0; run < runs; ++run) {
+        double elapsed;
+        SUCCINCT_TIMEIT(elapsed) {
+          for (size_t i = 0; i < sample_size; ++i) { out[i] = bp.find_close(opens[i]); }
+        }
+        find_close_us += elapsed;
+
+        SUCCINCT_TIMEIT(elapsed) {
+          for (size_t i = 0; i < sample_size; ++i) { out[i] = bp.find_close(far_opens[i]); }
+        }
+        far_find_close_us += elapsed;
+
+        SUCCINCT_TIMEIT(elapsed) {
+          for (size_t i = 0; i < sample_size; ++i) { out[i] = bp.find_open(far_closes[i]); }
+        }
+        far_find_open_us += elapsed;
+
+        SUCCINCT_TIMEIT(elapsed) { bp.find_close_batch(far_opens, out); }
+        batch_us += elapsed;
+
+        SUCCINCT_TIMEIT(elapsed) {
+          for (size_t i = 0; i < sample_size; ++i) { out[i] = bp.excess_rmq(opens[i], ends[i]); }
+        }
+        rmq_us += elapsed;
+        foo = out[0];
+      }
+      (void)foo;
+
+      double ops = double(runs * sample_size);
+      std::cout << ln << "\t" << name << "\t" << find_close_us / ops << "\t" << far_find_close_us / ops << "\t"
+                << far_find_open_us / ops << "\t" << batch_us / ops << "\t" << rmq_us / ops << "\n";
+    }
+  }
+}
+
 int main(int argc, char **argv) {
   size_t runs = 1;
   if (argc == 2) { runs = std::stoull(argv[1]); }
 
   bp_benchmark<succinct_bp_vector_traits>(runs);
+  batch_benchmark(runs);
+  layout_benchmark(runs);
 }
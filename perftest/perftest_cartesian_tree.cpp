@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <random>
 #include <utility>
@@ -10,8 +12,9 @@
 #include "test_bp_vector_common.hpp"
 #include "util.hpp"
 
-// Compute average RMQ time for a Cartesian tree
-double time_avg_rmq(const succinct::cartesian_tree &tree, size_t sample_size = 1000000) {
+// Compute average RMQ time for a Cartesian tree, on ranges of length at
+// most max_range if given
+double time_avg_rmq(const succinct::cartesian_tree &tree, size_t sample_size = 1000000, uint64_t max_range = 0) {
   using range_pair = std::pair<uint64_t, uint64_t>;
   std::vector<range_pair> pairs_sample;
   pairs_sample.reserve(sample_size);
@@ -22,7 +25,7 @@ double time_avg_rmq(const succinct::cartesian_tree &tree, size_t sample_size = 1
 
   for (size_t i = 0; i < sample_size; ++i) {
     uint64_t a = dist(rng);
-    uint64_t b = a + (dist(rng) % (tree.size() - a));
+    uint64_t b = a + (dist(rng) % (max_range ? std::min(max_range, tree.size() - a) : tree.size() - a));
     pairs_sample.emplace_back(a, b);
   }
 
@@ -67,9 +70,56 @@ void rmq_benchmark(size_t runs) {
   }
 }
 
+// RMQ on ranges shorter than short_range_size, with and without the short
+// range index
+void short_rmq_benchmark() {
+  using rmq_mode                  = succinct::cartesian_tree::rmq_mode;
+  static const size_t sample_size = 10000000;
+  uint64_t max_range              = succinct::cartesian_tree::short_range_size;
+
+  std::cout << "SUCCINCT_CARTESIAN_TREE_SHORT_RMQ\n";
+  std::cout << "log_height\tsuccinct_us\thybrid_us\n";
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint64_t> value_dist(0, 1023);
+
+  for (size_t ln = 10; ln <= 26; ln += 2) {
+    std::vector<uint64_t> v(size_t(1) << ln);
+    for (auto &val : v) { val = value_dist(rng); }
+
+    succinct::cartesian_tree succinct_tree(v, rmq_mode::succinct);
+    succinct::cartesian_tree hybrid_tree(v, rmq_mode::hybrid);
+    std::cout << ln << "\t" << time_avg_rmq(succinct_tree, sample_size, max_range) << "\t"
+              << time_avg_rmq(hybrid_tree, sample_size, max_range) << "\n";
+  }
+}
+
+// Time to build the Cartesian tree of 2^log_size random values, with an
+// increasing number of threads
+void build_benchmark(size_t log_size) {
+  size_t n = size_t(1) << log_size;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint64_t> value_dist(0, 1023);
+  std::vector<uint64_t> v(n);
+  for (auto &val : v) { val = value_dist(rng); }
+
+  std::cout << "SUCCINCT_CARTESIAN_TREE_BUILD\n";
+  std::cout << "log_size\tthreads\tbuild_ms\n";
+  size_t max_threads = succinct::util::resolve_num_threads(0);
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    succinct::cartesian_tree tree;
+    double elapsed;
+    SUCCINCT_TIMEIT(elapsed) { succinct::cartesian_tree(v, std::less<uint64_t>(), threads).swap(tree); }
+    std::cout << log_size << "\t" << threads << "\t" << elapsed / 1000 << "\n";
+  }
+}
+
 int main(int argc, char **argv) {
   size_t runs = 1;
   if (argc == 2) { runs = std::stoull(argv[1]); }
 
   rmq_benchmark(runs);
+  short_rmq_benchmark();
+  build_benchmark(26);
 }
@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compact_vector.hpp"
+#include "perftest_common.hpp"
+
+// Time per value of a scan of a compact_vector with operator[], with the
+// forward_enumerator and with bulk unpacking, and of random accesses
+void compact_vector_benchmark(size_t n) {
+  static const size_t block_size  = 128;
+  static const size_t sample_size = 1000000;
+
+  std::cout << "SUCCINCT_COMPACT_VECTOR\n";
+  std::cout << "width\tsize\trandom_access_us\tscan_access_us\tscan_next_us\tscan_decode_us\n";
+
+  for (uint64_t width : {1, 4, 7, 13, 21, 32, 47, 64}) {
+    std::mt19937_64 rng(42);
+    uint64_t mask = width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+    succinct::compact_vector::builder builder(width, n);
+    for (size_t i = 0; i < n; ++i) { builder.push_back(rng() & mask); }
+    succinct::compact_vector cv(&builder);
+
+    std::uniform_int_distribution<uint64_t> idx_dist(0, n - 1);
+    std::vector<uint64_t> indices(sample_size);
+    for (auto &i : indices) { i = idx_dist(rng); }
+
+    auto time_per_value = [](size_t count, auto fn) {
+      volatile uint64_t foo = 0;  // prevent optimization
+      double elapsed;
+      SUCCINCT_TIMEIT(elapsed) { foo = fn(); }
+      (void)foo;  // silence warning
+      return elapsed / static_cast<double>(count);
+    };
+
+    double random_us = time_per_value(sample_size, [&] {
+      uint64_t acc = 0;
+      for (auto i : indices) { acc ^= cv[i]; }
+      return acc;
+    });
+
+    double access_us = time_per_value(n, [&] {
+      uint64_t acc = 0;
+      for (size_t i = 0; i < n; ++i) { acc += cv[i]; }
+      return acc;
+    });
+
+    double next_us = time_per_value(n, [&] {
+      uint64_t acc = 0;
+      succinct::forward_enumerator<succinct::compact_vector> e(cv);
+      for (size_t i = 0; i < n; ++i) { acc += e.next(); }
+      return acc;
+    });
+
+    double decode_us = time_per_value(n, [&] {
+      uint64_t acc = 0;
+      uint64_t buf[block_size];
+      succinct::forward_enumerator<succinct::compact_vector> e(cv);
+      for (size_t i = 0; i < n; i += block_size) {
+        size_t len = std::min(n - i, size_t(block_size));
+        e.decode(buf, len);
+        for (size_t j = 0; j < len; ++j) { acc += buf[j]; }
+      }
+      return acc;
+    });
+
+    std::cout << width << "\t" << n << "\t" << random_us << "\t" << access_us << "\t" << next_us << "\t" << decode_us
+              << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 10000000;
+  if (argc == 2) { n = std::stoull(argv[1]); }
+
+  compact_vector_benchmark(n);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
@@ -9,6 +10,7 @@
 
 #include "elias_fano.hpp"
 #include "mapper.hpp"
+#include "partitioned_elias_fano.hpp"
 #include "perftest_common.hpp"
 #include "util.hpp"
 
@@ -79,6 +81,40 @@ void ef_enumeration_benchmark(uint64_t m, uint8_t bits) {
   std::cerr << "Elapsed: " << elapsed / 1000 << " msec\n" << double(m) / elapsed << " Mcodes/s" << std::endl;
 }
 
+// Scan of the whole sequence one next() at a time and in blocks of
+// decode_block, on the same elias_fano
+void ef_decode_block_benchmark(uint64_t m, uint8_t bits) {
+  succinct::elias_fano::elias_fano_builder bvb(uint64_t(1) << bits, m);
+  monotone_generator mgen(m, bits, 37);
+  for (size_t i = 0; i < m; ++i) { bvb.push_back(mgen.next()); }
+  assert(mgen.done());
+  succinct::elias_fano ef(&bvb);
+
+  double elapsed;
+  uint64_t foo = 0;
+  SUCCINCT_TIMEIT(elapsed) {
+    succinct::elias_fano::select_enumerator it(ef, 0);
+    for (size_t i = 0; i < m; ++i) { foo ^= it.next(); }
+  }
+  std::cerr << "EF next(): " << double(m) / elapsed << " Mcodes/s" << std::endl;
+
+  for (size_t block_size : {128, 256}) {
+    std::vector<uint64_t> block(block_size);
+    SUCCINCT_TIMEIT(elapsed) {
+      succinct::elias_fano::select_enumerator it(ef, 0);
+      for (size_t i = 0; i < m; i += block_size) {
+        size_t n = std::min<uint64_t>(block_size, m - i);
+        it.decode_block(block.data(), n);
+        for (size_t k = 0; k < n; ++k) { foo ^= block[k]; }
+      }
+    }
+    std::cerr << "EF decode_block(" << block_size << "): " << double(m) / elapsed << " Mcodes/s" << std::endl;
+  }
+
+  volatile uint64_t vfoo = foo;
+  (void)vfoo;  // silence warning
+}
+
 void hashtable_enumeration_benchmark(uint64_t m, uint8_t bits) {
   monotone_generator mgen(m, bits, 37);
 
@@ -115,6 +151,28 @@ void ef_construction_benchmark(uint64_t m, uint8_t bits) {
   std::cerr << "EF construction elapsed: " << elapsed / 1000 << " msec" << std::endl;
 }
 
+// Construction from a sorted vector, through elias_fano_builder and with
+// the bulk constructor on one and on all the hardware threads
+void ef_bulk_construction_benchmark(uint64_t m, uint8_t bits) {
+  monotone_generator mgen(m, bits, 37);
+  std::vector<uint64_t> values(m);
+  for (auto &v : values) { v = mgen.next(); }
+
+  double elapsed;
+  SUCCINCT_TIMEIT(elapsed) {
+    succinct::elias_fano::elias_fano_builder bvb(uint64_t(1) << bits, m);
+    for (auto v : values) { bvb.push_back(v); }
+    succinct::elias_fano ef(&bvb);
+  }
+  std::cerr << "EF construction from vector elapsed: " << elapsed / 1000 << " msec" << std::endl;
+
+  for (size_t num_threads : {1, 0}) {
+    SUCCINCT_TIMEIT(elapsed) { succinct::elias_fano ef(values, uint64_t(1) << bits, true, num_threads); }
+    std::cerr << "EF bulk construction (" << succinct::util::resolve_num_threads(num_threads)
+              << " threads) elapsed: " << elapsed / 1000 << " msec" << std::endl;
+  }
+}
+
 void hashtable_construction_benchmark(uint64_t m, uint8_t bits) {
   monotone_generator mgen(m, bits, 37);
 
@@ -138,6 +196,42 @@ std::vector<uint64_t> make_random_indices(uint64_t m, size_t num, unsigned seed
   return idx;
 }
 
+// Space and scan speed of elias_fano and partitioned_elias_fano on the same
+// clustered sequence
+void pef_benchmark(uint64_t m, uint8_t bits) {
+  succinct::elias_fano::elias_fano_builder bvb(uint64_t(1) << bits, m);
+  succinct::partitioned_elias_fano::builder pbvb(uint64_t(1) << bits, m);
+  monotone_generator mgen(m, bits, 37);
+  for (size_t i = 0; i < m; ++i) {
+    uint64_t v = mgen.next();
+    bvb.push_back(v);
+    pbvb.push_back(v);
+  }
+  assert(mgen.done());
+  succinct::elias_fano ef(&bvb);
+  succinct::partitioned_elias_fano pef(&pbvb);
+
+  std::cerr << "EF: " << double(succinct::mapper::size_of(ef)) * 8 / double(m) << " bits/code\n"
+            << "PEF: " << double(succinct::mapper::size_of(pef)) * 8 / double(m) << " bits/code" << std::endl;
+
+  double elapsed;
+  uint64_t foo = 0;
+  SUCCINCT_TIMEIT(elapsed) {
+    succinct::partitioned_elias_fano::select_enumerator it(pef, 0);
+    for (size_t i = 0; i < m; ++i) { foo ^= it.next(); }
+  }
+  std::cerr << "PEF scan: " << double(m) / elapsed << " Mcodes/s" << std::endl;
+
+  auto queries = make_random_indices(m, m);
+  SUCCINCT_TIMEIT(elapsed) {
+    for (auto q : queries) { foo ^= pef.select(q); }
+  }
+  std::cerr << "PEF random access: " << double(m) / elapsed << " Mops/s" << std::endl;
+
+  volatile uint64_t vfoo = foo;
+  (void)vfoo;  // silence warning
+}
+
 void ef_random_access_benchmark(uint64_t m, uint8_t bits, size_t num_queries) {
   succinct::elias_fano::elias_fano_builder bvb(uint64_t(1) << bits, m);
   monotone_generator mgen(m, bits, 37);
@@ -161,6 +255,48 @@ void ef_random_access_benchmark(uint64_t m, uint8_t bits, size_t num_queries) {
             << double(num_queries) / elapsed << " Mops/s" << std::endl;
 }
 
+// rank and membership of random values, on the sequence and on a variant
+// where half of the values are packed in a few buckets
+void ef_rank_benchmark(uint64_t m, uint8_t bits, size_t num_queries) {
+  uint64_t n = uint64_t(1) << bits;
+  std::mt19937_64 gen(123);
+  std::uniform_int_distribution<uint64_t> dist(0, n - 1);
+
+  monotone_generator mgen(m, bits, 37);
+  std::vector<uint64_t> clustered(m);
+  for (size_t i = 0; i < m; ++i) { clustered[i] = i % 2 ? mgen.next() : dist(gen) % (n / m * 16); }
+  std::sort(clustered.begin(), clustered.end());
+
+  monotone_generator mgen2(m, bits, 37);
+  succinct::elias_fano::elias_fano_builder bvb(n, m);
+  for (size_t i = 0; i < m; ++i) { bvb.push_back(mgen2.next()); }
+  succinct::elias_fano ef(&bvb);
+  succinct::elias_fano::elias_fano_builder cbvb(n, m);
+  for (auto v : clustered) { cbvb.push_back(v); }
+  succinct::elias_fano cef(&cbvb);
+
+  std::vector<uint64_t> queries(num_queries), dense_queries(num_queries);
+  for (auto &q : queries) { q = dist(gen); }
+  for (auto &q : dense_queries) { q = dist(gen) % (n / m * 16); }
+
+  auto run = [&](const char *name, succinct::elias_fano const &seq, std::vector<uint64_t> const &qs) {
+    double elapsed;
+    uint64_t foo = 0;
+    SUCCINCT_TIMEIT(elapsed) {
+      for (auto q : qs) { foo += seq.rank(q); }
+    }
+    std::cerr << name << " rank: " << double(qs.size()) / elapsed << " Mops/s" << std::endl;
+    SUCCINCT_TIMEIT(elapsed) {
+      for (auto q : qs) { foo += seq[q]; }
+    }
+    std::cerr << name << " operator[]: " << double(qs.size()) / elapsed << " Mops/s" << std::endl;
+    volatile uint64_t vfoo = foo;
+    (void)vfoo;
+  };
+  run("EF", ef, queries);
+  run("EF dense buckets", cef, dense_queries);
+}
+
 void hashtable_random_access_benchmark(uint64_t m, uint8_t bits, size_t num_queries) {
   monotone_generator mgen(m, bits, 37);
 
@@ -199,15 +335,26 @@ int main(int argc, char **argv) {
   uint64_t m   = std::stoull(argv[1]);
   uint8_t bits = static_cast<uint8_t>(std::stoi(argv[2]));
 
+  std::cerr << "Kernel tier: "
+            << succinct::broadword::kernel_tier_name(succinct::broadword::detected_kernel_tier()) << ", queries: "
+            << succinct::broadword::kernel_tier_name(succinct::broadword::query_kernel_tier()) << "\n\n";
   std::cerr << "=== Construction ===\n";
   ef_construction_benchmark(m, bits);
+  ef_bulk_construction_benchmark(m, bits);
   hashtable_construction_benchmark(m, bits);
 
   std::cerr << "\n=== Scan ===\n";
   ef_enumeration_benchmark(m, bits);
   hashtable_enumeration_benchmark(m, bits);
 
+  std::cerr << "\n=== Block decoding ===\n";
+  ef_decode_block_benchmark(m, bits);
+
   std::cerr << "\n=== Random access ===\n";
   ef_random_access_benchmark(m, bits, m);
   hashtable_random_access_benchmark(m, bits, m);
+  ef_rank_benchmark(m, bits, m);
+
+  std::cerr << "\n=== Partitioned ===\n";
+  pef_benchmark(m, bits);
 }
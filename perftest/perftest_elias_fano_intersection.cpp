@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "elias_fano.hpp"
+#include "perftest_common.hpp"
+
+// sorted distinct random values in [0, universe)
+std::vector<uint64_t> random_list(uint64_t universe, size_t size, unsigned seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<uint64_t> dist(0, universe - 1);
+  std::vector<uint64_t> v(size);
+  for (auto &x : v) { x = dist(rng); }
+  std::sort(v.begin(), v.end());
+  v.erase(std::unique(v.begin(), v.end()), v.end());
+  return v;
+}
+
+succinct::elias_fano make_elias_fano(std::vector<uint64_t> const &v, uint64_t universe) {
+  succinct::elias_fano::elias_fano_builder builder(universe, v.size());
+  for (auto x : v) { builder.push_back(x); }
+  return succinct::elias_fano(&builder);
+}
+
+// Time per intersection of a short list with a long list, looking up the
+// values of the short list in the long one with successor1 and with
+// next_geq_enumerator
+void intersection_benchmark(size_t log_universe, size_t long_size) {
+  static const size_t runs = 5;
+  uint64_t universe        = uint64_t(1) << log_universe;
+
+  std::cout << "SUCCINCT_ELIAS_FANO_INTERSECTION\n";
+  std::cout << "log_universe\tlong_size\tratio\tintersection_size\tsuccessor1_us\tnext_geq_us\n";
+
+  auto long_list = random_list(universe, long_size, 42);
+  auto long_ef   = make_elias_fano(long_list, universe);
+
+  for (size_t ratio : {1, 10, 100, 1000, 10000}) {
+    auto short_list = random_list(universe, long_list.size() / ratio + 1, 37 + unsigned(ratio));
+    auto short_ef   = make_elias_fano(short_list, universe);
+    uint64_t m      = short_ef.num_ones();
+
+    double successor_us;
+    uint64_t successor_count = 0;
+    SUCCINCT_TIMEIT(successor_us) {
+      for (size_t run = 0; run < runs; ++run) {
+        successor_count = 0;
+        succinct::elias_fano::select_enumerator it(short_ef, 0);
+        uint64_t last = long_ef.select(long_ef.num_ones() - 1);
+        for (uint64_t i = 0; i < m; ++i) {
+          uint64_t x = it.next();
+          if (x > last) break;
+          successor_count += long_ef.successor1(x) == x;
+        }
+      }
+    }
+
+    double next_geq_us;
+    uint64_t next_geq_count = 0;
+    SUCCINCT_TIMEIT(next_geq_us) {
+      for (size_t run = 0; run < runs; ++run) {
+        next_geq_count = 0;
+        succinct::elias_fano::select_enumerator it(short_ef, 0);
+        succinct::elias_fano::next_geq_enumerator cursor(long_ef);
+        for (uint64_t i = 0; i < m; ++i) {
+          uint64_t x = it.next();
+          uint64_t y = cursor.next_geq(x);
+          if (y == uint64_t(-1)) break;
+          next_geq_count += y == x;
+        }
+      }
+    }
+
+    if (successor_count != next_geq_count) {
+      std::cerr << "Mismatching intersection sizes: " << successor_count << " " << next_geq_count << std::endl;
+      std::terminate();
+    }
+
+    std::cout << log_universe << "\t" << long_list.size() << "\t" << ratio << "\t" << next_geq_count << "\t"
+              << successor_us / runs << "\t" << next_geq_us / runs << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t log_universe = 32;
+  size_t long_size    = 10000000;
+  if (argc == 3) {
+    log_universe = std::stoull(argv[1]);
+    long_size    = std::stoull(argv[2]);
+  }
+
+  intersection_benchmark(log_universe, long_size);
+}
@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "elias_fano_compressed_list.hpp"
+#include "elias_fano_list.hpp"
+#include "perftest_common.hpp"
+
+// Time per element of a full scan of the list with operator[], with
+// forward_enumerator::next() and with forward_enumerator::decode()
+template <typename List>
+void scan_benchmark(char const *name, List const &list) {
+  static const size_t block_size = 128;
+  size_t n                       = list.size();
+
+  auto time_scan = [&](auto scan) {
+    volatile uint64_t foo = 0;  // prevent optimization
+    double elapsed;
+    SUCCINCT_TIMEIT(elapsed) { foo = scan(); }
+    (void)foo;  // silence warning
+    return elapsed / static_cast<double>(n);
+  };
+
+  double access_us = time_scan([&] {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; ++i) { acc += list[i]; }
+    return acc;
+  });
+
+  double next_us = time_scan([&] {
+    uint64_t acc = 0;
+    succinct::forward_enumerator<List> e(list);
+    for (size_t i = 0; i < n; ++i) { acc += e.next(); }
+    return acc;
+  });
+
+  double decode_us = time_scan([&] {
+    uint64_t acc = 0;
+    uint64_t buf[block_size];
+    succinct::forward_enumerator<List> e(list);
+    for (size_t i = 0; i < n; i += block_size) {
+      size_t len = std::min(n - i, size_t(block_size));
+      e.decode(buf, len);
+      for (size_t j = 0; j < len; ++j) { acc += buf[j]; }
+    }
+    return acc;
+  });
+
+  std::cout << name << "\t" << n << "\t" << access_us << "\t" << next_us << "\t" << decode_us << "\n";
+}
+
+int main(int argc, char **argv) {
+  size_t n = 10000000;
+  if (argc == 2) { n = std::stoull(argv[1]); }
+
+  // geometric gaps, as in posting lists and offset tables
+  std::mt19937_64 rng(42);
+  std::geometric_distribution<uint64_t> dist(1.0 / 64);
+  std::vector<uint64_t> v(n);
+  for (auto &x : v) { x = dist(rng); }
+
+  std::cout << "SUCCINCT_ELIAS_FANO_LIST_SCAN\n";
+  std::cout << "list\tsize\toperator[]_us\tnext_us\tdecode_us\n";
+  scan_benchmark("elias_fano_list", succinct::elias_fano_list(v));
+  scan_benchmark("elias_fano_compressed_list", succinct::elias_fano_compressed_list(v));
+}
@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gamma_vector.hpp"
+#include "perftest_common.hpp"
+
+// Time per value of a full scan with next() and with next_block(), and
+// time per skip() for skips of increasing length
+void gamma_enumerator_benchmark(size_t n) {
+  static const size_t block_size = 128;
+
+  // geometric gaps, as in delta-encoded docid lists
+  std::mt19937_64 rng(42);
+  std::geometric_distribution<uint64_t> dist(1.0 / 64);
+  std::vector<uint64_t> v(n);
+  for (auto &x : v) { x = dist(rng); }
+  succinct::gamma_vector gv(v);
+
+  volatile uint64_t foo = 0;  // prevent optimization
+
+  double next_us;
+  SUCCINCT_TIMEIT(next_us) {
+    uint64_t acc = 0;
+    succinct::forward_enumerator<succinct::gamma_vector> e(gv);
+    for (size_t i = 0; i < n; ++i) { acc += e.next(); }
+    foo = acc;
+  }
+
+  double next_block_us;
+  SUCCINCT_TIMEIT(next_block_us) {
+    uint64_t acc = 0;
+    uint64_t buf[block_size];
+    succinct::forward_enumerator<succinct::gamma_vector> e(gv);
+    for (size_t i = 0; i < n; i += block_size) {
+      size_t len = std::min(n - i, size_t(block_size));
+      e.next_block(buf, len);
+      for (size_t j = 0; j < len; ++j) { acc += buf[j]; }
+    }
+    foo = acc;
+  }
+
+  std::cout << "SUCCINCT_GAMMA_VECTOR_SCAN\n";
+  std::cout << "size\tnext_us\tnext_block_us\n";
+  std::cout << n << "\t" << next_us / double(n) << "\t" << next_block_us / double(n) << "\n";
+
+  std::cout << "SUCCINCT_GAMMA_VECTOR_SKIP\n";
+  std::cout << "size\tskip\tskip_us\n";
+  for (size_t k : {4, 16, 63, 64, 256, 1024, 16384}) {
+    size_t skips = (n - 1) / (k + 1);
+    double skip_us;
+    SUCCINCT_TIMEIT(skip_us) {
+      uint64_t acc = 0;
+      succinct::forward_enumerator<succinct::gamma_vector> e(gv);
+      for (size_t i = 0; i < skips; ++i) {
+        e.skip(k);
+        acc += e.next();
+      }
+      foo = acc;
+    }
+    std::cout << n << "\t" << k << "\t" << skip_us / double(skips) << "\n";
+  }
+  (void)foo;  // silence warning
+}
+
+int main(int argc, char **argv) {
+  size_t n = 10000000;
+  if (argc == 2) { n = std::stoull(argv[1]); }
+
+  gamma_enumerator_benchmark(n);
+}
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nibble_vector.hpp"
+#include "perftest_common.hpp"
+
+// Time per nibble of random accesses with operator[], and of sequential
+// scans with operator[] and with get_range in blocks of increasing size
+void nibble_vector_benchmark(size_t n) {
+  static const size_t sample_size = 1000000;
+
+  std::mt19937_64 rng(42);
+  succinct::nibble_vector::builder builder(n);
+  for (size_t i = 0; i < n; ++i) { builder.push_back(uint8_t(rng() % 16)); }
+  succinct::nibble_vector nv(&builder);
+
+  std::uniform_int_distribution<uint64_t> idx_dist(0, n - 1);
+  std::vector<uint64_t> indices(sample_size);
+  for (auto &i : indices) { i = idx_dist(rng); }
+
+  auto time_per_nibble = [](size_t count, auto fn) {
+    volatile uint64_t foo = 0;  // prevent optimization
+    double elapsed;
+    SUCCINCT_TIMEIT(elapsed) { foo = fn(); }
+    (void)foo;  // silence warning
+    return elapsed / static_cast<double>(count);
+  };
+
+  double random_us = time_per_nibble(sample_size, [&] {
+    uint64_t acc = 0;
+    for (auto i : indices) { acc += nv[i]; }
+    return acc;
+  });
+
+  double scan_us = time_per_nibble(n, [&] {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; ++i) { acc += nv[i]; }
+    return acc;
+  });
+
+  std::cout << "SUCCINCT_NIBBLE_VECTOR\n";
+  std::cout << "size\trandom_access_us\tscan_access_us\n";
+  std::cout << n << "\t" << random_us << "\t" << scan_us << "\n";
+
+  std::cout << "SUCCINCT_NIBBLE_VECTOR_GET_RANGE\n";
+  std::cout << "size\tblock_size\tscan_get_range_us\n";
+  for (size_t block_size : {8, 32, 128, 1024}) {
+    std::vector<uint8_t> buf(block_size);
+    double get_range_us = time_per_nibble(n, [&] {
+      uint64_t acc = 0;
+      for (size_t i = 0; i < n; i += block_size) {
+        size_t len = std::min(n - i, block_size);
+        nv.get_range(i, len, buf.data());
+        for (size_t j = 0; j < len; ++j) { acc += buf[j]; }
+      }
+      return acc;
+    });
+    std::cout << n << "\t" << block_size << "\t" << get_range_us << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 100000000;
+  if (argc == 2) { n = std::stoull(argv[1]); }
+
+  nibble_vector_benchmark(n);
+}
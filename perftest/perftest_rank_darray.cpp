@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mapper.hpp"
+#include "perftest_common.hpp"
+#include "rank_darray.hpp"
+#include "rs_bit_vector.hpp"
+
+// Space overhead (extra bits per bit) and time per rank/select of
+// rank_darray1 and of rs_bit_vector with select hints, over the same bits
+void rank_darray_benchmark(size_t log_size) {
+  static const size_t sample_size = 1000000;
+  uint64_t n                      = uint64_t(1) << log_size;
+
+  std::cout << "SUCCINCT_RANK_DARRAY\n";
+  std::cout << "log_size\tdensity\trank_darray_overhead\trank_darray_rank_us\trank_darray_select_us\trs_overhead\trs_"
+               "rank_us\trs_select_us\n";
+
+  for (size_t ld = 1; ld <= 7; ld += 3) {
+    // ones with probability 1/2^ld, as the AND of ld random words
+    double density = 1.0 / double(uint64_t(1) << ld);
+    std::mt19937_64 rng(42);
+    succinct::bit_vector_builder builder;
+    builder.reserve(n);
+    for (uint64_t i = 0; i < n / 64; ++i) {
+      uint64_t word = uint64_t(-1);
+      for (size_t j = 0; j < ld; ++j) { word &= rng(); }
+      builder.append_bits(word, 64);
+    }
+    succinct::rs_bit_vector rs(&builder, true);
+    succinct::bit_vector const &bv = rs;
+    succinct::rank_darray1 rd(bv);
+
+    std::mt19937_64 qrng(37);
+    std::uniform_int_distribution<uint64_t> pos_dist(0, n - 1);
+    std::uniform_int_distribution<uint64_t> idx_dist(0, rs.num_ones() - 1);
+    std::vector<uint64_t> positions(sample_size), indices(sample_size);
+    for (auto &p : positions) { p = pos_dist(qrng); }
+    for (auto &i : indices) { i = idx_dist(qrng); }
+
+    auto time_queries = [](std::vector<uint64_t> const &queries, auto query) {
+      volatile uint64_t foo = 0;  // prevent optimization
+      double elapsed;
+      SUCCINCT_TIMEIT(elapsed) {
+        uint64_t acc = 0;
+        for (auto q : queries) { acc ^= query(q); }
+        foo = acc;
+      }
+      (void)foo;  // silence warning
+      return elapsed / static_cast<double>(queries.size());
+    };
+
+    // rs_bit_vector contains the bits, rank_darray does not
+    double bits         = double(n);
+    double rd_overhead  = double(succinct::mapper::size_of(rd)) * 8 / bits;
+    double rs_overhead  = (double(succinct::mapper::size_of(rs)) * 8 - bits) / bits;
+    double rd_rank_us   = time_queries(positions, [&](uint64_t p) { return rd.rank(bv, p); });
+    double rd_select_us = time_queries(indices, [&](uint64_t i) { return rd.select(bv, i); });
+    double rs_rank_us   = time_queries(positions, [&](uint64_t p) { return rs.rank(p); });
+    double rs_select_us = time_queries(indices, [&](uint64_t i) { return rs.select(i); });
+
+    std::cout << log_size << "\t" << density << "\t" << rd_overhead << "\t" << rd_rank_us << "\t" << rd_select_us
+              << "\t" << rs_overhead << "\t" << rs_rank_us << "\t" << rs_select_us << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t log_size = 28;
+  if (argc == 2) { log_size = std::stoull(argv[1]); }
+
+  rank_darray_benchmark(log_size);
+}
@@ -0,0 +1,178 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "perftest_common.hpp"
+#include "rs_bit_vector.hpp"
+#include "util.hpp"
+
+// Fill a builder with size random bits, each set with probability 1/2
+void fill_random_bits(succinct::bit_vector_builder &builder, uint64_t size) {
+  std::mt19937_64 rng(42);  // deterministic
+  builder.reserve(size);
+  for (uint64_t i = 0; i < size / 64; ++i) { builder.append_bits(rng(), 64); }
+  if (size % 64) { builder.append_bits(rng() >> (64 - size % 64), size % 64); }
+}
+
+// Build a random bit vector of the given size, with each bit set with probability 1/2
+void build_random_bit_vector(succinct::rs_bit_vector &bitmap, uint64_t size) {
+  succinct::bit_vector_builder builder;
+  fill_random_bits(builder, size);
+  succinct::rs_bit_vector(&builder, true).swap(bitmap);
+}
+
+// Time per operation of a scalar loop and of the batched call over the same queries
+template <typename Scalar, typename Batch>
+void time_scalar_batch(std::vector<uint64_t> const &queries, Scalar scalar, Batch batch, double &scalar_us,
+                       double &batch_us) {
+  std::vector<uint64_t> results(queries.size());
+  volatile uint64_t foo = 0;  // prevent optimization
+  double elapsed;
+
+  SUCCINCT_TIMEIT(elapsed) {
+    uint64_t acc = 0;
+    for (auto q : queries) { acc ^= scalar(q); }
+    foo = acc;
+  }
+  scalar_us = elapsed / static_cast<double>(queries.size());
+
+  SUCCINCT_TIMEIT(elapsed) {
+    batch(queries, results);
+    foo = results.back();
+  }
+  batch_us = elapsed / static_cast<double>(queries.size());
+
+  (void)foo;  // silence warning
+}
+
+// Compare rank/select scalar loops against rank_batch/select_batch on
+// 2^20 bits (128 KiB) and every other power of two after it, up to and
+// including 2^max_log_size
+void batch_benchmark(size_t max_log_size) {
+  static const size_t sample_size = 10000000;
+
+  std::cout << "SUCCINCT_RS_BIT_VECTOR_BATCH\n";
+  std::cout << "kernel_tier\t" << succinct::broadword::kernel_tier_name(succinct::broadword::detected_kernel_tier())
+            << "\n";
+  std::cout << "query_kernel_tier\t"
+            << succinct::broadword::kernel_tier_name(succinct::broadword::query_kernel_tier()) << "\n";
+  std::cout << "log_size\trank_us\trank_batch_us\tselect_us\tselect_batch_us\n";
+
+  std::vector<size_t> log_sizes;
+  for (size_t ln = 20; ln < max_log_size; ln += 2) { log_sizes.push_back(ln); }
+  log_sizes.push_back(max_log_size);
+
+  for (size_t ln : log_sizes) {
+    uint64_t n = uint64_t(1) << ln;
+    succinct::rs_bit_vector bitmap;
+    build_random_bit_vector(bitmap, n);
+
+    std::mt19937_64 rng(37);
+    std::uniform_int_distribution<uint64_t> pos_dist(0, n - 1);
+    std::uniform_int_distribution<uint64_t> idx_dist(0, bitmap.num_ones() - 1);
+    std::vector<uint64_t> positions(sample_size), indices(sample_size);
+    for (auto &p : positions) { p = pos_dist(rng); }
+    for (auto &i : indices) { i = idx_dist(rng); }
+
+    double rank_us, rank_batch_us, select_us, select_batch_us;
+    time_scalar_batch(
+      positions, [&](uint64_t p) { return bitmap.rank(p); },
+      [&](std::vector<uint64_t> const &in, std::vector<uint64_t> &out) { bitmap.rank_batch(in, out); }, rank_us,
+      rank_batch_us);
+    time_scalar_batch(
+      indices, [&](uint64_t i) { return bitmap.select(i); },
+      [&](std::vector<uint64_t> const &in, std::vector<uint64_t> &out) { bitmap.select_batch(in, out); }, select_us,
+      select_batch_us);
+
+    std::cout << ln << "\t" << rank_us << "\t" << rank_batch_us << "\t" << select_us << "\t" << select_batch_us << "\n";
+  }
+}
+
+// Time per select of plain binary search, select hints and select
+// inventory, on 2^log_size bits vectors of decreasing density
+void select_benchmark(size_t log_size) {
+  static const size_t sample_size = 1000000;
+  uint64_t n                      = uint64_t(1) << log_size;
+
+  std::cout << "SUCCINCT_RS_BIT_VECTOR_SELECT\n";
+  std::cout << "log_size\tdensity\tselect_bs_us\tselect_hints_us\tselect_inventory_us\tselect0_bs_us\tselect0_"
+               "hints_us\tselect0_inventory_us\n";
+
+  for (size_t ld = 1; ld <= 12; ld += 1) {
+    // ones with probability 1/2^ld, as the AND of ld random words
+    double density = 1.0 / double(uint64_t(1) << ld);
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> words(n / 64);
+    for (auto &word : words) {
+      word = uint64_t(-1);
+      for (size_t j = 0; j < ld; ++j) { word &= rng(); }
+    }
+    auto build = [&](bool with_hints, bool with_inventory) {
+      succinct::bit_vector_builder builder;
+      builder.reserve(n);
+      for (auto word : words) { builder.append_bits(word, 64); }
+      return succinct::rs_bit_vector(&builder, with_hints, with_hints, 0, with_inventory, with_inventory);
+    };
+    succinct::rs_bit_vector bs        = build(false, false);
+    succinct::rs_bit_vector hints     = build(true, false);
+    succinct::rs_bit_vector inventory = build(false, true);
+
+    std::mt19937_64 qrng(37);
+    std::uniform_int_distribution<uint64_t> ones_dist(0, bs.num_ones() - 1);
+    std::uniform_int_distribution<uint64_t> zeros_dist(0, bs.num_zeros() - 1);
+    std::vector<uint64_t> ones(sample_size), zeros(sample_size);
+    for (auto &q : ones) { q = ones_dist(qrng); }
+    for (auto &q : zeros) { q = zeros_dist(qrng); }
+
+    auto time_queries = [](std::vector<uint64_t> const &queries, auto query) {
+      volatile uint64_t foo = 0;  // prevent optimization
+      double elapsed;
+      SUCCINCT_TIMEIT(elapsed) {
+        uint64_t acc = 0;
+        for (auto q : queries) { acc ^= query(q); }
+        foo = acc;
+      }
+      (void)foo;  // silence warning
+      return elapsed / static_cast<double>(queries.size());
+    };
+
+    std::cout << log_size << "\t" << density;
+    for (auto const *bitmap : {&bs, &hints, &inventory}) {
+      std::cout << "\t" << time_queries(ones, [&](uint64_t q) { return bitmap->select(q); });
+    }
+    for (auto const *bitmap : {&bs, &hints, &inventory}) {
+      std::cout << "\t" << time_queries(zeros, [&](uint64_t q) { return bitmap->select0(q); });
+    }
+    std::cout << "\n";
+  }
+}
+
+// Time to build the rank/select indices of a 2^log_size bits vector, with an
+// increasing number of threads
+void build_benchmark(size_t log_size) {
+  uint64_t n = uint64_t(1) << log_size;
+
+  std::cout << "SUCCINCT_RS_BIT_VECTOR_BUILD\n";
+  std::cout << "log_size\tthreads\tbuild_ms\n";
+  size_t max_threads = succinct::util::resolve_num_threads(0);
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    succinct::bit_vector_builder builder;
+    fill_random_bits(builder, n);
+    succinct::rs_bit_vector bitmap;
+    double elapsed;
+    SUCCINCT_TIMEIT(elapsed) { succinct::rs_bit_vector(&builder, true, true, threads).swap(bitmap); }
+    std::cout << log_size << "\t" << threads << "\t" << elapsed / 1000 << "\n";
+  }
+}
+
+int main(int argc, char **argv) {
+  // 34 is 2 GB of bits; pass 37 to go up to 16 GB
+  size_t max_log_size = 30;
+  if (argc == 2) { max_log_size = std::stoull(argv[1]); }
+
+  batch_benchmark(max_log_size);
+  build_benchmark(max_log_size);
+  select_benchmark(max_log_size);
+}
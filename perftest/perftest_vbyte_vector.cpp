@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "elias_fano_compressed_list.hpp"
+#include "gamma_vector.hpp"
+#include "mapper.hpp"
+#include "perftest_common.hpp"
+#include "vbyte.hpp"
+
+template <typename List, typename Value>
+void list_benchmark(char const *name, std::vector<uint64_t> const &v, std::vector<uint64_t> const &indices,
+                    double mean) {
+  static const size_t block_size = 128;
+  List list(v);
+  size_t n = v.size();
+
+  auto time_per_value = [](size_t count, auto fn) {
+    volatile uint64_t foo = 0;  // prevent optimization
+    double elapsed;
+    SUCCINCT_TIMEIT(elapsed) { foo = fn(); }
+    (void)foo;  // silence warning
+    return elapsed / static_cast<double>(count);
+  };
+
+  double random_us = time_per_value(indices.size(), [&] {
+    uint64_t acc = 0;
+    for (auto i : indices) { acc += list[i]; }
+    return acc;
+  });
+
+  double decode_us = time_per_value(n, [&] {
+    uint64_t acc = 0;
+    Value buf[block_size];
+    succinct::forward_enumerator<List> e(list);
+    for (size_t i = 0; i < n; i += block_size) {
+      size_t len = std::min(n - i, size_t(block_size));
+      if constexpr (std::is_same_v<List, succinct::gamma_vector>) {
+        e.next_block(buf, len);
+      } else {
+        e.decode(buf, len);
+      }
+      for (size_t j = 0; j < len; ++j) { acc += buf[j]; }
+    }
+    return acc;
+  });
+
+  double bits_per_value = double(succinct::mapper::size_of(list)) * 8 / double(n);
+  std::cout << mean << "\t" << name << "\t" << bits_per_value << "\t" << random_us << "\t" << decode_us << "\n";
+}
+
+// Space and time per value of the integer codes on geometric values of
+// increasing mean: random access with operator[] and bulk decoding with
+// the forward_enumerator
+int main(int argc, char **argv) {
+  static const size_t sample_size = 1000000;
+  size_t n                        = 3000000;
+  if (argc == 2) { n = std::stoull(argv[1]); }
+
+  std::cout << "SUCCINCT_VBYTE_VECTOR\n";
+  std::cout << "mean\tlist\tbits_per_value\trandom_access_us\tdecode_us\n";
+
+  for (double mean : {16.0, 1000.0, 100000.0}) {
+    std::mt19937_64 rng(42);
+    std::geometric_distribution<uint64_t> dist(1.0 / mean);
+    std::vector<uint64_t> v(n);
+    for (auto &x : v) { x = dist(rng); }
+    std::uniform_int_distribution<uint64_t> idx_dist(0, n - 1);
+    std::vector<uint64_t> indices(sample_size);
+    for (auto &i : indices) { i = idx_dist(rng); }
+
+    list_benchmark<succinct::vbyte_vector, uint32_t>("vbyte_vector", v, indices, mean);
+    list_benchmark<succinct::gamma_vector, uint64_t>("gamma_vector", v, indices, mean);
+    list_benchmark<succinct::elias_fano_compressed_list, uint64_t>("elias_fano_compressed_list", v, indices, mean);
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "darray.hpp"
+
+namespace succinct {
+
+namespace detail {
+
+// darray extended with a compact rank directory over the same bit_vector:
+// an absolute rank every superblock_bits and a 16-bit rank relative to it
+// every block_bits, about 3.2% of the bits on top of the darray. A block is
+// a 64-byte line of the bit vector, so rank reads two directory entries and
+// at most one line of bits.
+template <typename WordGetter>
+class rank_darray {
+ public:
+  rank_darray() {}
+
+  rank_darray(bit_vector const &bv) {
+    mapper::mappable_vector<uint64_t> const &data = bv.data();
+    typename darray<WordGetter>::builder select_builder(bv.size(), WordGetter::count(bv));
+
+    std::vector<uint64_t> superblock_ranks;
+    std::vector<uint16_t> block_ranks;
+    superblock_ranks.reserve(util::ceil_div(data.size(), words_per_superblock));
+    block_ranks.reserve(util::ceil_div(data.size(), words_per_block));
+
+    uint64_t cur_rank        = 0;
+    uint64_t superblock_rank = 0;
+    for (size_t word_idx = 0; word_idx < data.size(); ++word_idx) {
+      if (word_idx % words_per_block == 0) {
+        if (word_idx % words_per_superblock == 0) {
+          superblock_ranks.push_back(cur_rank);
+          superblock_rank = cur_rank;
+        }
+        block_ranks.push_back(uint16_t(cur_rank - superblock_rank));
+      }
+      select_builder.append_word(data[word_idx]);
+      cur_rank += broadword::popcount(WordGetter()(data[word_idx]));
+    }
+
+    select_builder.build(m_select);
+    m_superblock_ranks.steal(superblock_ranks);
+    m_block_ranks.steal(block_ranks);
+  }
+
+  template <typename Visitor>
+  void map(Visitor &visit) {
+    visit(m_select, "m_select")(m_superblock_ranks, "m_superblock_ranks")(m_block_ranks, "m_block_ranks");
+  }
+
+  void swap(rank_darray &other) {
+    m_select.swap(other.m_select);
+    m_superblock_ranks.swap(other.m_superblock_ranks);
+    m_block_ranks.swap(other.m_block_ranks);
+  }
+
+  inline uint64_t select(bit_vector const &bv, uint64_t idx) const { return m_select.select(bv, idx); }
+
+  // number of positions before pos
+  inline uint64_t rank(bit_vector const &bv, uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return rank<Tier>(bv, pos); });
+  }
+
+  // Same as rank(bv, pos), with the scalar kernels of the given tier
+  template <broadword::kernel_tier Tier>
+  inline uint64_t rank(bit_vector const &bv, uint64_t pos) const {
+    assert(pos <= bv.size());
+    if (pos == bv.size()) { return num_positions(); }
+
+    uint64_t block       = pos / (words_per_block * 64);
+    uint64_t r           = m_superblock_ranks[pos / (words_per_superblock * 64)] + m_block_ranks[block];
+    uint64_t const *data = bv.data().data();
+    uint64_t word_idx    = pos / 64;
+    for (uint64_t w = block * words_per_block; w < word_idx; ++w) {
+      r += broadword::popcount<Tier>(WordGetter()(data[w]));
+    }
+    if (pos % 64) { r += broadword::popcount<Tier>(WordGetter()(data[word_idx]) << (64 - pos % 64)); }
+    return r;
+  }
+
+  inline uint64_t num_positions() const { return m_select.num_positions(); }
+
+ protected:
+  static const uint64_t words_per_block      = 8;     // 512 bits
+  static const uint64_t words_per_superblock = 1024;  // 2^16 bits, so relative ranks fit in an uint16_t
+
+  darray<WordGetter> m_select;
+  mapper::mappable_vector<uint64_t> m_superblock_ranks;
+  mapper::mappable_vector<uint16_t> m_block_ranks;
+};
+
+}  // namespace detail
+
+typedef detail::rank_darray<detail::identity_getter> rank_darray1;
+typedef detail::rank_darray<detail::negating_getter> rank_darray0;
+}  // namespace succinct
@@ -1,71 +1,286 @@
 #include "rs_bit_vector.hpp"
 
+#include <numeric>
+
+#include "util.hpp"
+
 namespace succinct {
 
-void rs_bit_vector::build_indices(bool with_select_hints, bool with_select0_hints) {
-  {
-    using broadword::popcount;
-    std::vector<uint64_t> block_rank_pairs;
-    uint64_t next_rank   = 0;
-    uint64_t cur_subrank = 0;
-    uint64_t subranks    = 0;
-    block_rank_pairs.push_back(0);
-    for (uint64_t i = 0; i < m_bits.size(); ++i) {
-      uint64_t word_pop = popcount(m_bits[i]);
-      uint64_t shift    = i % block_size;
-      if (shift) {
-        subranks <<= 9;
-        subranks |= cur_subrank;
+namespace {
+// below this many blocks per thread the fixed cost of spawning threads
+// dominates, so fewer threads are used
+static const uint64_t min_blocks_per_thread = 1024;
+}  // namespace
+
+template <typename BlockRank>
+void rs_bit_vector::select_inventory::build(BlockRank block_rank, uint64_t num_blocks, size_t num_threads) {
+  uint64_t total        = block_rank(num_blocks);
+  uint64_t samples      = util::ceil_div(total, ones_per_sample);
+  uint64_t group_stride = ones_per_sample * samples_per_group;
+  uint64_t last_block   = num_blocks ? num_blocks - 1 : 0;
+
+  // the entries past the last one point to the last block, so that the
+  // sample following any one is always defined
+  std::vector<uint64_t> groups(samples / samples_per_group + 2, last_block);
+  std::vector<uint64_t> sample_blocks(samples + 1, last_block);
+
+  // calls fn(k, block) for every k such that the (k * stride)-th one lies
+  // in one of the blocks [begin, end)
+  auto for_each_sample = [&](uint64_t begin, uint64_t end, uint64_t stride, auto fn) {
+    uint64_t k = util::ceil_div(block_rank(begin), stride);
+    for (uint64_t i = begin; i < end; ++i) {
+      uint64_t next_rank = block_rank(i + 1);
+      for (; k * stride < next_rank; ++k) { fn(k, i); }
+    }
+  };
+
+  util::parallel_ranges(num_blocks, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+    for_each_sample(begin, end, group_stride, [&](uint64_t group, uint64_t block) { groups[group] = block; });
+  });
+  util::parallel_ranges(num_blocks, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+    for_each_sample(begin, end, ones_per_sample,
+                    [&](uint64_t sample, uint64_t block) { sample_blocks[sample] = block; });
+  });
+
+  // the samples are classified sequentially, as the sparse records of
+  // each group start where the previous group's end
+  std::vector<uint16_t> offsets(samples);
+  std::vector<uint64_t> sparse_bases(groups.size());
+  uint64_t sparse_words = 0;
+  for (uint64_t sample = 0; sample < samples; ++sample) {
+    if (sample % samples_per_group == 0) { sparse_bases[sample / samples_per_group] = sparse_words; }
+    uint64_t offset = sample_blocks[sample] - groups[sample / samples_per_group];
+    uint64_t span   = sample_blocks[sample + 1] - sample_blocks[sample];
+    if (span <= sparse_sample_blocks && offset < sparse_offset) {
+      offsets[sample] = uint16_t(offset);
+    } else {
+      offsets[sample] = span <= 0xFFFF ? sparse_offset : spill_offset;
+      sparse_words += record_words(offsets[sample]);
+    }
+  }
+  for (uint64_t group = util::ceil_div(samples, samples_per_group); group < sparse_bases.size(); ++group) {
+    sparse_bases[group] = sparse_words;
+  }
+
+  std::vector<uint64_t> sparse(sparse_words);
+  util::parallel_ranges(samples, num_threads, [&](size_t, uint64_t begin, uint64_t end) {
+    uint64_t r = 0;
+    for (uint64_t sample = begin; sample < end; ++sample) {
+      if (sample == begin || sample % samples_per_group == 0) {
+        // start of the record of the first sample of the range
+        r = sparse_bases[sample / samples_per_group];
+        for (uint64_t s = sample / samples_per_group * samples_per_group; s < sample; ++s) {
+          r += record_words(offsets[s]);
+        }
       }
-      next_rank += word_pop;
-      cur_subrank += word_pop;
-
-      if (shift == block_size - 1) {
-        block_rank_pairs.push_back(subranks);
-        block_rank_pairs.push_back(next_rank);
-        subranks    = 0;
-        cur_subrank = 0;
+      if (offsets[sample] < sparse_offset) { continue; }
+
+      uint64_t block = sample_blocks[sample];
+      uint64_t first = sample * ones_per_sample;
+      uint64_t *rec  = sparse.data() + r;
+      rec[0]         = block;
+      for (uint64_t i = first; i < std::min(first + ones_per_sample, total); ++i) {
+        while (block_rank(block + 1) <= i) { ++block; }
+        if (offsets[sample] == spill_offset) {
+          rec[i - first] = block;
+        } else {
+          rec[1 + (i - first) / 4] |= (block - rec[0]) << ((i - first) % 4 * 16);
+        }
       }
+      r += record_words(offsets[sample]);
     }
-    uint64_t left = block_size - m_bits.size() % block_size;
-    for (uint64_t i = 0; i < left; ++i) {
-      subranks <<= 9;
-      subranks |= cur_subrank;
-    }
-    block_rank_pairs.push_back(subranks);
+  });
+
+  m_groups.steal(groups);
+  m_offsets.steal(offsets);
+  if (sparse_words) {
+    m_sparse_bases.steal(sparse_bases);
+    m_sparse.steal(sparse);
+  }
+}
+
+void rs_bit_vector::build_indices(bool with_select_hints, bool with_select0_hints, size_t num_threads,
+                                  bool with_select_inventory, bool with_select0_inventory) {
+  uint64_t num_words   = m_bits.size();
+  uint64_t num_blocks_ = util::ceil_div(num_words, block_size);
+  num_threads          = std::max<size_t>(
+    1, std::min<uint64_t>(util::resolve_num_threads(num_threads), num_blocks_ / min_blocks_per_thread));
+
+  {
+    // block i owns entries 2i + 1 (its subranks) and 2i + 2 (the rank at
+    // the start of block i + 1), so threads working on disjoint ranges of
+    // blocks never write the same entry
+    std::vector<uint64_t> block_rank_pairs(2 * (num_blocks_ + 1));
 
-    if (m_bits.size() % block_size) {
-      block_rank_pairs.push_back(next_rank);
-      block_rank_pairs.push_back(0);
+    auto fill_blocks = [&](uint64_t begin, uint64_t end, uint64_t next_rank) {
+      // word popcounts are computed in bulk, a chunk at a time
+      static const size_t popcount_chunk = 1024;  // must be a multiple of block_size
+      uint8_t word_pops[popcount_chunk];
+      uint64_t first_word = begin * block_size;
+      uint64_t last_word  = std::min(end * block_size, num_words);
+      for (uint64_t block = begin; block < end; ++block) {
+        uint64_t word = block * block_size;
+        if ((word - first_word) % popcount_chunk == 0) {
+          broadword::popcount_each(m_bits.data() + word, std::min<uint64_t>(popcount_chunk, last_word - word),
+                                   word_pops);
+        }
+        uint8_t const *pops = word_pops + (word - first_word) % popcount_chunk;
+        uint64_t words      = std::min(uint64_t(block_size), last_word - word);
+
+        // the last block may be partial: the missing words count as empty
+        uint64_t subranks    = 0;
+        uint64_t cur_subrank = 0;
+        for (uint64_t i = 0; i < block_size; ++i) {
+          if (i) {
+            subranks <<= 9;
+            subranks |= cur_subrank;
+          }
+          if (i < words) { cur_subrank += pops[i]; }
+        }
+        next_rank += cur_subrank;
+        block_rank_pairs[2 * block + 1] = subranks;
+        block_rank_pairs[2 * block + 2] = next_rank;
+      }
+    };
+
+    if (num_threads == 1) {
+      fill_blocks(0, num_blocks_, 0);
+    } else {
+      // count the ones of each range, turn the counts into starting ranks
+      // with a prefix sum, then fill the ranges independently
+      std::vector<uint64_t> range_ranks(num_threads + 1);
+      util::parallel_ranges(num_blocks_, num_threads, [&](size_t t, uint64_t begin, uint64_t end) {
+        uint64_t first_word = begin * block_size;
+        uint64_t last_word  = std::min(end * block_size, num_words);
+        range_ranks[t + 1]  = broadword::popcount_words(m_bits.data() + first_word, last_word - first_word);
+      });
+      std::partial_sum(range_ranks.begin(), range_ranks.end(), range_ranks.begin());
+      util::parallel_ranges(num_blocks_, num_threads,
+                            [&](size_t t, uint64_t begin, uint64_t end) { fill_blocks(begin, end, range_ranks[t]); });
     }
 
     m_block_rank_pairs.steal(block_rank_pairs);
   }
 
-  if (with_select_hints) {
-    std::vector<uint64_t> select_hints;
-    uint64_t cur_ones_threshold = select_ones_per_hint;
-    for (uint64_t i = 0; i < num_blocks(); ++i) {
-      if (block_rank(i + 1) > cur_ones_threshold) {
-        select_hints.push_back(i);
-        cur_ones_threshold += select_ones_per_hint;
+  // A block holds at most block_size * 64 ones (or zeros), fewer than a
+  // hint's worth, so it crosses at most one hint threshold: the threshold
+  // in effect at any block depends only on the block's rank, and each range
+  // of blocks can find its hints independently of the others
+  auto build_hints = [&](auto block_rank_fn, uint64_t per_hint, uint64_vec &hints) {
+    std::vector<std::vector<uint64_t>> range_hints(num_threads);
+    util::parallel_ranges(num_blocks_, num_threads, [&](size_t t, uint64_t begin, uint64_t end) {
+      uint64_t cur_threshold = std::max(per_hint, util::ceil_div(block_rank_fn(begin), per_hint) * per_hint);
+      for (uint64_t i = begin; i < end; ++i) {
+        if (block_rank_fn(i + 1) > cur_threshold) {
+          range_hints[t].push_back(i);
+          cur_threshold += per_hint;
+        }
       }
-    }
-    select_hints.push_back(num_blocks());
-    m_select_hints.steal(select_hints);
+    });
+
+    std::vector<uint64_t> all_hints;
+    for (auto &r : range_hints) { all_hints.insert(all_hints.end(), r.begin(), r.end()); }
+    all_hints.push_back(num_blocks());
+    hints.steal(all_hints);
+  };
+
+  if (with_select_hints) {
+    build_hints([&](uint64_t block) { return block_rank(block); }, select_ones_per_hint, m_select_hints);
   }
 
   if (with_select0_hints) {
-    std::vector<uint64_t> select0_hints;
-    uint64_t cur_zeros_threshold = select_zeros_per_hint;
-    for (uint64_t i = 0; i < num_blocks(); ++i) {
-      if (block_rank0(i + 1) > cur_zeros_threshold) {
-        select0_hints.push_back(i);
-        cur_zeros_threshold += select_zeros_per_hint;
+    build_hints([&](uint64_t block) { return block_rank0(block); }, select_zeros_per_hint, m_select0_hints);
+  }
+
+  if (with_select_inventory) {
+    m_select_inventory.build([&](uint64_t block) { return block_rank(block); }, num_blocks_, num_threads);
+  }
+
+  if (with_select0_inventory) {
+    m_select0_inventory.build([&](uint64_t block) { return block_rank0(block); }, num_blocks_, num_threads);
+  }
+}
+
+void rs_bit_vector::rank_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { rank_batch<Tier>(in, out); });
+}
+
+void rs_bit_vector::select_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { select_batch<Tier>(in, out); });
+}
+
+template <broadword::kernel_tier Tier>
+void rs_bit_vector::rank_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  assert(in.size() == out.size());
+
+  auto prefetch_group = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      uint64_t sub_block = in[i] / 64;
+      m_block_rank_pairs.prefetch(sub_block / block_size * 2);
+      m_bits.prefetch(sub_block);
+    }
+  };
+
+  // software pipeline: the next group is prefetched while the current one
+  // is computed
+  prefetch_group(0, std::min(in.size(), batch_group_size));
+  for (size_t begin = 0; begin < in.size(); begin += batch_group_size) {
+    size_t end = std::min(in.size(), begin + batch_group_size);
+    prefetch_group(end, std::min(in.size(), end + batch_group_size));
+    for (size_t i = begin; i < end; ++i) { out[i] = rank<Tier>(in[i]); }
+  }
+}
+
+template <broadword::kernel_tier Tier>
+void rs_bit_vector::select_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const {
+  assert(in.size() == out.size());
+
+  uint64_t a[batch_group_size];
+  uint64_t b[batch_group_size];
+
+  for (size_t begin = 0; begin < in.size(); begin += batch_group_size) {
+    size_t n = std::min(in.size() - begin, batch_group_size);
+    std::span<const uint64_t> group_in = in.subspan(begin, n);
+
+    if (m_select_inventory.size()) {
+      for (size_t i = 0; i < n; ++i) { m_select_inventory.prefetch(group_in[i]); }
+    } else if (m_select_hints.size()) {
+      for (size_t i = 0; i < n; ++i) { m_select_hints.prefetch(group_in[i] / select_ones_per_hint); }
+    }
+    for (size_t i = 0; i < n; ++i) {
+      assert(group_in[i] < num_ones());
+      select_hint_range(group_in[i], a[i], b[i]);
+    }
+
+    // binary searches advance in lockstep, one probe per query per round;
+    // all the probes of a round are prefetched before being read
+    while (true) {
+      bool active = false;
+      for (size_t i = 0; i < n; ++i) {
+        if (b[i] - a[i] > 1) {
+          m_block_rank_pairs.prefetch((a[i] + (b[i] - a[i]) / 2) * 2);
+          active = true;
+        }
       }
+      if (!active) break;
+
+      for (size_t i = 0; i < n; ++i) {
+        if (b[i] - a[i] > 1) {
+          uint64_t mid = a[i] + (b[i] - a[i]) / 2;
+          if (block_rank(mid) <= group_in[i]) {
+            a[i] = mid;
+          } else {
+            b[i] = mid;
+          }
+        }
+      }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      m_block_rank_pairs.prefetch(a[i] * 2);
+      m_bits.prefetch(a[i] * block_size);
     }
-    select0_hints.push_back(num_blocks());
-    m_select0_hints.steal(select0_hints);
+    for (size_t i = 0; i < n; ++i) { out[begin + i] = select_in_block<Tier>(group_in[i], a[i]); }
   }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <span>
 #include <vector>
 
 #include "bit_vector.hpp"
@@ -12,9 +13,14 @@ class rs_bit_vector : public bit_vector {
  public:
   rs_bit_vector() : bit_vector() {}
 
+  // num_threads is the number of threads used to build the indices (0 means
+  // one per hardware thread); the result does not depend on it. The select
+  // inventories take precedence over the hints when both are built.
   template <class Range>
-  rs_bit_vector(Range const &from, bool with_select_hints = false, bool with_select0_hints = false) : bit_vector(from) {
-    build_indices(with_select_hints, with_select0_hints);
+  rs_bit_vector(Range const &from, bool with_select_hints = false, bool with_select0_hints = false,
+                size_t num_threads = 1, bool with_select_inventory = false, bool with_select0_inventory = false)
+    : bit_vector(from) {
+    build_indices(with_select_hints, with_select0_hints, num_threads, with_select_inventory, with_select0_inventory);
   }
 
   template <typename Visitor>
@@ -22,6 +28,8 @@ class rs_bit_vector : public bit_vector {
     bit_vector::map(visit);
     visit(m_block_rank_pairs, "m_block_rank_pairs")(m_select_hints, "m_select_hints")(m_select0_hints,
                                                                                       "m_select0_hints");
+    // the inventories are not in legacy files
+    visit.versioned(m_select_inventory, "m_select_inventory").versioned(m_select0_inventory, "m_select0_inventory");
   }
 
   void swap(rs_bit_vector &other) {
@@ -29,12 +37,22 @@ class rs_bit_vector : public bit_vector {
     m_block_rank_pairs.swap(other.m_block_rank_pairs);
     m_select_hints.swap(other.m_select_hints);
     m_select0_hints.swap(other.m_select0_hints);
+    m_select_inventory.swap(other.m_select_inventory);
+    m_select0_inventory.swap(other.m_select0_inventory);
   }
 
   inline uint64_t num_ones() const { return *(m_block_rank_pairs.end() - 2); }
 
   inline uint64_t num_zeros() const { return size() - num_ones(); }
 
+  // The queries dispatch once per call to the overloads templated on the
+  // kernel tier, which can also be called directly with a tier supported by
+  // the CPU (see broadword::dispatch_query)
+  inline uint64_t rank(uint64_t pos) const {
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return rank<Tier>(pos); });
+  }
+
+  template <broadword::kernel_tier Tier>
   inline uint64_t rank(uint64_t pos) const {
     assert(pos <= size());
     if (pos == size()) { return num_ones(); }
@@ -42,25 +60,22 @@ class rs_bit_vector : public bit_vector {
     uint64_t sub_block = pos / 64;
     uint64_t r         = sub_block_rank(sub_block);
     uint64_t sub_left  = pos % 64;
-    if (sub_left) { r += broadword::popcount(m_bits[sub_block] << (64 - sub_left)); }
+    if (sub_left) { r += broadword::popcount<Tier>(m_bits[sub_block] << (64 - sub_left)); }
     return r;
   }
 
   inline uint64_t rank0(uint64_t pos) const { return pos - rank(pos); }
 
   inline uint64_t select(uint64_t n) const {
-    using broadword::popcount;
-    using broadword::select_in_word;
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select<Tier>(n); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline uint64_t select(uint64_t n) const {
     assert(n < num_ones());
-    uint64_t a = 0;
-    uint64_t b = num_blocks();
-    if (m_select_hints.size()) {
-      uint64_t chunk = n / select_ones_per_hint;
-      if (chunk != 0) { a = m_select_hints[chunk - 1]; }
-      b = m_select_hints[chunk] + 1;
-    }
+    uint64_t a, b;
+    select_hint_range(n, a, b);
 
-    uint64_t block = 0;
     while (b - a > 1) {
       uint64_t mid = a + (b - a) / 2;
       uint64_t x   = block_rank(mid);
@@ -70,36 +85,20 @@ class rs_bit_vector : public bit_vector {
         b = mid;
       }
     }
-    block = a;
-
-    assert(block < num_blocks());
-    uint64_t block_offset = block * block_size;
-    uint64_t cur_rank     = block_rank(block);
-    assert(cur_rank <= n);
-
-    uint64_t rank_in_block_parallel = (n - cur_rank) * broadword::ones_step_9;
-    uint64_t sub_ranks              = sub_block_ranks(block);
-    uint64_t sub_block_offset =
-      broadword::uleq_step_9(sub_ranks, rank_in_block_parallel) * broadword::ones_step_9 >> 54 & 0x7;
-    cur_rank += sub_ranks >> (7 - sub_block_offset) * 9 & 0x1FF;
-    assert(cur_rank <= n);
 
-    uint64_t word_offset = block_offset + sub_block_offset;
-    return word_offset * 64 + select_in_word(m_bits[word_offset], n - cur_rank);
+    return select_in_block<Tier>(n, a);
   }
 
   // TODO(ot): share code between select and select0
   inline uint64_t select0(uint64_t n) const {
-    using broadword::popcount;
-    using broadword::select_in_word;
+    return broadword::dispatch_query([&]<broadword::kernel_tier Tier>() { return select0<Tier>(n); });
+  }
+
+  template <broadword::kernel_tier Tier>
+  inline uint64_t select0(uint64_t n) const {
     assert(n < num_zeros());
-    uint64_t a = 0;
-    uint64_t b = num_blocks();
-    if (m_select0_hints.size()) {
-      uint64_t chunk = n / select_zeros_per_hint;
-      if (chunk != 0) { a = m_select0_hints[chunk - 1]; }
-      b = m_select0_hints[chunk] + 1;
-    }
+    uint64_t a, b;
+    select0_hint_range(n, a, b);
 
     uint64_t block = 0;
     while (b - a > 1) {
@@ -126,10 +125,109 @@ class rs_bit_vector : public bit_vector {
     assert(cur_rank0 <= n);
 
     uint64_t word_offset = block_offset + sub_block_offset;
-    return word_offset * 64 + select_in_word(~m_bits[word_offset], n - cur_rank0);
+    return word_offset * 64 + broadword::select_in_word<Tier>(~m_bits[word_offset], n - cur_rank0);
   }
 
+  // Batched versions of rank() and select(): out[i] is set to the result for
+  // in[i]. Queries are processed in groups of batch_group_size, and all the
+  // cache lines needed by a group are prefetched before any of them is read,
+  // so that independent misses overlap instead of being serialized.
+  void rank_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+  void select_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+
  protected:
+  // Two-level select inventory in the spirit of rank9sel: for every
+  // ones_per_sample-th one (or zero) it records the block that contains it,
+  // as an absolute block index every ones_per_sample * samples_per_group
+  // and as a 16-bit offset from it in between. Two consecutive samples
+  // bound the block of any one in between, so select needs at most a
+  // search within sparse_sample_blocks blocks. The samples whose ones span
+  // more blocks than that, or too far from their group for an offset, are
+  // sparse: the blocks of all their ones are stored explicitly in
+  // m_sparse, as 16-bit offsets from the first one's block, or as absolute
+  // indices when the span does not fit 16 bits, so select goes straight to
+  // the block.
+  class select_inventory {
+   public:
+    template <typename Visitor>
+    void map(Visitor &visit) {
+      visit(m_groups, "m_groups")(m_offsets, "m_offsets")(m_sparse_bases, "m_sparse_bases")(m_sparse, "m_sparse");
+    }
+
+    void swap(select_inventory &other) {
+      m_groups.swap(other.m_groups);
+      m_offsets.swap(other.m_offsets);
+      m_sparse_bases.swap(other.m_sparse_bases);
+      m_sparse.swap(other.m_sparse);
+    }
+
+    inline uint64_t size() const { return m_offsets.size(); }
+
+    // [a, b) is the range of blocks that can contain the n-th one
+    inline void range(uint64_t n, uint64_t &a, uint64_t &b) const {
+      uint64_t sample = n / ones_per_sample;
+      uint16_t offset = m_offsets[sample];
+      if (offset >= sparse_offset) {
+        a = sparse_block(sample, n % ones_per_sample);
+        b = a + 1;
+        return;
+      }
+      a = m_groups[sample / samples_per_group] + offset;
+      b = (sample + 1 < m_offsets.size() ? first_block(sample + 1) : m_groups[m_groups.size() - 1]) + 1;
+    }
+
+    inline void prefetch(uint64_t n) const {
+      m_groups.prefetch(n / ones_per_sample / samples_per_group);
+      m_offsets.prefetch(n / ones_per_sample);
+    }
+
+    // BlockRank maps a block to the number of ones (or zeros) before it
+    template <typename BlockRank>
+    void build(BlockRank block_rank, uint64_t num_blocks, size_t num_threads);
+
+    static const uint64_t ones_per_sample      = 64;
+    static const uint64_t samples_per_group    = 8;
+    static const uint64_t sparse_sample_blocks = 16;
+    // offsets of the sparse samples, whose m_sparse record is the first
+    // one's block followed by 16-bit offsets (4 per word) or by the absolute
+    // blocks of the other ones
+    static const uint16_t sparse_offset = uint16_t(-2);
+    static const uint16_t spill_offset  = uint16_t(-1);
+
+   protected:
+    static inline uint64_t record_words(uint16_t offset) {
+      if (offset == sparse_offset) { return 1 + ones_per_sample / 4; }
+      return offset == spill_offset ? ones_per_sample : 0;
+    }
+
+    // the records of a group's sparse samples follow each other
+    inline uint64_t record(uint64_t sample) const {
+      uint64_t group = sample / samples_per_group;
+      uint64_t ret   = m_sparse_bases[group];
+      for (uint64_t s = group * samples_per_group; s < sample; ++s) { ret += record_words(m_offsets[s]); }
+      return ret;
+    }
+
+    inline uint64_t first_block(uint64_t sample) const {
+      uint16_t offset = m_offsets[sample];
+      if (offset >= sparse_offset) { return m_sparse[record(sample)]; }
+      return m_groups[sample / samples_per_group] + offset;
+    }
+
+    // block of the i-th one of a sparse sample
+    inline uint64_t sparse_block(uint64_t sample, uint64_t i) const {
+      uint64_t r = record(sample);
+      if (m_offsets[sample] == spill_offset) { return m_sparse[r + i]; }
+      return m_sparse[r] + (m_sparse[r + 1 + i / 4] >> (i % 4 * 16) & 0xFFFF);
+    }
+
+    mapper::mappable_vector<uint64_t> m_groups;
+    mapper::mappable_vector<uint16_t> m_offsets;
+    // first record of each group in m_sparse, empty if there are none
+    mapper::mappable_vector<uint64_t> m_sparse_bases;
+    mapper::mappable_vector<uint64_t> m_sparse;
+  };
+
   inline uint64_t num_blocks() const { return m_block_rank_pairs.size() / 2 - 1; }
 
   inline uint64_t block_rank(uint64_t block) const { return m_block_rank_pairs[block * 2]; }
@@ -147,15 +245,73 @@ class rs_bit_vector : public bit_vector {
 
   inline uint64_t block_rank0(uint64_t block) const { return block * block_size * 64 - m_block_rank_pairs[block * 2]; }
 
-  void build_indices(bool with_select_hints, bool with_select0_hints);
+  // [a, b) is the range of blocks that can contain the n-th one
+  inline void select_hint_range(uint64_t n, uint64_t &a, uint64_t &b) const {
+    if (m_select_inventory.size()) {
+      m_select_inventory.range(n, a, b);
+      return;
+    }
+    a = 0;
+    b = num_blocks();
+    if (m_select_hints.size()) {
+      uint64_t chunk = n / select_ones_per_hint;
+      if (chunk != 0) { a = m_select_hints[chunk - 1]; }
+      b = m_select_hints[chunk] + 1;
+    }
+  }
+
+  // [a, b) is the range of blocks that can contain the n-th zero
+  inline void select0_hint_range(uint64_t n, uint64_t &a, uint64_t &b) const {
+    if (m_select0_inventory.size()) {
+      m_select0_inventory.range(n, a, b);
+      return;
+    }
+    a = 0;
+    b = num_blocks();
+    if (m_select0_hints.size()) {
+      uint64_t chunk = n / select_zeros_per_hint;
+      if (chunk != 0) { a = m_select0_hints[chunk - 1]; }
+      b = m_select0_hints[chunk] + 1;
+    }
+  }
+
+  // position of the n-th one, given that it lies in the given block
+  template <broadword::kernel_tier Tier>
+  inline uint64_t select_in_block(uint64_t n, uint64_t block) const {
+    assert(block < num_blocks());
+    uint64_t block_offset = block * block_size;
+    uint64_t cur_rank     = block_rank(block);
+    assert(cur_rank <= n);
+
+    uint64_t rank_in_block_parallel = (n - cur_rank) * broadword::ones_step_9;
+    uint64_t sub_ranks              = sub_block_ranks(block);
+    uint64_t sub_block_offset =
+      broadword::uleq_step_9(sub_ranks, rank_in_block_parallel) * broadword::ones_step_9 >> 54 & 0x7;
+    cur_rank += sub_ranks >> (7 - sub_block_offset) * 9 & 0x1FF;
+    assert(cur_rank <= n);
+
+    uint64_t word_offset = block_offset + sub_block_offset;
+    return word_offset * 64 + broadword::select_in_word<Tier>(m_bits[word_offset], n - cur_rank);
+  }
+
+  template <broadword::kernel_tier Tier>
+  void rank_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+  template <broadword::kernel_tier Tier>
+  void select_batch(std::span<const uint64_t> in, std::span<uint64_t> out) const;
+
+  void build_indices(bool with_select_hints, bool with_select0_hints, size_t num_threads, bool with_select_inventory,
+                     bool with_select0_inventory);
 
   static const uint64_t block_size            = 8;                    // in 64bit words
   static const uint64_t select_ones_per_hint  = 64 * block_size * 2;  // must be > block_size * 64
   static const uint64_t select_zeros_per_hint = select_ones_per_hint;
+  static constexpr size_t batch_group_size    = 16;  // queries in flight in rank_batch/select_batch
 
   typedef mapper::mappable_vector<uint64_t> uint64_vec;
   uint64_vec m_block_rank_pairs;
   uint64_vec m_select_hints;
   uint64_vec m_select0_hints;
+  select_inventory m_select_inventory;
+  select_inventory m_select0_inventory;
 };
 }  // namespace succinct
@@ -5,6 +5,7 @@
 #include "mapper.hpp"
 
 #include <cstdlib>
+#include <sstream>
 
 TEST(bit_vector, bit_vector) {
   srand(42);
@@ -190,3 +191,50 @@ TEST(bit_vector, bvb_reverse) {
   test_bvb_reverse(1000);
   test_bvb_reverse(1024);
 }
+
+TEST(bit_vector, bit_vector_stream_builder) {
+  srand(42);
+
+  for (uint64_t flags : {0, int(succinct::mapper::freeze_flags::legacy_format)}) {
+    for (size_t n : {0, 1, 63, 64, 65, 1000, 10000}) {
+      // mix of single bits, short runs and long runs of zeros and ones
+      succinct::bit_vector_builder bvb;
+      std::vector<uint64_t> words;
+      std::ostringstream streamed;
+      succinct::mapper::stream_freezer out(streamed, succinct::mapper::layout_hash_of<succinct::bit_vector>(), flags);
+      succinct::bit_vector_stream_builder sbvb(out, n, [&](uint64_t w) { words.push_back(w); });
+      while (bvb.size() < n) {
+        uint64_t len = std::min<uint64_t>(n - bvb.size(), uint64_t(rand()) % 200);
+        switch (rand() % 4) {
+          case 0:
+            bvb.push_back(len % 2);
+            sbvb.push_back(len % 2);
+            break;
+          case 1: {
+            len        = std::min<uint64_t>(len, 64);
+            uint64_t b = uint64_t(rand()) & (len == 64 ? uint64_t(-1) : (uint64_t(1) << len) - 1);
+            bvb.append_bits(b, len);
+            sbvb.append_bits(b, len);
+            break;
+          }
+          case 2:
+            bvb.zero_extend(len);
+            sbvb.zero_extend(len);
+            break;
+          case 3:
+            bvb.one_extend(len);
+            sbvb.one_extend(len);
+            break;
+        }
+        ASSERT_EQ(bvb.size(), sbvb.size());
+      }
+      sbvb.finish();
+
+      succinct::bit_vector bitmap(&bvb);
+      ASSERT_TRUE(std::equal(words.begin(), words.end(), bitmap.data().begin(), bitmap.data().end()));
+      std::ostringstream frozen;
+      succinct::mapper::freeze(bitmap, frozen, flags);
+      ASSERT_EQ(frozen.str(), streamed.str());
+    }
+  }
+}
@@ -0,0 +1,182 @@
+#include "test_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <sstream>
+
+#include "bp_tree.hpp"
+#include "mapper.hpp"
+#include "test_bp_vector_common.hpp"
+
+// Pointer-based tree decoded from the parentheses, indexed by open position
+struct naive_tree {
+  naive_tree(std::vector<char> const &v)
+      : parent(v.size(), succinct::bp_tree::npos), close(v.size()), depth(v.size()), children(v.size()) {
+    std::vector<uint64_t> stack;
+    for (uint64_t i = 0; i < v.size(); ++i) {
+      if (v[i]) {
+        if (!stack.empty()) {
+          parent[i] = stack.back();
+          children[stack.back()].push_back(i);
+        }
+        depth[i] = stack.size();
+        preorder.push_back(i);
+        stack.push_back(i);
+      } else {
+        close[stack.back()] = i;
+        postorder.push_back(stack.back());
+        stack.pop_back();
+      }
+    }
+  }
+
+  uint64_t ancestor(uint64_t x, uint64_t d) const {
+    for (; d; --d) { x = parent[x]; }
+    return x;
+  }
+
+  uint64_t lca(uint64_t x, uint64_t y) const {
+    while (depth[x] > depth[y]) { x = parent[x]; }
+    while (depth[y] > depth[x]) { y = parent[y]; }
+    while (x != y) {
+      x = parent[x];
+      y = parent[y];
+    }
+    return x;
+  }
+
+  std::vector<uint64_t> parent;
+  std::vector<uint64_t> close;
+  std::vector<uint64_t> depth;
+  std::vector<std::vector<uint64_t>> children;
+  std::vector<uint64_t> preorder;
+  std::vector<uint64_t> postorder;
+};
+
+void test_tree(std::vector<char> const &v, succinct::bp_tree const &tree) {
+  const uint64_t npos = succinct::bp_tree::npos;
+  naive_tree naive(v);
+
+  ASSERT_EQ(naive.preorder.size(), tree.num_nodes());
+
+  for (uint64_t i = 0; i < naive.preorder.size(); ++i) {
+    uint64_t x = naive.preorder[i];
+    ASSERT_EQ(i, tree.preorder_rank(x)) << "node " << x;
+    ASSERT_EQ(x, tree.preorder_select(i)) << "rank " << i;
+    ASSERT_EQ(naive.postorder[i], tree.postorder_select(i)) << "rank " << i;
+
+    auto const &children = naive.children[x];
+    ASSERT_EQ(naive.parent[x], tree.parent(x)) << "node " << x;
+    ASSERT_EQ(naive.depth[x], tree.depth(x)) << "node " << x;
+    ASSERT_EQ((naive.close[x] - x + 1) / 2, tree.subtree_size(x)) << "node " << x;
+    ASSERT_EQ(children.empty(), tree.is_leaf(x)) << "node " << x;
+    ASSERT_EQ(children.empty() ? npos : children.front(), tree.first_child(x)) << "node " << x;
+    ASSERT_EQ(children.empty() ? npos : children.back(), tree.last_child(x)) << "node " << x;
+    ASSERT_EQ(children.size(), tree.child_count(x)) << "node " << x;
+    for (uint64_t c = 0; c < children.size(); ++c) {
+      ASSERT_EQ(children[c], tree.child(x, c)) << "node " << x;
+    }
+    ASSERT_EQ(npos, tree.child(x, children.size())) << "node " << x;
+
+    if (x) {
+      auto const &siblings = naive.children[naive.parent[x]];
+      size_t idx           = size_t(std::find(siblings.begin(), siblings.end(), x) - siblings.begin());
+      ASSERT_EQ(idx + 1 < siblings.size() ? siblings[idx + 1] : npos, tree.next_sibling(x)) << "node " << x;
+      ASSERT_EQ(idx ? siblings[idx - 1] : npos, tree.prev_sibling(x)) << "node " << x;
+    } else {
+      ASSERT_EQ(npos, tree.next_sibling(x));
+      ASSERT_EQ(npos, tree.prev_sibling(x));
+    }
+  }
+
+  for (uint64_t x = 0; x < v.size(); ++x) {
+    if (v[x]) { continue; }
+    uint64_t open = tree.find_open(x);
+    ASSERT_EQ(naive.postorder[tree.postorder_rank(open)], open) << "close " << x;
+  }
+
+  for (size_t i = 0; i < std::min<size_t>(naive.preorder.size(), 2000); ++i) {
+    uint64_t x = naive.preorder[size_t(rand()) % naive.preorder.size()];
+    uint64_t y = naive.preorder[size_t(rand()) % naive.preorder.size()];
+    ASSERT_EQ(naive.lca(x, y), tree.lca(x, y)) << "node " << x;
+    ASSERT_EQ(x, tree.lca(x, x)) << "node " << x;
+    ASSERT_EQ(naive.lca(x, y) == x, tree.is_ancestor(x, y)) << "node " << x;
+
+    uint64_t d = naive.depth[x] ? uint64_t(rand()) % (naive.depth[x] + 1) : 0;
+    ASSERT_EQ(naive.ancestor(x, d), tree.level_ancestor(x, d)) << "node " << x;
+    ASSERT_EQ(uint64_t(0), tree.level_ancestor(x, naive.depth[x])) << "node " << x;
+  }
+}
+
+TEST(bp_tree, navigation) {
+  srand(42);
+
+  {
+    std::vector<char> v;
+    succinct::random_bp(v, 100000);
+    succinct::bp_tree tree(v);
+    test_tree(v, tree);
+  }
+
+  {
+    size_t sizes[] = {2, 4, 512, 514, 8190, 8192, 8194, 16386};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      std::vector<char> v;
+      succinct::random_binary_tree(v, sizes[i]);
+      succinct::bp_tree tree(v);
+      test_tree(v, tree);
+
+      v.clear();
+      succinct::bp_path(v, sizes[i]);
+      succinct::bp_tree path(v);
+      test_tree(v, path);
+    }
+  }
+}
+
+// Nodes with many children, whose minima span several blocks and
+// superblocks of the min tree
+TEST(bp_tree, wide_nodes) {
+  using layout = succinct::bp_vector::min_tree_layout;
+  srand(42);
+
+  std::vector<std::vector<char>> inputs(2);
+  // a root with 100000 leaves
+  inputs[0].push_back(1);
+  for (size_t i = 0; i < 100000; ++i) {
+    inputs[0].push_back(1);
+    inputs[0].push_back(0);
+  }
+  inputs[0].push_back(0);
+  // a root with random subtrees of varying size
+  inputs[1].push_back(1);
+  for (size_t i = 0; i < 3000; ++i) { succinct::random_bp(inputs[1], size_t(rand()) % 200 + 2); }
+  inputs[1].push_back(0);
+
+  for (auto const &v : inputs) {
+    for (layout l : {layout::binary, layout::btree}) {
+      succinct::bp_tree tree(v, l);
+      ASSERT_TRUE(tree.has_min_counts());
+      test_tree(v, tree);
+    }
+  }
+}
+
+TEST(bp_tree, map) {
+  srand(42);
+  std::vector<char> v;
+  succinct::random_bp(v, 10000);
+  succinct::bp_tree tree(v);
+
+  std::ostringstream frozen;
+  succinct::mapper::freeze(tree, frozen);
+  std::string data = frozen.str();
+  std::vector<uint64_t> aligned(data.size() / 8 + 1);
+  std::memcpy(aligned.data(), data.data(), data.size());
+
+  succinct::bp_tree mapped;
+  succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+  test_tree(v, mapped);
+}
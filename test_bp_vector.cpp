@@ -4,7 +4,12 @@
 #include "mapper.hpp"
 #include "test_bp_vector_common.hpp"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <random>
+#include <span>
+#include <sstream>
 
 template <class BPVector>
 void test_parentheses(std::vector<char> const &v, BPVector const &bitmap) {
@@ -76,3 +81,313 @@ TEST(bp_vector, test) {
     }
   }
 }
+
+template <class BPVector>
+void test_searches(std::vector<char> const &v, BPVector const &bitmap) {
+  std::vector<int64_t> excess(v.size() + 1, 0);  // excess before each position
+  for (size_t i = 0; i < v.size(); ++i) { excess[i + 1] = excess[i] + (v[i] ? 1 : -1); }
+
+  for (size_t pos = 1; pos < v.size(); pos += 1 + size_t(rand()) % 61) {
+    for (int64_t d : {1, 2, 3, 63, 64, 65, 130, 1000, 5000}) {
+      if (d > excess[pos]) { break; }
+      uint64_t fwd = pos;
+      while (excess[fwd + 1] != excess[pos] - d) { ++fwd; }
+      ASSERT_EQ(fwd, bitmap.fwd_search(pos, succinct::bp_vector::excess_t(d)));
+
+      uint64_t bwd = pos - 1;
+      while (excess[bwd] != excess[pos] - d) { --bwd; }
+      ASSERT_EQ(bwd, bitmap.bwd_search(pos, succinct::bp_vector::excess_t(d)));
+    }
+  }
+}
+
+TEST(bp_vector, searches) {
+  srand(42);
+
+  {
+    std::vector<char> v;
+    succinct::random_bp(v, 100000);
+    succinct::bp_vector bitmap(v);
+    test_searches(v, bitmap);
+  }
+
+  {
+    size_t sizes[] = {2, 130, 512, 8192, 16386};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      std::vector<char> v;
+      succinct::bp_path(v, sizes[i]);
+      succinct::bp_path(v, sizes[i]);
+      succinct::bp_vector bitmap(v);
+      test_searches(v, bitmap);
+    }
+  }
+}
+
+template <class BPVector>
+void test_batches(std::vector<char> const &v, BPVector const &bitmap) {
+  std::vector<uint64_t> opens, closes;
+  for (uint64_t i = 0; i < v.size(); ++i) { (v[i] ? opens : closes).push_back(i); }
+  std::shuffle(opens.begin(), opens.end(), std::mt19937(42));
+  std::shuffle(closes.begin(), closes.end(), std::mt19937(43));
+
+  std::vector<uint64_t> out(opens.size());
+  bitmap.find_close_batch(opens, out);
+  for (size_t i = 0; i < opens.size(); ++i) { ASSERT_EQ(bitmap.find_close(opens[i]), out[i]) << opens[i]; }
+
+  out.resize(closes.size());
+  bitmap.find_open_batch(closes, out);
+  for (size_t i = 0; i < closes.size(); ++i) { ASSERT_EQ(bitmap.find_open(closes[i]), out[i]) << closes[i]; }
+}
+
+TEST(bp_vector, batches) {
+  srand(42);
+
+  {
+    std::vector<char> v;
+    succinct::random_bp(v, 100000);
+    succinct::bp_vector bitmap(v);
+    test_batches(v, bitmap);
+  }
+
+  {
+    size_t sizes[] = {2, 4, 512, 514, 8190, 8192, 8194, 16384, 16386, 100000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      std::vector<char> v;
+      succinct::random_binary_tree(v, sizes[i]);
+      succinct::bp_vector bitmap(v);
+      test_batches(v, bitmap);
+
+      v.clear();
+      succinct::bp_path(v, sizes[i]);
+      succinct::bp_path(v, sizes[i]);
+      succinct::bp_vector path(v);
+      test_batches(v, path);
+    }
+  }
+}
+
+TEST(bp_vector, btree_layout) {
+  using layout = succinct::bp_vector::min_tree_layout;
+  srand(42);
+
+  std::vector<std::vector<char>> inputs(3);
+  succinct::random_bp(inputs[0], 3000000);
+  succinct::bp_path(inputs[1], 1 << 22);
+  for (size_t i = 0; i < 40; ++i) { succinct::bp_path(inputs[2], 2 * (size_t(rand()) % 100000 + 1)); }
+
+  for (auto const &v : inputs) {
+    succinct::bp_vector binary(v);
+    succinct::bp_vector btree(v, false, false, layout::btree);
+    ASSERT_EQ(layout::binary, binary.layout());
+    ASSERT_EQ(layout::btree, btree.layout());
+
+    test_parentheses(v, btree);
+    test_batches(v, btree);
+
+    for (size_t t = 0; t < 10000; ++t) {
+      uint64_t pos                      = 1 + size_t(rand()) % (v.size() - 1);
+      succinct::bp_vector::excess_t exc = binary.excess(pos);
+      if (!exc) { continue; }
+      succinct::bp_vector::excess_t d = 1 + rand() % exc;
+      ASSERT_EQ(binary.fwd_search(pos, d), btree.fwd_search(pos, d)) << pos << " " << d;
+      ASSERT_EQ(binary.bwd_search(pos, d), btree.bwd_search(pos, d)) << pos << " " << d;
+    }
+
+    std::ostringstream frozen;
+    succinct::mapper::freeze(btree, frozen);
+    std::string data = frozen.str();
+    std::vector<uint64_t> aligned(data.size() / 8 + 1);
+    std::memcpy(aligned.data(), data.data(), data.size());
+
+    succinct::bp_vector mapped;
+    succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+    ASSERT_EQ(layout::btree, mapped.layout());
+    test_parentheses(v, mapped);
+  }
+}
+
+// bp_vector(v, true, true) frozen by the code that predates the versioned
+// format, with v drawn by legacy_bp() below
+static const uint64_t legacy_frozen[] = {
+  0x0000000000000000, 0x000000000000025e, 0x000000000000000a, 0xa6d09616b6f69d77, 0xb5e382d6f640ce55,
+  0x51c54a60445516fc, 0x15998bcde4bab2b7, 0xe8ead40ad9ac2b52, 0x7c3389e68c8b2d95, 0x147b6df5674b4c16,
+  0xa1fa9b597a5b69a0, 0x69a3179d2117180c, 0x00000000003bdb2c, 0x0000000000000006, 0x0000000000000000,
+  0x0908a6041a8984e4, 0x0000000000000106, 0x06c5229148a45229, 0x000000000000012f, 0x0000000000000000,
+  0x0000000000000001, 0x0000000000000002, 0x0000000000000001, 0x0000000000000002, 0x0000000000000001,
+  0x0000000000000003, 0x0002000000000000, 0x025e000000000000, 0x0000000000000000};
+static const size_t legacy_frozen_bytes = 230;
+
+std::vector<char> legacy_bp() {
+  std::vector<char> v;
+  uint64_t excess = 0, x = 1;
+  for (size_t i = 0; i < 600; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    v.push_back(excess == 0 || (x >> 63));
+    excess += v.back() ? 1 : -1;
+  }
+  v.resize(v.size() + excess, 0);
+  return v;
+}
+
+TEST(bp_vector, legacy_format) {
+  using layout        = succinct::bp_vector::min_tree_layout;
+  std::vector<char> v = legacy_bp();
+  std::span<const char> legacy(reinterpret_cast<const char *>(legacy_frozen), legacy_frozen_bytes);
+
+  // the btree layout cannot be written in the legacy format
+  succinct::bp_vector mapped(v, false, false, layout::btree);
+  succinct::bp_vector binary(v, true, true);
+  succinct::bp_vector btree(v, true, true, layout::btree);
+  test_legacy_format(
+    legacy, mapped,
+    [&](succinct::bp_vector const &bp) {
+      ASSERT_EQ(layout::binary, bp.layout());
+      test_parentheses(v, bp);
+    },
+    binary, btree);
+}
+
+TEST(bp_vector, parallel_build) {
+  using layout = succinct::bp_vector::min_tree_layout;
+  srand(42);
+
+  std::vector<std::vector<char>> inputs(3);
+  succinct::random_bp(inputs[0], 3000000);
+  succinct::bp_path(inputs[1], 1 << 21);
+  succinct::random_bp(inputs[2], 5000);  // below the per-thread minimum
+
+  for (auto const &v : inputs) {
+    for (layout l : {layout::binary, layout::btree}) {
+      succinct::bp_vector sequential(v, true, true, l);
+      std::ostringstream expected;
+      succinct::mapper::freeze(sequential, expected);
+
+      for (size_t num_threads : {2, 3, 4, 0}) {
+        succinct::bp_vector parallel(v, true, true, l, num_threads);
+        std::ostringstream frozen;
+        succinct::mapper::freeze(parallel, frozen);
+        ASSERT_EQ(expected.str(), frozen.str()) << num_threads;
+      }
+    }
+  }
+}
+
+TEST(bp_vector, min_counts) {
+  using layout = succinct::bp_vector::min_tree_layout;
+  using excess_t = succinct::bp_vector::excess_t;
+  srand(42);
+
+  std::vector<std::vector<char>> inputs(4);
+  succinct::random_bp(inputs[0], 1 << 20);
+  succinct::bp_path(inputs[1], 1 << 20);
+  for (size_t i = 0; i < 2000; ++i) { succinct::bp_path(inputs[2], 2 * (size_t(rand()) % 300 + 1)); }
+  for (size_t i = 0; i < 300000; ++i) {  // a star: the minimum is attained every other position
+    inputs[3].push_back(1);
+    inputs[3].push_back(0);
+  }
+
+  for (auto const &v : inputs) {
+    std::vector<excess_t> exc(v.size() + 1);
+    for (size_t i = 0; i < v.size(); ++i) { exc[i + 1] = exc[i] + (v[i] ? 1 : -1); }
+
+    for (layout l : {layout::binary, layout::btree}) {
+      succinct::bp_vector plain(v, false, false, l);
+      succinct::bp_vector bp(v, false, false, l, 1, true);
+      ASSERT_FALSE(plain.has_min_counts());
+      ASSERT_TRUE(bp.has_min_counts());
+
+      for (size_t t = 0; t < 2000; ++t) {
+        uint64_t a = size_t(rand()) % v.size();
+        uint64_t b = std::min<uint64_t>(v.size(), a + size_t(rand()) % (size_t(1) << (rand() % 21)));
+
+        excess_t min_exc = *std::min_element(exc.begin() + ptrdiff_t(a), exc.begin() + ptrdiff_t(b) + 1);
+        std::vector<uint64_t> minima;
+        for (uint64_t j = a + 1; j <= b; ++j) {
+          if (exc[j] == min_exc) { minima.push_back(j); }
+        }
+
+        excess_t count_min_exc;
+        ASSERT_EQ(minima.size(), bp.excess_min_count(a, b, count_min_exc)) << a << " " << b;
+        ASSERT_EQ(min_exc, count_min_exc) << a << " " << b;
+        for (size_t i = 0; i < std::min<size_t>(minima.size(), 4); ++i) {
+          ASSERT_EQ(minima[i], bp.excess_min_select(a, b, i)) << a << " " << b << " " << i;
+        }
+        if (!minima.empty()) {
+          size_t i = size_t(rand()) % minima.size();
+          ASSERT_EQ(minima[i], bp.excess_min_select(a, b, i)) << a << " " << b << " " << i;
+          ASSERT_EQ(minima.back(), bp.excess_min_select(a, b, minima.size() - 1)) << a << " " << b;
+        }
+        ASSERT_EQ(uint64_t(-1), bp.excess_min_select(a, b, minima.size())) << a << " " << b;
+      }
+
+      // the counts survive a freeze, and cannot be written in the legacy
+      // format
+      std::ostringstream frozen;
+      succinct::mapper::freeze(bp, frozen);
+      std::string data = frozen.str();
+      std::vector<uint64_t> aligned(data.size() / 8 + 1);
+      std::memcpy(aligned.data(), data.data(), data.size());
+      succinct::bp_vector mapped;
+      succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+      ASSERT_TRUE(mapped.has_min_counts());
+      excess_t min_exc;
+      ASSERT_EQ(bp.excess_min_count(0, v.size(), min_exc), mapped.excess_min_count(0, v.size(), min_exc));
+
+      std::ostringstream os;
+      ASSERT_THROW(succinct::mapper::freeze(bp, os, succinct::mapper::freeze_flags::legacy_format),
+                   succinct::mapper::format_error);
+
+      succinct::bp_vector parallel(v, false, false, l, 3, true);
+      std::ostringstream parallel_frozen;
+      succinct::mapper::freeze(parallel, parallel_frozen);
+      ASSERT_EQ(frozen.str(), parallel_frozen.str());
+    }
+  }
+}
+
+// Forwards the searches of test_parentheses with a given word kernel
+struct word_kernel_searches {
+  succinct::bp_vector const &bp;
+  succinct::bp_vector::word_kernel kernel;
+
+  size_t size() const { return bp.size(); }
+  uint64_t find_close(uint64_t pos) const { return bp.find_close(pos, kernel); }
+  uint64_t find_open(uint64_t pos) const { return bp.find_open(pos, kernel); }
+  uint64_t enclose(uint64_t pos) const { return find_open(pos); }
+};
+
+TEST(bp_vector, word_kernels) {
+  using word_kernel = succinct::bp_vector::word_kernel;
+
+  for (word_kernel kernel : {word_kernel::tables, word_kernel::broadword, word_kernel::avx512}) {
+    if (!succinct::bp_vector::word_kernel_supported(kernel)) {
+      succinct::bp_vector bitmap(std::vector<char>{1, 0});
+      ASSERT_THROW(bitmap.find_close(0, kernel), std::invalid_argument);
+      continue;
+    }
+    SCOPED_TRACE(int(kernel));
+
+    srand(42);
+    {
+      std::vector<char> v;
+      succinct::random_bp(v, 100000);
+      succinct::bp_vector bitmap(v);
+      test_parentheses(v, word_kernel_searches{bitmap, kernel});
+    }
+
+    {
+      size_t sizes[] = {2, 4, 512, 514, 8190, 8192, 8194};
+      for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::vector<char> v;
+        succinct::random_binary_tree(v, sizes[i]);
+        succinct::bp_vector bitmap(v);
+        test_parentheses(v, word_kernel_searches{bitmap, kernel});
+
+        v.clear();
+        succinct::bp_path(v, sizes[i]);
+        succinct::bp_vector path(v);
+        test_parentheses(v, word_kernel_searches{path, kernel});
+      }
+    }
+  }
+}
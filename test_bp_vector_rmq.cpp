@@ -1,5 +1,6 @@
 #include "test_common.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 
 #include "bp_vector.hpp"
@@ -86,3 +87,26 @@ TEST(bp_vector_rmq, test) {
     }
   }
 }
+
+TEST(bp_vector_rmq, btree_layout) {
+  srand(42);
+
+  std::vector<std::vector<char>> inputs(2);
+  succinct::random_bp(inputs[0], 3000000);
+  for (size_t i = 0; i < 40; ++i) { succinct::bp_path(inputs[1], 2 * (size_t(rand()) % 100000 + 1)); }
+
+  for (auto const &v : inputs) {
+    succinct::bp_vector binary(v);
+    succinct::bp_vector btree(v, false, false, succinct::bp_vector::min_tree_layout::btree);
+
+    for (size_t t = 0; t < 20000; ++t) {
+      uint64_t a = size_t(rand()) % v.size();
+      uint64_t b = a + size_t(rand()) % (v.size() - a);
+      if (t % 2) { b = std::min<uint64_t>(v.size() - 1, a + size_t(rand()) % 100000); }
+
+      succinct::bp_vector::excess_t binary_min, btree_min;
+      ASSERT_EQ(binary.excess_rmq(a, b, binary_min), btree.excess_rmq(a, b, btree_min)) << a << " " << b;
+      ASSERT_EQ(binary_min, btree_min);
+    }
+  }
+}
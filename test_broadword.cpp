@@ -0,0 +1,217 @@
+#include "test_common.hpp"
+
+#include <algorithm>
+#include <random>
+
+#include "broadword.hpp"
+
+std::vector<uint64_t> random_words(size_t n) {
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> words(n);
+  for (size_t i = 0; i < n; ++i) {
+    // mix dense, sparse and special words
+    switch (i % 4) {
+      case 0: words[i] = rng(); break;
+      case 1: words[i] = rng() & rng() & rng(); break;
+      case 2: words[i] = rng() | rng(); break;
+      default: words[i] = (i % 8 == 3) ? 0 : uint64_t(-1); break;
+    }
+  }
+  return words;
+}
+
+uint64_t naive_popcount(uint64_t x) {
+  uint64_t ret = 0;
+  for (size_t i = 0; i < 64; ++i) { ret += (x >> i) & 1; }
+  return ret;
+}
+
+TEST(test_broadword, popcount_select_in_word) {
+  std::vector<uint64_t> words = random_words(10000);
+  for (uint64_t w : words) {
+    ASSERT_EQ(naive_popcount(w), succinct::broadword::popcount(w));
+
+    uint64_t k = 0;
+    for (size_t i = 0; i < 64; ++i) {
+      if ((w >> i) & 1) { ASSERT_EQ(i, succinct::broadword::select_in_word(w, k++)); }
+    }
+  }
+}
+
+template <succinct::broadword::kernel_tier Tier>
+void test_scalar_kernels(std::vector<uint64_t> const &words) {
+  for (uint64_t w : words) {
+    ASSERT_EQ(naive_popcount(w), succinct::broadword::popcount<Tier>(w));
+
+    uint64_t k = 0;
+    for (size_t i = 0; i < 64; ++i) {
+      if ((w >> i) & 1) { ASSERT_EQ(i, succinct::broadword::select_in_word<Tier>(w, k++)); }
+    }
+  }
+}
+
+TEST(test_broadword, scalar_kernel_tiers) {
+  using succinct::broadword::kernel_tier;
+  std::vector<uint64_t> words = random_words(10000);
+  kernel_tier detected        = succinct::broadword::detected_kernel_tier();
+  ASSERT_LE(succinct::broadword::query_kernel_tier(), std::min(detected, kernel_tier::bmi2));
+
+  test_scalar_kernels<kernel_tier::generic>(words);
+  if (detected >= kernel_tier::popcnt) { test_scalar_kernels<kernel_tier::popcnt>(words); }
+  if (detected >= kernel_tier::bmi2) { test_scalar_kernels<kernel_tier::bmi2>(words); }
+}
+
+TEST(test_broadword, bulk_kernels) {
+  using succinct::broadword::kernel_tier;
+
+  // odd length, to exercise the tails of the vectorized kernels
+  std::vector<uint64_t> words = random_words(1001);
+  uint64_t expected_sum       = 0;
+  for (uint64_t w : words) { expected_sum += naive_popcount(w); }
+
+  kernel_tier tiers[] = {kernel_tier::generic, kernel_tier::popcnt, kernel_tier::bmi2, kernel_tier::avx2,
+                         kernel_tier::avx512};
+  for (kernel_tier tier : tiers) {
+    if (tier > succinct::broadword::detected_kernel_tier()) break;
+    SCOPED_TRACE(succinct::broadword::kernel_tier_name(tier));
+
+    std::vector<uint8_t> counts(words.size());
+    succinct::broadword::popcount_each(words.data(), words.size(), counts.data(), tier);
+    for (size_t i = 0; i < words.size(); ++i) { ASSERT_EQ(naive_popcount(words[i]), counts[i]); }
+
+    ASSERT_EQ(expected_sum, succinct::broadword::popcount_words(words.data(), words.size(), tier));
+    ASSERT_EQ(0U, succinct::broadword::popcount_words(words.data(), 0, tier));
+  }
+}
+
+TEST(test_broadword, unpack_bits_one_positions) {
+  using succinct::broadword::kernel_tier;
+
+  std::vector<uint64_t> words = random_words(1001);
+  uint64_t num_bits           = words.size() * 64;
+  auto get_bits               = [&](uint64_t pos, size_t width) {
+    uint64_t ret = 0;
+    for (size_t j = 0; j < width; ++j) { ret |= ((words[(pos + j) / 64] >> ((pos + j) % 64)) & 1) << j; }
+    return ret;
+  };
+  std::vector<uint64_t> ones;
+  for (uint64_t i = 0; i < num_bits; ++i) {
+    if ((words[i / 64] >> (i % 64)) & 1) { ones.push_back(i); }
+  }
+
+  kernel_tier tiers[] = {kernel_tier::generic, kernel_tier::popcnt, kernel_tier::bmi2, kernel_tier::avx2,
+                         kernel_tier::avx512};
+  for (kernel_tier tier : tiers) {
+    if (tier > succinct::broadword::detected_kernel_tier()) break;
+    SCOPED_TRACE(succinct::broadword::kernel_tier_name(tier));
+
+    for (size_t width : {0, 1, 7, 13, 31, 56, 57, 63, 64}) {
+      for (uint64_t offset : {0, 5, 64, 131}) {
+        // values running up to the very last bit of words
+        size_t n = width ? (num_bits - offset) / width : 100;
+        offset   = width ? num_bits - n * width : offset;
+        std::vector<uint64_t> out(n);
+        succinct::broadword::unpack_bits(words.data(), offset, width, n, out.data(), tier);
+        for (size_t i = 0; i < n; ++i) { ASSERT_EQ(get_bits(offset + i * width, width), out[i]); }
+      }
+    }
+
+    for (size_t start : {size_t(0), size_t(1), size_t(17), ones.size() / 2, ones.size() - 3}) {
+      for (size_t n : {1, 2, 9, 100, 5000}) {
+        n = std::min(n, ones.size() - start);
+        std::vector<uint64_t> out(n);
+        // start right after the previous one, to include the masking of the first word
+        uint64_t pos  = start ? ones[start - 1] + 1 : 0;
+        uint64_t last = succinct::broadword::one_positions(words.data(), pos, n, out.data(), tier);
+        ASSERT_EQ(ones[start + n - 1], last);
+        for (size_t i = 0; i < n; ++i) { ASSERT_EQ(ones[start + i], out[i]); }
+      }
+    }
+  }
+}
+
+TEST(test_broadword, count_less) {
+  using succinct::broadword::kernel_tier;
+
+  std::vector<uint64_t> values = random_words(1001);
+  std::vector<uint64_t> targets(values.begin(), values.begin() + 20);
+  targets.push_back(0);
+  targets.push_back(uint64_t(1) << 63);
+  targets.push_back(uint64_t(-1));
+
+  kernel_tier tiers[] = {kernel_tier::generic, kernel_tier::popcnt, kernel_tier::bmi2, kernel_tier::avx2,
+                         kernel_tier::avx512};
+  for (kernel_tier tier : tiers) {
+    if (tier > succinct::broadword::detected_kernel_tier()) break;
+    SCOPED_TRACE(succinct::broadword::kernel_tier_name(tier));
+
+    for (uint64_t x : targets) {
+      for (size_t n : {0, 1, 3, 8, 13, 1001}) {
+        uint64_t expected = 0;
+        for (size_t i = 0; i < n; ++i) { expected += values[i] < x; }
+        ASSERT_EQ(expected, succinct::broadword::count_less(values.data(), n, x, tier));
+      }
+    }
+  }
+}
+
+TEST(test_broadword, unpack_nibbles) {
+  using succinct::broadword::kernel_tier;
+
+  std::vector<uint64_t> words = random_words(40);
+  auto bytes                  = reinterpret_cast<uint8_t const *>(words.data());
+
+  kernel_tier tiers[] = {kernel_tier::generic, kernel_tier::popcnt, kernel_tier::bmi2, kernel_tier::avx2,
+                         kernel_tier::avx512};
+  for (kernel_tier tier : tiers) {
+    if (tier > succinct::broadword::detected_kernel_tier()) break;
+    SCOPED_TRACE(succinct::broadword::kernel_tier_name(tier));
+
+    std::vector<uint8_t> out(640);
+    for (uint64_t begin : {0, 1, 2, 31, 32, 33}) {
+      for (size_t n : {0, 1, 31, 32, 33, 64, 65, 600}) {
+        succinct::broadword::unpack_nibbles(bytes, begin, n, out.data(), tier);
+        for (size_t i = 0; i < n; ++i) {
+          uint64_t pos = begin + i;
+          ASSERT_EQ((bytes[pos / 2] >> ((pos % 2) * 4)) & 0x0F, out[i]) << "begin " << begin << " n " << n;
+        }
+      }
+    }
+  }
+}
+
+TEST(test_broadword, decode_stream_vbyte) {
+  using succinct::broadword::kernel_tier;
+
+  // random lengths from 1 to 4 bytes
+  std::vector<uint64_t> words = random_words(1001);
+  std::vector<uint32_t> values;
+  std::vector<uint8_t> control, data;
+  for (size_t i = 0; i < words.size(); ++i) {
+    size_t len   = words[i] % 4 + 1;
+    uint32_t val = uint32_t(words[i] >> 32) >> (32 - 8 * len);
+    if (i % 4 == 0) control.push_back(0);
+    control.back() |= uint8_t((len - 1) << (2 * (i % 4)));
+    for (size_t b = 0; b < len; ++b) { data.push_back(uint8_t(val >> (8 * b))); }
+    values.push_back(val);
+  }
+  data.resize(data.size() + 16);
+
+  kernel_tier tiers[] = {kernel_tier::generic, kernel_tier::popcnt, kernel_tier::bmi2, kernel_tier::avx2,
+                         kernel_tier::avx512};
+  for (kernel_tier tier : tiers) {
+    if (tier > succinct::broadword::detected_kernel_tier()) break;
+    SCOPED_TRACE(succinct::broadword::kernel_tier_name(tier));
+
+    std::vector<uint32_t> out(values.size());
+    for (size_t n : {0, 1, 3, 4, 5, 17, 1001}) {
+      uint64_t decoded  = succinct::broadword::decode_stream_vbyte(control.data(), data.data(), n, out.data(), tier);
+      uint64_t expected = 0;
+      for (size_t i = 0; i < n; ++i) {
+        ASSERT_EQ(values[i], out[i]) << "n " << n << " i " << i;
+        expected += size_t((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+      }
+      ASSERT_EQ(expected, decoded);
+    }
+  }
+}
@@ -3,7 +3,11 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <random>
+#include <span>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "cartesian_tree.hpp"
@@ -101,3 +105,141 @@ TEST(test_cartesian_tree, basic) {
     }
   }
 }
+
+template <typename T>
+std::string frozen_bytes(T &t) {
+  std::ostringstream os;
+  succinct::mapper::freeze(t, os);
+  return os.str();
+}
+
+TEST(test_cartesian_tree, parallel) {
+  std::mt19937 rng(42);
+  size_t n = 300000;
+
+  std::vector<std::vector<value_type>> inputs(5, std::vector<value_type>(n));
+  for (size_t i = 0; i < n; ++i) {
+    inputs[0][i] = rng();
+    inputs[1][i] = rng() % 4;  // many ties
+    inputs[2][i] = i;
+    inputs[3][i] = n - i;
+    inputs[4][i] = (i < n / 2) ? i : n - i;
+  }
+  inputs.push_back(std::vector<value_type>(1000, 7));  // below the per-thread minimum
+
+  for (auto &v : inputs) {
+    succinct::cartesian_tree less_seq(v);
+    succinct::cartesian_tree greater_seq(v, std::greater<value_type>());
+    for (size_t num_threads : {2, 3, 4, 0}) {
+      succinct::cartesian_tree less_par(v, std::less<value_type>(), num_threads);
+      ASSERT_EQ(frozen_bytes(less_seq), frozen_bytes(less_par)) << num_threads;
+      succinct::cartesian_tree greater_par(v, std::greater<value_type>(), num_threads);
+      ASSERT_EQ(frozen_bytes(greater_seq), frozen_bytes(greater_par)) << num_threads;
+    }
+  }
+}
+
+TEST(test_cartesian_tree, hybrid) {
+  using rmq_mode = succinct::cartesian_tree::rmq_mode;
+  std::mt19937 rng(42);
+  size_t n = 20000;
+
+  std::vector<std::vector<value_type>> inputs(4, std::vector<value_type>(n));
+  for (size_t i = 0; i < n; ++i) {
+    inputs[0][i] = rng() % 1024;
+    inputs[1][i] = rng() % 4;  // many ties
+    inputs[2][i] = i;
+    inputs[3][i] = (i < n / 2) ? i : n - i;
+  }
+  inputs.push_back(std::vector<value_type>(3, 7));
+
+  for (auto &v : inputs) {
+    succinct::cartesian_tree t(v, std::less<value_type>(), 1, rmq_mode::hybrid);
+    ASSERT_EQ(rmq_mode::hybrid, t.mode());
+    test_rmq(v, t, std::less<value_type>());
+
+    // the sequential constructors build the same tree
+    succinct::cartesian_tree seq(v, rmq_mode::hybrid);
+    succinct::cartesian_tree seq_comp(v, std::less<value_type>(), rmq_mode::hybrid);
+    ASSERT_EQ(frozen_bytes(t), frozen_bytes(seq));
+    ASSERT_EQ(frozen_bytes(t), frozen_bytes(seq_comp));
+
+    // every short range starting at a sparse set of positions
+    for (uint64_t a = 0; a < v.size(); a += 7) {
+      uint64_t min_idx = a;
+      for (uint64_t b = a; b < std::min<uint64_t>(v.size(), a + succinct::cartesian_tree::short_range_size + 8); ++b) {
+        if (v[b] < v[min_idx]) { min_idx = b; }
+        ASSERT_EQ(min_idx, t.rmq(a, b)) << a << " " << b;
+      }
+    }
+
+    // the hybrid mode only adds the short range index
+    succinct::cartesian_tree plain(v);
+    ASSERT_EQ(rmq_mode::succinct, plain.mode());
+    auto sizes       = succinct::mapper::size_tree_of(t);
+    auto plain_sizes = succinct::mapper::size_tree_of(plain);
+    ASSERT_EQ(2U, sizes->children.size());
+    ASSERT_EQ("m_short_range", sizes->children[1]->name);
+    ASSERT_EQ(plain_sizes->children[0]->size, sizes->children[0]->size);
+    ASSERT_LT(plain_sizes->children[1]->size, sizes->children[1]->size);
+    if (v.size() == n) { ASSERT_LT(sizes->children[1]->size * 8, n); }  // less than a bit per element
+  }
+
+  // A staircase ending with the minimum: the BP starts with a run of n
+  // ones, which short ranges near the end of the array run into, and the
+  // zero samples there are sparse
+  {
+    size_t stair_n = 1 << 18;
+    std::vector<value_type> v(stair_n);
+    for (size_t i = 0; i < stair_n; ++i) { v[i] = i + 1; }
+    v.back() = 0;
+    succinct::cartesian_tree t(v, rmq_mode::hybrid);
+    for (uint64_t a = stair_n - 2 * succinct::cartesian_tree::short_range_size; a < stair_n; ++a) {
+      for (uint64_t b = a; b < std::min<uint64_t>(stair_n, a + succinct::cartesian_tree::short_range_size); ++b) {
+        ASSERT_EQ(b == stair_n - 1 ? b : a, t.rmq(a, b)) << a << " " << b;
+      }
+    }
+    for (uint64_t a = 0; a < stair_n; a += 1001) {
+      uint64_t b = std::min<uint64_t>(stair_n - 1, a + 100);
+      ASSERT_EQ(b == stair_n - 1 ? b : a, t.rmq(a, b)) << a << " " << b;
+    }
+  }
+
+  // the index is mapped with the tree
+  succinct::cartesian_tree t(inputs[0], std::less<value_type>(), 1, rmq_mode::hybrid);
+  std::string data = frozen_bytes(t);
+  std::vector<uint64_t> aligned(data.size() / 8 + 1);
+  std::memcpy(aligned.data(), data.data(), data.size());
+  succinct::cartesian_tree mapped;
+  succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+  ASSERT_EQ(rmq_mode::hybrid, mapped.mode());
+  test_rmq(inputs[0], mapped, std::less<value_type>());
+}
+
+// cartesian_tree(v) frozen by the code that predates the versioned format,
+// with v[i] = i * 37 % 101 for 60 values
+static const uint64_t legacy_frozen[] = {
+  0x0000000000000000, 0x000000000000007a, 0x0000000000000002, 0x3c633f18c678c67f, 0x00318cf18c678c63,
+  0x0000000000000004, 0x0000000000000000, 0x08c7a3d1e8f47a3d, 0x000000000000003d, 0x0000000000000000,
+  0x0000000000000000, 0x0000000000000001, 0x0000000000000001, 0x0000000000000001, 0x0000000000000001,
+  0x0000000000020000, 0x00000000007a0000, 0x0000000000000000};
+static const size_t legacy_frozen_bytes = 138;
+
+TEST(test_cartesian_tree, legacy_format) {
+  using rmq_mode = succinct::cartesian_tree::rmq_mode;
+  std::vector<value_type> v(60);
+  for (size_t i = 0; i < v.size(); ++i) { v[i] = i * 37 % 101; }
+  std::span<const char> legacy(reinterpret_cast<const char *>(legacy_frozen), legacy_frozen_bytes);
+
+  // the short range index cannot be written in the legacy format
+  succinct::cartesian_tree mapped(v, std::less<value_type>(), 1, rmq_mode::hybrid);
+  succinct::cartesian_tree t(v);
+  succinct::cartesian_tree hybrid(v, std::less<value_type>(), 1, rmq_mode::hybrid);
+  test_legacy_format(
+    legacy, mapped,
+    [&](succinct::cartesian_tree const &tree) {
+      ASSERT_EQ(rmq_mode::succinct, tree.mode());
+      test_rmq(v, tree, std::less<value_type>());
+    },
+    t, hybrid);
+}
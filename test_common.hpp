@@ -3,11 +3,35 @@
 #include "gtest/gtest.h"
 
 #include <stdint.h>
+#include <span>
+#include <sstream>
 #include <stack>
+#include <string>
 #include <vector>
 
+#include "mapper.hpp"
+
 inline std::vector<bool> random_bit_vector(size_t n = 10000, double density = 0.5) {
   std::vector<bool> v;
   for (size_t i = 0; i < n; ++i) { v.push_back(rand() < (RAND_MAX * density)); }
   return v;
 }
+
+// Checks the compatibility of T with the format that predates the versioned
+// fields: the legacy frozen bytes map into mapped, dropping what it held,
+// and check(mapped) runs on the result; legacy, built without the versioned
+// fields, is frozen in the legacy format to the same bytes past the flags
+// word; extended, which uses them, cannot be frozen in the legacy format.
+template <typename T, typename Check>
+void test_legacy_format(std::span<const char> frozen, T &mapped, Check check, T &legacy, T &extended) {
+  ASSERT_EQ(frozen.size(), succinct::mapper::map(mapped, frozen));
+  check(mapped);
+
+  std::ostringstream os;
+  succinct::mapper::freeze(legacy, os, succinct::mapper::freeze_flags::legacy_format);
+  ASSERT_EQ(std::string(frozen.begin() + 8, frozen.end()), os.str().substr(8));
+
+  std::ostringstream extended_os;
+  ASSERT_THROW(succinct::mapper::freeze(extended, extended_os, succinct::mapper::freeze_flags::legacy_format),
+               succinct::mapper::format_error);
+}
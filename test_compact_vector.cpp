@@ -0,0 +1,119 @@
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <sstream>
+
+#include "compact_vector.hpp"
+#include "mapper.hpp"
+#include "topk_vector.hpp"
+
+std::vector<uint64_t> random_values(size_t n, uint64_t width) {
+  uint64_t mask = width == 64 ? uint64_t(-1) : (uint64_t(1) << width) - 1;
+  std::vector<uint64_t> v(n);
+  for (auto &x : v) { x = ((uint64_t(rand()) << 62) ^ (uint64_t(rand()) << 31) ^ uint64_t(rand())) & mask; }
+  return v;
+}
+
+TEST(test_compact_vector, widths) {
+  srand(42);
+  const size_t test_size = 1234;
+
+  for (uint64_t width = 1; width <= 64; ++width) {
+    std::vector<uint64_t> v = random_values(test_size, width);
+    succinct::compact_vector cv(v, width);
+
+    ASSERT_EQ(v.size(), cv.size());
+    ASSERT_EQ(width, cv.width());
+    for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], cv[i]) << "width " << width << " i " << i; }
+
+    // bulk unpack of ranges at every alignment
+    std::vector<uint64_t> out(v.size());
+    for (size_t begin : {0, 1, 3, 64, 100}) {
+      size_t n = v.size() - begin - size_t(rand()) % 10;
+      cv.get_range(begin, n, out.data());
+      for (size_t i = 0; i < n; ++i) { ASSERT_EQ(v[begin + i], out[i]) << "width " << width << " i " << begin + i; }
+    }
+  }
+}
+
+TEST(test_compact_vector, builder) {
+  srand(42);
+  std::vector<uint64_t> v = random_values(5000, 13);
+
+  succinct::compact_vector::builder b(13, v.size());
+  for (size_t i = 0; i < v.size(); ++i) { b.push_back(0); }
+  for (size_t i = 0; i < v.size(); ++i) { b.set(i, v[i]); }
+  succinct::compact_vector cv(&b);
+
+  ASSERT_EQ(v.size(), cv.size());
+  for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], cv[i]); }
+
+  // the implicit width fits the largest value
+  ASSERT_EQ(1U, succinct::compact_vector(std::vector<uint64_t>{0, 0}).width());
+  ASSERT_EQ(4U, succinct::compact_vector(std::vector<uint64_t>{3, 15, 0}).width());
+  ASSERT_EQ(64U, succinct::compact_vector(std::vector<uint64_t>{uint64_t(-1)}).width());
+  ASSERT_THROW(succinct::compact_vector::builder(0), std::invalid_argument);
+  ASSERT_THROW(succinct::compact_vector::builder(65), std::invalid_argument);
+}
+
+TEST(test_compact_vector, enumerator) {
+  srand(42);
+  for (uint64_t width : {1, 7, 32, 47, 64}) {
+    std::vector<uint64_t> v = random_values(3000, width);
+    succinct::compact_vector cv(v, width);
+
+    size_t pos = 0;
+    succinct::forward_enumerator<succinct::compact_vector> e(cv, pos);
+    std::vector<uint64_t> out(v.size());
+    while (pos < cv.size()) {
+      ASSERT_EQ(v[pos], e.next());
+      pos += 1;
+
+      size_t n = std::min(size_t(rand()) % 300, v.size() - pos);
+      e.decode(out.data(), n);
+      for (size_t i = 0; i < n; ++i) { ASSERT_EQ(v[pos + i], out[i]); }
+      pos += n;
+
+      if (rand() & 1) {
+        pos += size_t(rand()) % (cv.size() - pos + 1);
+        e = succinct::forward_enumerator<succinct::compact_vector>(cv, pos);
+      }
+    }
+  }
+}
+
+TEST(test_compact_vector, map) {
+  srand(42);
+  std::vector<uint64_t> v = random_values(5000, 21);
+  succinct::compact_vector cv(v);
+
+  std::ostringstream frozen;
+  succinct::mapper::freeze(cv, frozen);
+  std::string data = frozen.str();
+  std::vector<uint64_t> aligned(data.size() / 8 + 1);
+  std::memcpy(aligned.data(), data.data(), data.size());
+
+  succinct::compact_vector mapped;
+  succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+  ASSERT_EQ(cv.width(), mapped.width());
+  ASSERT_EQ(v.size(), mapped.size());
+  for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], mapped[i]); }
+}
+
+TEST(test_compact_vector, topk_vector) {
+  srand(42);
+  std::vector<uint64_t> v(10000);
+  for (auto &x : v) { x = size_t(rand()) % 1024; }
+
+  succinct::topk_vector<succinct::compact_vector> t(v);
+  ASSERT_EQ(v.size(), t.size());
+  for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], t[i]); }
+
+  auto found = t.topk(100, 5000, 10);
+  std::vector<uint64_t> expected(v.begin() + 100, v.begin() + 5001);
+  std::sort(expected.begin(), expected.end(), std::greater<uint64_t>());
+  ASSERT_EQ(10U, found.size());
+  for (size_t i = 0; i < found.size(); ++i) { ASSERT_EQ(expected[i], std::get<0>(found[i])); }
+}
@@ -3,9 +3,12 @@
 #include "test_rank_select_common.hpp"
 
 #include "darray.hpp"
+#include "darray64.hpp"
+#include "rank_darray.hpp"
 #include "mapper.hpp"
 
 #include <cstdlib>
+#include <sstream>
 
 void test_darray(std::vector<bool> const &v) {
   succinct::bit_vector bv(v);
@@ -69,3 +72,101 @@ TEST(test_darray, darray) {
     test_darray(v);
   }
 }
+
+void test_rank_darray(std::vector<bool> const &v) {
+  succinct::bit_vector bv(v);
+  succinct::rank_darray1 d1(bv);
+  succinct::rank_darray0 d0(bv);
+
+  size_t cur_rank  = 0;
+  size_t cur_rank0 = 0;
+  for (size_t i = 0; i < v.size(); ++i) {
+    ASSERT_EQ(cur_rank, d1.rank(bv, i));
+    ASSERT_EQ(cur_rank0, d0.rank(bv, i));
+    if (v[i]) {
+      ASSERT_EQ(i, d1.select(bv, cur_rank));
+      cur_rank += 1;
+    } else {
+      ASSERT_EQ(i, d0.select(bv, cur_rank0));
+      cur_rank0 += 1;
+    }
+  }
+
+  ASSERT_EQ(cur_rank, d1.rank(bv, v.size()));
+  ASSERT_EQ(cur_rank0, d0.rank(bv, v.size()));
+  ASSERT_EQ(cur_rank, d1.num_positions());
+  ASSERT_EQ(cur_rank0, d0.num_positions());
+}
+
+TEST(test_darray, rank_darray) {
+  srand(42);
+
+  // sizes around the block (512) and superblock (65536) boundaries
+  for (size_t n : {0, 1, 511, 512, 513, 65535, 65536, 65537, 200000}) {
+    for (double density : {0.5, 0.01, 0.99}) { test_rank_darray(random_bit_vector(n, density)); }
+  }
+  test_rank_darray(std::vector<bool>(70000, 1));
+  test_rank_darray(std::vector<bool>(70000, 0));
+}
+
+TEST(test_darray, darray64_stream_builder) {
+  srand(42);
+
+  for (size_t n_ones : {0, 1, 100, 5000}) {
+    succinct::darray64::builder b;
+    std::vector<size_t> skips;
+    uint64_t num_bits = 0;
+    for (size_t i = 0; i < n_ones; ++i) {
+      // mostly short gaps, some longer than a word
+      size_t skip = (rand() % 10) ? size_t(rand()) % 64 : size_t(rand()) % 1000;
+      skips.push_back(skip);
+      num_bits += skip + 1;
+      // the in-memory builder only takes skips of up to a word
+      if (skip > 64) {
+        b.bits.zero_extend(skip - 64);
+        b.append1(64);
+      } else {
+        b.append1(skip);
+      }
+    }
+
+    std::ostringstream streamed;
+    succinct::mapper::stream_freezer out(streamed, succinct::mapper::layout_hash_of<succinct::darray64>());
+    succinct::darray64::stream_builder sb(out, n_ones, num_bits);
+    for (size_t skip : skips) { sb.append1(skip); }
+    sb.finish();
+
+    succinct::darray64 d(&b);
+    std::ostringstream frozen;
+    succinct::mapper::freeze(d, frozen);
+    ASSERT_EQ(frozen.str(), streamed.str());
+  }
+}
+
+TEST(test_darray, parallel_build) {
+  srand(42);
+
+  // large enough to be split, with sparse stretches that give overflow blocks
+  size_t n = 1 << 21;
+  for (double density : {0.5, 0.001}) {
+    std::vector<bool> v = random_bit_vector(n, density);
+    for (size_t i = n / 2; i < n / 2 + (1 << 18); ++i) { v[i] = (i % 1000) == 0; }
+    succinct::bit_vector bv(v);
+
+    for (size_t num_threads : {2, 3, 8}) {
+      std::ostringstream sequential, parallel;
+      succinct::darray1 d1(bv);
+      succinct::darray1 pd1(bv, num_threads);
+      succinct::mapper::freeze(d1, sequential);
+      succinct::mapper::freeze(pd1, parallel);
+      ASSERT_EQ(sequential.str(), parallel.str());
+
+      std::ostringstream sequential0, parallel0;
+      succinct::darray0 d0(bv);
+      succinct::darray0 pd0(bv, num_threads);
+      succinct::mapper::freeze(d0, sequential0);
+      succinct::mapper::freeze(pd0, parallel0);
+      ASSERT_EQ(sequential0.str(), parallel0.str());
+    }
+  }
+}
@@ -2,8 +2,13 @@
 #include "test_rank_select_common.hpp"
 
 #include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <string>
 
 #include "elias_fano.hpp"
+#include "elias_fano_list.hpp"
 #include "mapper.hpp"
 
 TEST(test_elias_fano, basic) {
@@ -92,3 +97,209 @@ TEST(test_elias_fano, streaming) {
     ASSERT_TRUE(ef[val]);
   }
 }
+
+TEST(test_elias_fano, stream_builder) {
+  srand(42);
+
+  for (size_t N : {0, 1, 1000, 100000}) {
+    for (uint64_t universe_mul : {1, 3, 1000}) {
+      std::vector<uint64_t> v;
+      for (size_t i = 0; i < N; ++i) { v.push_back(uint64_t(rand()) % (N * universe_mul + 1)); }
+      std::sort(v.begin(), v.end());
+      uint64_t n = v.empty() ? 0 : v.back() + 1;
+
+      for (bool with_rank_index : {true, false}) {
+        succinct::elias_fano::elias_fano_builder build(n, v.size());
+        std::ostringstream streamed;
+        succinct::mapper::stream_freezer out(streamed, succinct::mapper::layout_hash_of<succinct::elias_fano>());
+        succinct::elias_fano::stream_builder sbuild(out, n, v.size(), with_rank_index);
+        for (auto x : v) {
+          build.push_back(x);
+          sbuild.push_back(x);
+        }
+        sbuild.finish();
+
+        succinct::elias_fano ef(&build, with_rank_index);
+        std::ostringstream frozen;
+        succinct::mapper::freeze(ef, frozen);
+        ASSERT_EQ(frozen.str(), streamed.str());
+
+        // the streamed data maps back to a working elias_fano
+        std::string data = streamed.str();
+        std::vector<uint64_t> aligned(data.size() / 8 + 1);
+        std::memcpy(aligned.data(), data.data(), data.size());
+        succinct::elias_fano mapped;
+        succinct::mapper::map(mapped,
+                              std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()),
+                              succinct::mapper::map_flags::verify_checksums);
+        ASSERT_EQ(v.size(), mapped.num_ones());
+        for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], mapped.select(i)); }
+      }
+    }
+  }
+}
+
+TEST(test_elias_fano, decode_block) {
+  srand(42);
+
+  for (size_t N : {1, 1000, 100000}) {
+    // universe_mul 1 gives repeated values and no low bits
+    for (uint64_t universe_mul : {1, 3, 1000}) {
+      std::vector<uint64_t> v;
+      for (size_t i = 0; i < N; ++i) { v.push_back(uint64_t(rand()) % (N * universe_mul + 1)); }
+      std::sort(v.begin(), v.end());
+
+      succinct::elias_fano::elias_fano_builder build(v.back() + 1, v.size());
+      for (auto x : v) { build.push_back(x); }
+      succinct::elias_fano ef(&build);
+
+      for (size_t start : {size_t(0), N / 3}) {
+        // alternate single next() calls and blocks of growing size
+        succinct::elias_fano::select_enumerator it(ef, start);
+        std::vector<uint64_t> out;
+        size_t i = start, block = 1;
+        while (i < N) {
+          ASSERT_EQ(v[i], it.next());
+          ++i;
+          size_t n = std::min(block, N - i);
+          out.resize(n);
+          it.decode_block(out.data(), n);
+          for (size_t k = 0; k < n; ++k) { ASSERT_EQ(v[i + k], out[k]); }
+          i += n;
+          block = block * 3 + 1;
+        }
+      }
+    }
+  }
+}
+
+TEST(test_elias_fano, next_geq_enumerator) {
+  srand(42);
+
+  for (size_t N : {1, 1000, 100000}) {
+    for (uint64_t universe_mul : {1, 3, 1000}) {
+      std::vector<uint64_t> v;
+      for (size_t i = 0; i < N; ++i) { v.push_back(uint64_t(rand()) % (N * universe_mul + 1)); }
+      std::sort(v.begin(), v.end());
+      uint64_t n = v.back() + 1;
+
+      for (bool with_rank_index : {true, false}) {
+        succinct::elias_fano::elias_fano_builder build(n, v.size());
+        for (auto x : v) { build.push_back(x); }
+        succinct::elias_fano ef(&build, with_rank_index);
+
+        // targets growing by short and long jumps, and repeated
+        for (uint64_t max_step : {n / 20000 + 1, n / 2000 + 10, n / 100 + 1, n / 4 + 1}) {
+          succinct::elias_fano::next_geq_enumerator it(ef);
+          for (uint64_t x = 0; x <= n + 1; x += uint64_t(rand()) % (max_step + 1)) {
+            auto lb = std::lower_bound(v.begin(), v.end(), x);
+            if (lb == v.end()) {
+              ASSERT_EQ(uint64_t(-1), it.next_geq(x));
+              ASSERT_EQ(v.size(), it.position());
+              break;
+            }
+            ASSERT_EQ(*lb, it.next_geq(x));
+            ASSERT_EQ(uint64_t(lb - v.begin()), it.position());
+          }
+        }
+      }
+    }
+  }
+
+  {
+    // Empty sequence
+    succinct::elias_fano::elias_fano_builder build(100, 0);
+    succinct::elias_fano ef(&build);
+    succinct::elias_fano::next_geq_enumerator it(ef);
+    ASSERT_EQ(uint64_t(-1), it.next_geq(0));
+  }
+}
+
+TEST(test_elias_fano, dense_buckets) {
+  srand(42);
+
+  // most of the values fall in a few buckets, with and without repetitions
+  for (uint64_t cluster : {uint64_t(320), uint64_t(5000)}) {
+    uint64_t n = uint64_t(1) << 20;
+    std::vector<uint64_t> v;
+    for (size_t i = 0; i < 10000; ++i) { v.push_back(uint64_t(rand()) % cluster); }
+    for (size_t i = 0; i < 10000; ++i) { v.push_back(uint64_t(rand()) % n); }
+    std::sort(v.begin(), v.end());
+
+    succinct::elias_fano::elias_fano_builder build(n, v.size());
+    for (auto x : v) { build.push_back(x); }
+    succinct::elias_fano ef(&build);
+
+    for (uint64_t x = 0; x < cluster + 100; ++x) {
+      uint64_t expected = uint64_t(std::lower_bound(v.begin(), v.end(), x) - v.begin());
+      ASSERT_EQ(expected, ef.rank(x));
+      ASSERT_EQ(std::binary_search(v.begin(), v.end(), x), ef[x]);
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+      uint64_t x        = uint64_t(rand()) % n;
+      uint64_t expected = uint64_t(std::lower_bound(v.begin(), v.end(), x) - v.begin());
+      ASSERT_EQ(expected, ef.rank(x));
+      ASSERT_EQ(std::binary_search(v.begin(), v.end(), x), ef[x]);
+    }
+  }
+}
+
+TEST(test_elias_fano, parallel_build) {
+  srand(42);
+
+  for (size_t N : {0, 1, 1000, 1000000}) {
+    for (uint64_t universe_mul : {1, 3, 1000}) {
+      std::vector<uint64_t> v;
+      for (size_t i = 0; i < N; ++i) { v.push_back(uint64_t(rand()) % (N * universe_mul + 1)); }
+      std::sort(v.begin(), v.end());
+      uint64_t n = v.empty() ? 0 : v.back() + 1;
+
+      for (bool with_rank_index : {true, false}) {
+        succinct::elias_fano::elias_fano_builder build(n, v.size());
+        for (auto x : v) { build.push_back(x); }
+        succinct::elias_fano ef(&build, with_rank_index);
+        std::ostringstream expected;
+        succinct::mapper::freeze(ef, expected);
+
+        for (size_t num_threads : {1, 4, 7}) {
+          succinct::elias_fano pef(v, n, with_rank_index, num_threads);
+          std::ostringstream frozen;
+          succinct::mapper::freeze(pef, frozen);
+          ASSERT_EQ(expected.str(), frozen.str());
+        }
+      }
+    }
+  }
+}
+
+TEST(test_elias_fano, large_gaps) {
+  srand(42);
+
+  // clusters separated by runs of zeros in the high bits much longer than
+  // a word, in both directions
+  std::vector<uint64_t> v;
+  uint64_t base = 0;
+  for (size_t cluster = 0; cluster < 20; ++cluster) {
+    size_t cluster_size = (cluster % 3 == 0) ? 1 : 500;
+    for (size_t i = 0; i < cluster_size; ++i) { v.push_back(base + uint64_t(rand()) % 1000); }
+    base += uint64_t(1) << (20 + cluster % 5 * 5);
+  }
+  std::sort(v.begin(), v.end());
+
+  succinct::elias_fano::elias_fano_builder build(v.back() + 1, v.size());
+  for (auto x : v) { build.push_back(x); }
+  succinct::elias_fano ef(&build);
+
+  test_delta(ef);
+  for (size_t i = 0; i + 1 < v.size(); ++i) {
+    auto [first, second] = ef.select_range(i);
+    ASSERT_EQ(v[i], first);
+    ASSERT_EQ(v[i + 1], second);
+  }
+
+  std::vector<uint64_t> gaps(v.size());
+  std::adjacent_difference(v.begin(), v.end(), gaps.begin());
+  succinct::elias_fano_list list(gaps);
+  ASSERT_EQ(gaps.size(), list.size());
+  for (size_t i = 0; i < gaps.size(); ++i) { ASSERT_EQ(gaps[i], list[i]); }
+}
@@ -0,0 +1,68 @@
+#include "elias_fano_list.hpp"
+#include "test_common.hpp"
+
+#include <cstdlib>
+
+std::vector<uint64_t> random_gaps(size_t test_size) {
+  std::vector<uint64_t> v;
+  for (size_t i = 0; i < test_size; ++i) {
+    if (rand() < (RAND_MAX / 3)) {
+      v.push_back(0);
+    } else {
+      v.push_back(size_t(rand()) % 1000);
+    }
+  }
+  return v;
+}
+
+TEST(test_elias_fano_list, basic) {
+  srand(42);
+  std::vector<uint64_t> v = random_gaps(12345);
+
+  succinct::elias_fano_list vv(v);
+
+  ASSERT_EQ(v.size(), vv.size());
+  for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], vv[i]); }
+}
+
+TEST(test_elias_fano_list, enumerator) {
+  srand(42);
+  std::vector<uint64_t> v = random_gaps(12345);
+
+  succinct::elias_fano_list vv(v);
+
+  size_t pos = 0;
+  succinct::forward_enumerator<succinct::elias_fano_list> e(vv, pos);
+  while (pos < vv.size()) {
+    ASSERT_EQ(v[pos], e.next());
+    pos += 1;
+
+    size_t step = uint64_t(rand()) % (vv.size() - pos + 1);
+    pos += step;
+    e = succinct::forward_enumerator<succinct::elias_fano_list>(vv, pos);
+  }
+}
+
+TEST(test_elias_fano_list, decode) {
+  srand(42);
+  std::vector<uint64_t> v = random_gaps(12345);
+
+  succinct::elias_fano_list vv(v);
+
+  std::vector<uint64_t> out(v.size());
+  for (size_t start : {size_t(0), size_t(1), size_t(1000), v.size() - 300}) {
+    succinct::forward_enumerator<succinct::elias_fano_list> e(vv, start);
+    size_t pos = start;
+    // mix block sizes and single steps
+    for (size_t n : {1, 7, 0, 300, 1, 2000}) {
+      n = std::min(n, v.size() - pos);
+      e.decode(out.data(), n);
+      for (size_t i = 0; i < n; ++i) { ASSERT_EQ(v[pos + i], out[i]) << "start " << start << " pos " << pos + i; }
+      pos += n;
+      if (pos < v.size()) {
+        ASSERT_EQ(v[pos], e.next());
+        pos += 1;
+      }
+    }
+  }
+}
@@ -56,3 +56,68 @@ TEST(test_gamma_vector, gamma_enumerator) {
     i += 1;
   }
 }
+
+TEST(test_gamma_vector, skip) {
+  srand(42);
+  const size_t test_size = 12345;
+  std::vector<uint64_t> v;
+
+  for (size_t i = 0; i < test_size; ++i) {
+    if (rand() < (RAND_MAX / 3)) {
+      v.push_back(0);
+    } else {
+      v.push_back(uint64_t(rand()));
+    }
+  }
+
+  succinct::gamma_vector vv(v);
+
+  // alternate short skips, scanned, and long ones, resolved with select
+  size_t pos = 0;
+  succinct::forward_enumerator<succinct::gamma_vector> e(vv, pos);
+  while (pos < vv.size()) {
+    ASSERT_EQ(v[pos], e.next());
+    pos += 1;
+
+    size_t max_step = (rand() & 1) ? 16 : 1000;
+    size_t step     = std::min(uint64_t(rand()) % max_step, uint64_t(vv.size() - pos));
+    e.skip(step);
+    pos += step;
+  }
+}
+
+TEST(test_gamma_vector, next_block) {
+  srand(42);
+  const size_t test_size = 12345;
+  std::vector<uint64_t> v;
+
+  for (size_t i = 0; i < test_size; ++i) {
+    if (rand() < (RAND_MAX / 3)) {
+      v.push_back(0);
+    } else {
+      v.push_back(uint64_t(rand()));
+    }
+  }
+
+  succinct::gamma_vector vv(v);
+
+  std::vector<uint64_t> out(v.size());
+  for (size_t start : {size_t(0), size_t(1), size_t(1000), v.size() - 300}) {
+    succinct::forward_enumerator<succinct::gamma_vector> e(vv, start);
+    size_t pos = start;
+    // mix blocks with single steps and skips
+    for (size_t n : {1, 7, 0, 300, 1, 2000}) {
+      n = std::min(n, v.size() - pos);
+      e.next_block(out.data(), n);
+      for (size_t i = 0; i < n; ++i) { ASSERT_EQ(v[pos + i], out[i]) << "start " << start << " pos " << pos + i; }
+      pos += n;
+      if (pos < v.size()) {
+        ASSERT_EQ(v[pos], e.next());
+        pos += 1;
+      }
+      size_t step = std::min(size_t(200), v.size() - pos);
+      e.skip(step);
+      pos += step;
+    }
+  }
+}
@@ -1,7 +1,13 @@
 #include "test_common.hpp"
 
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
 
+#include "mapped_file.hpp"
 #include "mapper.hpp"
 
 TEST(test_mapper, basic_map) {
@@ -46,3 +52,153 @@ TEST(test_mapper, complex_struct_map) {
   ASSERT_EQ(0, mapped_s.m_a);
   ASSERT_EQ(0U, mapped_s.m_b.size());
 }
+
+TEST(test_mapper, mapped_file) {
+  complex_struct s;
+  s.init();
+  succinct::mapper::freeze(s, "temp.bin");
+
+  for (uint64_t advice : {0, 1, 2, 4, 8, 1 | 4 | 8}) {
+    for (auto warmup : {succinct::mapper::warmup_mode::none, succinct::mapper::warmup_mode::parallel,
+                        succinct::mapper::warmup_mode::async}) {
+      succinct::mapper::mapped_file<complex_struct> mapped("temp.bin", advice, warmup, 2);
+      ASSERT_TRUE(mapped.verify_checksums());
+      ASSERT_EQ(42U, mapped->m_a);
+      ASSERT_EQ(2U, mapped->m_b.size());
+      ASSERT_EQ(1U, mapped->m_b[0]);
+      ASSERT_EQ(2U, mapped->m_b[1]);
+    }
+  }
+
+  ASSERT_THROW(succinct::mapper::mapped_file<complex_struct>("temp.bin", succinct::mapper::advice_flags::random |
+                                                                           succinct::mapper::advice_flags::sequential),
+               std::invalid_argument);
+  ASSERT_THROW(succinct::mapper::mapped_file<complex_struct>("nonexistent.bin"), std::runtime_error);
+}
+
+TEST(test_mapper, mapped_file_warmup) {
+  // spans many pages, so that the warm-up is split across threads
+  std::vector<uint64_t> v(1 << 20);
+  for (size_t i = 0; i < v.size(); ++i) { v[i] = i * i; }
+  succinct::mapper::mappable_vector<uint64_t> vec;
+  vec.assign(v);
+  succinct::mapper::freeze(vec, "temp.bin");
+
+  for (auto warmup : {succinct::mapper::warmup_mode::parallel, succinct::mapper::warmup_mode::async}) {
+    succinct::mapper::mapped_file<succinct::mapper::mappable_vector<uint64_t>> mapped(
+      "temp.bin", succinct::mapper::advice_flags::sequential, warmup, 4);
+    mapped.wait_warmup();
+    ASSERT_EQ(v.size(), mapped->size());
+    for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], (*mapped)[i]); }
+  }
+
+  // destroying the mapping while an async warm-up is still running
+  succinct::mapper::mapped_file<succinct::mapper::mappable_vector<uint64_t>> mapped(
+    "temp.bin", 0, succinct::mapper::warmup_mode::async);
+  ASSERT_EQ(v.size(), mapped->size());
+}
+
+class aligned_buffer {
+ public:
+  aligned_buffer(const char *filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    m_words.resize(contents.size() / 8 + 512);
+    m_data = reinterpret_cast<char *>(m_words.data());
+    m_data += succinct::mapper::detail::padding(reinterpret_cast<uintptr_t>(m_data), 4096);
+    std::memcpy(m_data, contents.data(), contents.size());
+    m_size = contents.size();
+  }
+
+  std::span<const char> span() const { return std::span<const char>(m_data, m_size); }
+
+  char *m_data;
+  size_t m_size;
+
+ private:
+  std::vector<uint64_t> m_words;
+};
+
+TEST(test_mapper, aligned_format) {
+  complex_struct s;
+  s.init();
+
+  for (uint64_t flags : {0, int(succinct::mapper::freeze_flags::page_aligned)}) {
+    size_t written = succinct::mapper::freeze(s, "temp.bin", flags);
+    aligned_buffer buf("temp.bin");
+    ASSERT_EQ(written, buf.m_size);
+
+    complex_struct mapped_s;
+    std::vector<succinct::mapper::frozen_section> sections;
+    ASSERT_EQ(written, succinct::mapper::map(mapped_s, buf.span(), succinct::mapper::map_flags::verify_checksums,
+                                             &sections));
+    ASSERT_EQ(42U, mapped_s.m_a);
+    ASSERT_EQ(2U, mapped_s.m_b.size());
+    ASSERT_EQ(1U, mapped_s.m_b[0]);
+    ASSERT_EQ(2U, mapped_s.m_b[1]);
+    uint64_t alignment = (flags & succinct::mapper::freeze_flags::page_aligned) ? 4096 : 64;
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(mapped_s.m_b.data()) % alignment);
+    ASSERT_EQ(1U, sections.size());
+    ASSERT_TRUE(succinct::mapper::verify_sections(sections));
+
+    // the unchecked overload reads the same data
+    complex_struct unchecked_s;
+    ASSERT_EQ(written, succinct::mapper::map(unchecked_s, buf.m_data));
+    ASSERT_EQ(mapped_s.m_b.data(), unchecked_s.m_b.data());
+  }
+}
+
+TEST(test_mapper, legacy_format) {
+  complex_struct s;
+  s.init();
+  size_t written = succinct::mapper::freeze(s, "temp.bin", succinct::mapper::freeze_flags::legacy_format);
+  ASSERT_EQ(8 + succinct::mapper::size_of(s), written);  // flags word + payload
+
+  aligned_buffer buf("temp.bin");
+  complex_struct mapped_s;
+  std::vector<succinct::mapper::frozen_section> sections;
+  ASSERT_EQ(written, succinct::mapper::map(mapped_s, buf.span(), 0, &sections));
+  ASSERT_EQ(42U, mapped_s.m_a);
+  ASSERT_EQ(2U, mapped_s.m_b.size());
+  ASSERT_EQ(2U, mapped_s.m_b[1]);
+  ASSERT_TRUE(sections.empty());  // no checksums to verify
+}
+
+TEST(test_mapper, corrupt_data) {
+  complex_struct s;
+  s.init();
+  size_t written = succinct::mapper::freeze(s, "temp.bin");
+  aligned_buffer buf("temp.bin");
+
+  // every truncation is detected
+  for (size_t len = 0; len < written; ++len) {
+    complex_struct mapped_s;
+    ASSERT_THROW(succinct::mapper::map(mapped_s, buf.span().first(len)), succinct::mapper::format_error);
+  }
+
+  // a different type has a different layout hash
+  succinct::mapper::mappable_vector<uint32_t> wrong_type;
+  ASSERT_THROW(succinct::mapper::map(wrong_type, buf.span()), succinct::mapper::format_error);
+
+  // flipping a payload bit is caught eagerly or lazily
+  buf.m_data[written - 9] ^= 1;
+  complex_struct mapped_s;
+  ASSERT_THROW(succinct::mapper::map(mapped_s, buf.span(), succinct::mapper::map_flags::verify_checksums),
+               succinct::mapper::format_error);
+  std::vector<succinct::mapper::frozen_section> sections;
+  succinct::mapper::map(mapped_s, buf.span(), 0, &sections);
+  ASSERT_FALSE(succinct::mapper::verify_sections(sections));
+}
+
+TEST(test_mapper, checksum_streaming) {
+  std::vector<char> data(1000);
+  for (size_t i = 0; i < data.size(); ++i) { data[i] = char(i * 7 + 3); }
+  uint64_t expected = succinct::mapper::detail::checksum(data.data(), data.size());
+
+  for (size_t step : {1, 3, 7, 8, 13, 64}) {
+    succinct::mapper::detail::checksum64 c;
+    for (size_t i = 0; i < data.size(); i += step) { c.update(data.data() + i, std::min(step, data.size() - i)); }
+    ASSERT_EQ(expected, c.digest());
+  }
+  ASSERT_NE(expected, succinct::mapper::detail::checksum(data.data(), data.size() - 1));
+}
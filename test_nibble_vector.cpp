@@ -0,0 +1,72 @@
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <sstream>
+
+#include "mapper.hpp"
+#include "nibble_vector.hpp"
+
+std::vector<uint8_t> random_nibbles(size_t n) {
+  std::vector<uint8_t> v(n);
+  for (auto &x : v) { x = uint8_t(rand() % 16); }
+  return v;
+}
+
+TEST(test_nibble_vector, basic) {
+  srand(42);
+  for (size_t n : {0, 1, 2, 12345}) {
+    std::vector<uint8_t> v = random_nibbles(n);
+    succinct::nibble_vector nv(v);
+
+    ASSERT_EQ(v.size(), nv.size());
+    for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], nv[i]); }
+  }
+}
+
+TEST(test_nibble_vector, get_range) {
+  srand(42);
+  std::vector<uint8_t> v = random_nibbles(12345);
+  succinct::nibble_vector nv(v);
+
+  std::vector<uint8_t> out(v.size());
+  for (size_t i = 0; i < 100; ++i) {
+    uint64_t begin = uint64_t(rand()) % v.size();
+    size_t n       = size_t(rand()) % (v.size() - begin + 1);
+    nv.get_range(begin, n, out.data());
+    for (size_t j = 0; j < n; ++j) { ASSERT_EQ(v[begin + j], out[j]) << "begin " << begin << " j " << j; }
+  }
+}
+
+TEST(test_nibble_vector, stream_builder) {
+  srand(42);
+  for (size_t n : {0, 1, 12345, 20000}) {
+    std::vector<uint8_t> v = random_nibbles(n);
+
+    succinct::nibble_vector::builder b(n);
+    std::ostringstream streamed;
+    succinct::mapper::stream_freezer out(streamed, succinct::mapper::layout_hash_of<succinct::nibble_vector>());
+    succinct::nibble_vector::stream_builder sb(out, n);
+    for (auto x : v) {
+      b.push_back(x);
+      sb.push_back(x);
+    }
+    sb.finish();
+
+    succinct::nibble_vector nv(&b);
+    std::ostringstream frozen;
+    succinct::mapper::freeze(nv, frozen);
+    ASSERT_EQ(frozen.str(), streamed.str());
+
+    // the streamed data maps back to a working nibble_vector
+    std::string data = streamed.str();
+    std::vector<uint64_t> aligned(data.size() / 8 + 1);
+    std::memcpy(aligned.data(), data.data(), data.size());
+    succinct::nibble_vector mapped;
+    succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()),
+                          succinct::mapper::map_flags::verify_checksums);
+    ASSERT_EQ(v.size(), mapped.size());
+    for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], mapped[i]); }
+  }
+}
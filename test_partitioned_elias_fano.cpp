@@ -0,0 +1,115 @@
+#include "test_common.hpp"
+#include "test_rank_select_common.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "mapper.hpp"
+#include "partitioned_elias_fano.hpp"
+
+TEST(test_partitioned_elias_fano, basic) {
+  srand(42);
+  size_t N = 10000;
+
+  {
+    // Random bitmap; dense ones give bitmap chunks, sparse ones EF chunks
+    for (size_t d = 0; d < 8; ++d) {
+      double density      = 1.0 / (1 << d);
+      std::vector<bool> v = random_bit_vector(N, density);
+
+      succinct::bit_vector_builder bvb;
+      for (size_t i = 0; i < v.size(); ++i) { bvb.push_back(v[i]); }
+
+      succinct::partitioned_elias_fano bitmap(&bvb);
+      test_equal_bits(v, bitmap);
+      test_rank_select1(v, bitmap);
+      test_delta(bitmap);
+      test_select_enumeration(v, bitmap);
+    }
+  }
+
+  {
+    // Clustered: runs, dense and sparse stretches
+    std::vector<bool> v(N);
+    for (size_t i = 0; i < N; ++i) {
+      if (i < 1000) {
+        v[i] = true;
+      } else if (i < 3000) {
+        v[i] = rand() % 2;
+      } else if (i > 9000) {
+        v[i] = rand() % 100 == 0;
+      }
+    }
+    succinct::bit_vector_builder bvb;
+    for (size_t i = 0; i < v.size(); ++i) { bvb.push_back(v[i]); }
+    succinct::partitioned_elias_fano bitmap(&bvb);
+    test_equal_bits(v, bitmap);
+    test_rank_select1(v, bitmap);
+    test_select_enumeration(v, bitmap);
+  }
+
+  {
+    // Empty bitmap
+    succinct::bit_vector_builder bvb(N);
+    succinct::partitioned_elias_fano bitmap(&bvb);
+    ASSERT_EQ(0U, bitmap.num_ones());
+    test_equal_bits(std::vector<bool>(N), bitmap);
+    test_select_enumeration(std::vector<bool>(N), bitmap);
+  }
+
+  {
+    // Only one value
+    std::vector<bool> v(N);
+    succinct::bit_vector_builder bvb(N);
+    bvb.set(37, 1);
+    v[37] = 1;
+    succinct::partitioned_elias_fano bitmap(&bvb);
+    test_equal_bits(v, bitmap);
+    test_rank_select1(v, bitmap);
+    test_select_enumeration(v, bitmap);
+    ASSERT_EQ(1U, bitmap.num_ones());
+  }
+}
+
+TEST(test_partitioned_elias_fano, repeated_values) {
+  srand(42);
+
+  for (size_t N : {1, 127, 128, 129, 100000}) {
+    for (uint64_t universe_mul : {1, 3, 1000}) {
+      std::vector<uint64_t> v;
+      for (size_t i = 0; i < N; ++i) { v.push_back(uint64_t(rand()) % (N * universe_mul + 1)); }
+      std::sort(v.begin(), v.end());
+
+      succinct::partitioned_elias_fano::builder build(v.back() + 1, v.size());
+      for (auto x : v) { build.push_back(x); }
+      succinct::partitioned_elias_fano pef(&build);
+      ASSERT_EQ(v.size(), pef.num_ones());
+
+      succinct::partitioned_elias_fano::select_enumerator it(pef, 0);
+      for (size_t i = 0; i < v.size(); ++i) {
+        ASSERT_EQ(v[i], pef.select(i));
+        ASSERT_EQ(v[i], it.next());
+        ASSERT_EQ(uint64_t(std::lower_bound(v.begin(), v.end(), v[i]) - v.begin()), pef.rank(v[i]));
+        ASSERT_EQ(v[i], pef.successor1(v[i]));
+      }
+
+      // enumeration from the middle of a chunk
+      succinct::partitioned_elias_fano::select_enumerator mid(pef, N / 3);
+      for (size_t i = N / 3; i < v.size(); ++i) { ASSERT_EQ(v[i], mid.next()); }
+
+      // the frozen data maps back to the same sequence
+      std::stringstream frozen;
+      succinct::mapper::freeze(pef, frozen);
+      std::string data = frozen.str();
+      std::vector<uint64_t> aligned(data.size() / 8 + 1);
+      std::memcpy(aligned.data(), data.data(), data.size());
+      succinct::partitioned_elias_fano mapped;
+      succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()),
+                            succinct::mapper::map_flags::verify_checksums);
+      for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], mapped.select(i)); }
+    }
+  }
+}
@@ -2,6 +2,12 @@
 #include "test_rank_select_common.hpp"
 
 #include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <span>
+#include <sstream>
+#include <string>
 
 #include "mapper.hpp"
 #include "rs_bit_vector.hpp"
@@ -28,6 +34,8 @@ TEST(test_rs_bit_vector, basic) {
 
   succinct::rs_bit_vector(v, true, true).swap(bitmap);
   test_rank_select(v, bitmap);
+  succinct::rs_bit_vector(v, false, false, 1, true, true).swap(bitmap);
+  test_rank_select(v, bitmap);
 
   v.resize(10000);
   v[9999] = 1;
@@ -53,4 +61,161 @@ TEST(test_rs_bit_vector, basic) {
   test_rank_select(v, bitmap);
   succinct::rs_bit_vector(v, true).swap(bitmap);
   test_rank_select(v, bitmap);
+  succinct::rs_bit_vector(v, true, true, 1, true, true).swap(bitmap);
+  test_rank_select(v, bitmap);
+}
+
+void test_batch(std::vector<bool> const &v, succinct::rs_bit_vector const &bitmap) {
+  std::vector<uint64_t> positions;
+  for (size_t i = 0; i <= v.size(); i += size_t(rand()) % 7 + 1) { positions.push_back(i); }
+  positions.push_back(v.size());
+  std::vector<uint64_t> ranks(positions.size());
+  bitmap.rank_batch(positions, ranks);
+  for (size_t i = 0; i < positions.size(); ++i) { ASSERT_EQ(bitmap.rank(positions[i]), ranks[i]); }
+
+  std::vector<uint64_t> indices;
+  for (size_t i = 0; i < bitmap.num_ones(); ++i) { indices.push_back(size_t(rand()) % bitmap.num_ones()); }
+  std::vector<uint64_t> selects(indices.size());
+  bitmap.select_batch(indices, selects);
+  for (size_t i = 0; i < indices.size(); ++i) { ASSERT_EQ(bitmap.select(indices[i]), selects[i]); }
+}
+
+TEST(test_rs_bit_vector, batch) {
+  srand(42);
+  succinct::rs_bit_vector bitmap;
+
+  for (size_t d = 0; d < 8; ++d) {
+    double density      = 1.0 / (1 << d);
+    std::vector<bool> v = random_bit_vector(10000 + d, density);
+
+    succinct::rs_bit_vector(v).swap(bitmap);
+    test_batch(v, bitmap);
+    succinct::rs_bit_vector(v, true, true).swap(bitmap);
+    test_batch(v, bitmap);
+  }
+}
+
+template <succinct::broadword::kernel_tier Tier>
+void test_tier(std::vector<bool> const &v, succinct::rs_bit_vector const &bitmap) {
+  uint64_t cur_rank = 0;
+  for (size_t i = 0; i < v.size(); ++i) {
+    ASSERT_EQ(cur_rank, bitmap.rank<Tier>(i));
+    if (v[i]) {
+      ASSERT_EQ(i, bitmap.select<Tier>(cur_rank));
+      ++cur_rank;
+    } else {
+      ASSERT_EQ(i, bitmap.select0<Tier>(i - cur_rank));
+    }
+  }
+}
+
+TEST(test_rs_bit_vector, kernel_tiers) {
+  using succinct::broadword::kernel_tier;
+  srand(42);
+  std::vector<bool> v = random_bit_vector(20000, 0.3);
+  succinct::rs_bit_vector bitmap(v, true, true);
+
+  kernel_tier detected = succinct::broadword::detected_kernel_tier();
+  test_tier<kernel_tier::generic>(v, bitmap);
+  if (detected >= kernel_tier::popcnt) { test_tier<kernel_tier::popcnt>(v, bitmap); }
+  if (detected >= kernel_tier::bmi2) { test_tier<kernel_tier::bmi2>(v, bitmap); }
+}
+
+TEST(test_rs_bit_vector, select_inventory) {
+  srand(42);
+  succinct::rs_bit_vector bitmap;
+
+  for (size_t d = 0; d < 12; ++d) {
+    double density      = 1.0 / (1 << d);
+    std::vector<bool> v = random_bit_vector(20000 + d, density);
+    succinct::rs_bit_vector(v, false, false, 1, true, true).swap(bitmap);
+    test_rank_select(v, bitmap);
+    test_batch(v, bitmap);
+  }
+
+  // ones (and zeros) sparse enough for the inventory to store their blocks,
+  // as offsets or, past a 16-bit span, as absolute blocks, interleaved
+  // with dense runs so that the kinds of samples alternate within groups
+  for (uint64_t log_gap : {10, 17, 20}) {
+    uint64_t gap = uint64_t(1) << log_gap;
+    for (bool ones : {true, false}) {
+      succinct::bit_vector_builder bvb;
+      std::vector<uint64_t> positions;
+      for (size_t i = 0; i < (uint64_t(1) << 27) / gap; ++i) {
+        uint64_t skip = rand() % 8 ? gap + uint64_t(rand()) % 1000 : uint64_t(rand()) % 4;
+        if (ones) {
+          bvb.zero_extend(skip);
+        } else {
+          bvb.one_extend(skip);
+        }
+        positions.push_back(bvb.size());
+        bvb.push_back(ones);
+      }
+      succinct::rs_bit_vector(&bvb, false, false, 1, ones, !ones).swap(bitmap);
+      for (size_t i = 0; i < positions.size(); ++i) {
+        ASSERT_EQ(positions[i], ones ? bitmap.select(i) : bitmap.select0(i));
+      }
+      if (ones) {
+        std::vector<uint64_t> in(positions.size()), out(positions.size());
+        std::iota(in.begin(), in.end(), 0);
+        bitmap.select_batch(in, out);
+        ASSERT_EQ(positions, out);
+      }
+    }
+  }
+}
+
+std::string frozen_bytes(succinct::rs_bit_vector &bitmap) {
+  succinct::mapper::freeze(bitmap, "temp.bin");
+  std::ifstream fin("temp.bin", std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+TEST(test_rs_bit_vector, parallel_build) {
+  srand(42);
+  succinct::rs_bit_vector serial, parallel;
+
+  // large enough to be split across several threads; the odd sizes leave a
+  // partial last block
+  for (double density : {0.5, 0.99, 0.01}) {
+    std::vector<bool> v = random_bit_vector(4 * 1024 * 1024 + 8 * 64 * 3 + 17, density);
+    succinct::rs_bit_vector(v, true, true, 1, true, true).swap(serial);
+    std::string expected = frozen_bytes(serial);
+
+    for (size_t num_threads : {2, 3, 4, 7}) {
+      succinct::rs_bit_vector(v, true, true, num_threads, true, true).swap(parallel);
+      ASSERT_EQ(expected, frozen_bytes(parallel)) << "density " << density << ", " << num_threads << " threads";
+    }
+  }
+
+  // runs of ones and zeros make hint thresholds fall on range boundaries
+  std::vector<bool> v(3 * 1024 * 1024 + 100);
+  for (size_t i = 0; i < v.size(); ++i) { v[i] = (i / 4096) % 3 != 0; }
+  succinct::rs_bit_vector(v, true, true, 1, true, true).swap(serial);
+  succinct::rs_bit_vector(v, true, true, 5, true, true).swap(parallel);
+  ASSERT_EQ(frozen_bytes(serial), frozen_bytes(parallel));
+  test_rank_select(v, parallel);
+}
+
+// rs_bit_vector(v, true, true) frozen by the code that predates the versioned
+// format, with v[i] = (i * i + 3 * i) % 7 < 3 for 300 bits
+static const uint64_t legacy_frozen[] = {
+  0x0000000000000000, 0x000000000000012c, 0x0000000000000005, 0x9122448912244891,
+  0x4891224489122448, 0x2448912244891224, 0x1224489122448912, 0x0000044891224489,
+  0x0000000000000004, 0x0000000000000000, 0x04c4a3724958ac56, 0x0000000000000056,
+  0x0000000000000000, 0x0000000000000001, 0x0000000000000001, 0x0000000000000001,
+  0x0000000000000001};
+
+TEST(test_rs_bit_vector, legacy_format) {
+  std::vector<bool> v(300);
+  for (uint64_t i = 0; i < v.size(); ++i) { v[i] = (i * i + 3 * i) % 7 < 3; }
+  std::span<const char> legacy(reinterpret_cast<const char *>(legacy_frozen), sizeof(legacy_frozen));
+
+  // the inventories of what was there before are dropped, and the legacy
+  // format has no room for new ones
+  succinct::rs_bit_vector mapped(std::vector<bool>(5000, true), false, false, 1, true, true);
+  succinct::rs_bit_vector hints(v, true, true);
+  succinct::rs_bit_vector inventory(v, true, true, 1, true);
+  test_legacy_format(
+    legacy, mapped, [&](succinct::rs_bit_vector const &bitmap) { test_rank_select(v, bitmap); }, hints, inventory);
 }
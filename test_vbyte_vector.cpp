@@ -0,0 +1,86 @@
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <sstream>
+
+#include "mapper.hpp"
+#include "vbyte.hpp"
+
+// values of 1 to 4 bytes, with the boundaries of each length
+std::vector<uint32_t> random_values(size_t n) {
+  std::vector<uint32_t> v(n);
+  for (auto &x : v) {
+    uint32_t val = uint32_t(rand()) ^ (uint32_t(rand()) << 16);
+    switch (rand() % 6) {
+      case 0: x = val & 0xFF; break;
+      case 1: x = val & 0xFFFF; break;
+      case 2: x = val & 0xFFFFFF; break;
+      case 3: x = val; break;
+      case 4: x = uint32_t(1) << (8 * (rand() % 4)); break;
+      default: x = uint32_t(uint64_t(1) << (8 * (rand() % 4 + 1))) - 1;
+    }
+  }
+  return v;
+}
+
+TEST(test_vbyte_vector, basic) {
+  srand(42);
+  for (size_t n : {0, 1, 5, 128, 129, 12345}) {
+    std::vector<uint32_t> v = random_values(n);
+    succinct::vbyte_vector vv(v);
+
+    ASSERT_EQ(v.size(), vv.size());
+    for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], vv[i]) << "n " << n << " i " << i; }
+  }
+
+  succinct::vbyte_vector::builder b;
+  ASSERT_THROW(b.push_back(uint64_t(1) << 32), std::invalid_argument);
+}
+
+TEST(test_vbyte_vector, enumerator) {
+  srand(42);
+  std::vector<uint32_t> v = random_values(12345);
+  succinct::vbyte_vector vv(v);
+
+  size_t pos = 0;
+  succinct::forward_enumerator<succinct::vbyte_vector> e(vv, pos);
+  std::vector<uint32_t> out(v.size());
+  while (pos < vv.size()) {
+    ASSERT_EQ(v[pos], e.next());
+    pos += 1;
+
+    size_t n = std::min(size_t(rand()) % 300, v.size() - pos);
+    e.decode(out.data(), n);
+    for (size_t i = 0; i < n; ++i) { ASSERT_EQ(v[pos + i], out[i]) << "pos " << pos + i; }
+    pos += n;
+
+    if (rand() & 1) {
+      pos += size_t(rand()) % (vv.size() - pos + 1);
+      e = succinct::forward_enumerator<succinct::vbyte_vector>(vv, pos);
+    }
+  }
+}
+
+TEST(test_vbyte_vector, map) {
+  srand(42);
+  std::vector<uint32_t> v = random_values(5000);
+  succinct::vbyte_vector vv(v);
+
+  std::ostringstream frozen;
+  succinct::mapper::freeze(vv, frozen);
+  std::string data = frozen.str();
+  std::vector<uint64_t> aligned(data.size() / 8 + 1);
+  std::memcpy(aligned.data(), data.data(), data.size());
+
+  succinct::vbyte_vector mapped;
+  succinct::mapper::map(mapped, std::span<const char>(reinterpret_cast<const char *>(aligned.data()), data.size()));
+  ASSERT_EQ(v.size(), mapped.size());
+  for (size_t i = 0; i < v.size(); ++i) { ASSERT_EQ(v[i], mapped[i]); }
+
+  std::vector<uint32_t> out(v.size());
+  succinct::forward_enumerator<succinct::vbyte_vector> e(mapped);
+  e.decode(out.data(), out.size());
+  ASSERT_EQ(v, out);
+}
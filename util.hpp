@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <exception>
 #include <fstream>
 #include <list>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 namespace succinct {
 namespace util {
@@ -107,5 +112,47 @@ inline IntType1 ceil_div(IntType1 dividend, IntType2 divisor) {
   return IntType1(dividend + d - 1) / d;
 }
 
+// number of threads to use when the caller asks for num_threads (0 means
+// one per hardware thread)
+inline size_t resolve_num_threads(size_t num_threads) {
+  if (num_threads == 0) { num_threads = std::max<size_t>(1, std::thread::hardware_concurrency()); }
+  return num_threads;
+}
+
+// Splits [0, n) into num_threads contiguous ranges of (almost) equal size
+// and calls fn(thread_idx, begin, end) on each of them concurrently; range
+// 0 runs on the calling thread. The first exception thrown by any of the
+// calls is rethrown once all of them have completed.
+template <typename Fn>
+void parallel_ranges(uint64_t n, size_t num_threads, Fn fn) {
+  if (num_threads <= 1) {
+    fn(size_t(0), uint64_t(0), n);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(num_threads);
+  auto run = [&](size_t t) {
+    try {
+      fn(t, n * t / num_threads, n * (t + 1) / num_threads);
+    } catch (...) { errors[t] = std::current_exception(); }
+  };
+
+  // If a thread cannot be created, the ranges left without one run on the
+  // calling thread rather than leaving the launched threads unjoined
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  size_t launched = 1;
+  try {
+    for (; launched < num_threads; ++launched) { threads.emplace_back(run, launched); }
+  } catch (std::system_error const &) {}
+  run(0);
+  for (size_t t = launched; t < num_threads; ++t) { run(t); }
+  for (auto &thread : threads) { thread.join(); }
+
+  for (auto &error : errors) {
+    if (error) { std::rethrow_exception(error); }
+  }
+}
+
 }  // namespace util
 }  // namespace succinct
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
 #include "broadword.hpp"
+#include "forward_enumerator.hpp"
+#include "mappable_vector.hpp"
+#include "util.hpp"
 
 namespace succinct {
 
@@ -35,4 +43,165 @@ inline size_t decode_vbyte(Vector const &v, size_t offset, size_t &val) {
   return pos - offset;
 }
 
+// Stream-VByte encoded array of 32-bit unsigned integers. The byte lengths
+// of the values, 1 to 4, are stored two bits each in a control stream kept
+// apart from the value bytes, so the lengths of four values are known from
+// one control byte and the four can be decoded with a single shuffle. The
+// data offset of every sample_size-th value is sampled for random access.
+class vbyte_vector {
+ public:
+  typedef uint32_t value_type;
+
+  class builder {
+   public:
+    builder(uint64_t n = 0) : m_size(0) {
+      m_control.reserve(util::ceil_div(n, 4));
+      m_data.reserve(n);
+      m_samples.reserve(util::ceil_div(n, sample_size));
+    }
+
+    void push_back(uint64_t val) {
+      if (val >> 32) { throw std::invalid_argument("vbyte_vector values must fit in 32 bits"); }
+      if (m_size % sample_size == 0) { m_samples.push_back(m_data.size()); }
+      if (m_size % 4 == 0) { m_control.push_back(0); }
+
+      unsigned long bits;
+      if (!broadword::msb(val, bits)) bits = 0;
+      size_t len = bits / 8 + 1;
+      m_control.back() |= uint8_t((len - 1) << (2 * (m_size % 4)));
+      for (size_t b = 0; b < len; ++b) { m_data.push_back(uint8_t(val >> (8 * b))); }
+      m_size += 1;
+    }
+
+    uint64_t size() const { return m_size; }
+
+   private:
+    friend class vbyte_vector;
+
+    uint64_t m_size;
+    std::vector<uint8_t> m_control;
+    std::vector<uint8_t> m_data;
+    std::vector<uint64_t> m_samples;
+  };
+
+  vbyte_vector() : m_size(0) {}
+
+  vbyte_vector(builder *from) : m_size(from->m_size) {
+    // the decoders load 16 bytes at a time
+    from->m_data.resize(from->m_data.size() + data_padding, 0);
+    m_control.steal(from->m_control);
+    m_data.steal(from->m_data);
+    m_samples.steal(from->m_samples);
+  }
+
+  template <typename Range>
+  vbyte_vector(Range const &values) : m_size(0) {
+    builder b;
+    for (auto iter = std::begin(values); iter != std::end(values); ++iter) { b.push_back(*iter); }
+    vbyte_vector(&b).swap(*this);
+  }
+
+  template <typename Visitor>
+  void map(Visitor &visit) {
+    visit(m_size, "m_size")(m_control, "m_control")(m_data, "m_data")(m_samples, "m_samples");
+  }
+
+  void swap(vbyte_vector &other) {
+    std::swap(m_size, other.m_size);
+    m_control.swap(other.m_control);
+    m_data.swap(other.m_data);
+    m_samples.swap(other.m_samples);
+  }
+
+  value_type operator[](uint64_t idx) const {
+    assert(idx < m_size);
+    uint64_t offset = data_offset(idx);
+    return read_value(offset, value_length(idx));
+  }
+
+  uint64_t size() const { return m_size; }
+
+ private:
+  friend struct forward_enumerator<vbyte_vector>;
+
+  static const uint64_t sample_size  = 128;
+  static const uint64_t data_padding = 16;
+
+  uint64_t value_length(uint64_t idx) const { return uint64_t((m_control[idx / 4] >> (2 * (idx % 4))) & 3) + 1; }
+
+  // total length of the values of k <= 8 control bytes packed in a word,
+  // summing the 2-bit fields in parallel
+  static uint64_t groups_length(uint64_t controls, uint64_t k) {
+    uint64_t pairs = (controls & 0x3333333333333333ULL) + ((controls >> 2) & 0x3333333333333333ULL);
+    uint64_t bytes = (pairs & 0x0F0F0F0F0F0F0F0FULL) + ((pairs >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+    return 4 * k + broadword::bytes_sum(bytes);
+  }
+
+  // offset in m_data of the value idx, from the closest sample before it
+  uint64_t data_offset(uint64_t idx) const {
+    uint64_t offset = m_samples[idx / sample_size];
+    uint64_t group  = idx / sample_size * sample_size / 4;
+    uint64_t end    = idx / 4;
+    for (; group < end; group += 8) {
+      uint64_t k = std::min(end - group, uint64_t(8));
+      uint64_t controls;
+      if (group + 8 <= m_control.size()) {
+        std::memcpy(&controls, m_control.data() + group, 8);
+        if (k < 8) { controls &= (uint64_t(1) << (8 * k)) - 1; }
+      } else {
+        controls = 0;
+        for (uint64_t b = 0; b < k; ++b) { controls |= uint64_t(m_control[group + b]) << (8 * b); }
+      }
+      offset += groups_length(controls, k);
+    }
+    for (uint64_t i = end * 4; i < idx; ++i) { offset += value_length(i); }
+    return offset;
+  }
+
+  value_type read_value(uint64_t offset, uint64_t len) const {
+    uint32_t val;
+    std::memcpy(&val, m_data.data() + offset, sizeof(val));
+    return len == 4 ? val : val & ((uint32_t(1) << (8 * len)) - 1);
+  }
+
+  uint64_t m_size;
+  mapper::mappable_vector<uint8_t> m_control;
+  mapper::mappable_vector<uint8_t> m_data;
+  mapper::mappable_vector<uint64_t> m_samples;
+};
+
+template <>
+struct forward_enumerator<vbyte_vector> {
+  typedef vbyte_vector::value_type value_type;
+
+  forward_enumerator(vbyte_vector const &c, size_t idx = 0)
+    : m_c(&c), m_idx(idx), m_offset(idx < c.size() ? c.data_offset(idx) : 0) {}
+
+  value_type next() {
+    assert(m_idx < m_c->size());
+    uint64_t len   = m_c->value_length(m_idx);
+    value_type val = m_c->read_value(m_offset, len);
+    m_offset += len;
+    m_idx += 1;
+    return val;
+  }
+
+  // same as n calls to next(); whole control bytes are decoded with
+  // broadword::decode_stream_vbyte
+  void decode(value_type *out, size_t n) {
+    assert(m_idx + n <= m_c->size());
+    size_t i = 0;
+    for (; i < n && m_idx % 4; ++i) { out[i] = next(); }
+    if (i == n) return;
+    m_offset += broadword::decode_stream_vbyte(m_c->m_control.data() + m_idx / 4, m_c->m_data.data() + m_offset, n - i,
+                                                out + i);
+    m_idx += n - i;
+  }
+
+ private:
+  vbyte_vector const *m_c;
+  uint64_t m_idx;
+  uint64_t m_offset;
+};
+
 }  // namespace succinct